@@ -0,0 +1,332 @@
+/** @file
+  A shell application that prints the SMI latency profile kept by the software
+  SMI dispatcher: p50, p99 and maximum latency of every SMI handler and of the
+  SMIs as a whole.
+
+  Usage: SmiProfile [-r]
+    -r    Reset the profile after printing it.
+
+  The profile is only kept when the payload is built with SMI_PROFILE_ENABLE.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <Uefi.h>
+#include <Guid/SmiProfileGuid.h>
+#include <Protocol/SmmCommunication.h>
+#include <Protocol/ShellParameters.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiLib.h>
+#include <Library/SortLib.h>
+#include <Library/UefiApplicationEntryPoint.h>
+
+#define SMI_PROFILE_RECORDS_PER_CALL     128
+#define SMI_PROFILE_CALIBRATION_TIME     100000     // in microseconds
+
+#define SMI_PROFILE_COMM_BUFFER_SIZE  (OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) + \
+                                       SMI_PROFILE_COMMUNICATE_HEADER_SIZE + \
+                                       OFFSET_OF (SMI_PROFILE_COMMUNICATE_GET_RECORDS, Records) + \
+                                       SMI_PROFILE_RECORDS_PER_CALL * sizeof (SMI_PROFILE_RECORD))
+
+EFI_SMM_COMMUNICATION_PROTOCOL  *mSmmCommunication;
+EFI_SMM_COMMUNICATE_HEADER      *mCommBuffer;
+UINT64                          mTscFrequency;
+
+/**
+  Send one request to the SMI profile handler.
+
+  @param[in]      Function       SMI_PROFILE_FUNCTION_xxx.
+  @param[in, out] Data           Request data, updated with the reply.
+  @param[in]      DataSize       Size of Data.
+
+  @retval EFI_SUCCESS            The request completed.
+  @retval Others                 The request failed.
+
+**/
+EFI_STATUS
+SmiProfileCommunicate (
+  IN     UINTN                   Function,
+  IN OUT VOID                    *Data,
+  IN     UINTN                   DataSize
+  )
+{
+  SMI_PROFILE_COMMUNICATE_HEADER *ProfileHeader;
+  UINTN                          CommSize;
+  EFI_STATUS                     Status;
+
+  CopyGuid (&mCommBuffer->HeaderGuid, &gUefiSmiProfileGuid);
+  mCommBuffer->MessageLength = SMI_PROFILE_COMMUNICATE_HEADER_SIZE + DataSize;
+
+  ProfileHeader               = (SMI_PROFILE_COMMUNICATE_HEADER *) mCommBuffer->Data;
+  ProfileHeader->Function     = Function;
+  ProfileHeader->ReturnStatus = EFI_NOT_READY;
+  if (DataSize != 0) {
+    CopyMem (ProfileHeader->Data, Data, DataSize);
+  }
+
+  CommSize = OFFSET_OF (EFI_SMM_COMMUNICATE_HEADER, Data) + mCommBuffer->MessageLength;
+  Status   = mSmmCommunication->Communicate (mSmmCommunication, mCommBuffer, &CommSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (EFI_ERROR (ProfileHeader->ReturnStatus)) {
+    return ProfileHeader->ReturnStatus;
+  }
+
+  if (DataSize != 0) {
+    CopyMem (Data, ProfileHeader->Data, DataSize);
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Order records by type, handler and software SMI value, then by duration.
+
+  @param[in] Buffer1     The first record.
+  @param[in] Buffer2     The second record.
+
+  @retval 0              The records are equal.
+  @retval <0             Buffer1 goes before Buffer2.
+  @retval >0             Buffer1 goes after Buffer2.
+
+**/
+INTN
+EFIAPI
+CompareRecords (
+  IN CONST VOID          *Buffer1,
+  IN CONST VOID          *Buffer2
+  )
+{
+  CONST SMI_PROFILE_RECORD  *Record1;
+  CONST SMI_PROFILE_RECORD  *Record2;
+
+  Record1 = (CONST SMI_PROFILE_RECORD *) Buffer1;
+  Record2 = (CONST SMI_PROFILE_RECORD *) Buffer2;
+
+  if (Record1->Type != Record2->Type) {
+    return (Record1->Type < Record2->Type) ? -1 : 1;
+  }
+  if (Record1->SwSmiValue != Record2->SwSmiValue) {
+    return (Record1->SwSmiValue < Record2->SwSmiValue) ? -1 : 1;
+  }
+  if (Record1->Ticks != Record2->Ticks) {
+    return (Record1->Ticks < Record2->Ticks) ? -1 : 1;
+  }
+  return 0;
+}
+
+/**
+  Convert TSC ticks to microseconds.
+
+  @param[in] Ticks       TSC ticks.
+
+  @return Microseconds.
+
+**/
+UINT64
+TicksToMicroSeconds (
+  IN UINT64              Ticks
+  )
+{
+  return DivU64x64Remainder (MultU64x32 (Ticks, 1000000), mTscFrequency, NULL);
+}
+
+/**
+  Print one line of the latency table for a group of records sorted by duration.
+
+  @param[in] Records     The records of the group.
+  @param[in] Count       Number of records in the group.
+
+**/
+VOID
+PrintGroup (
+  IN SMI_PROFILE_RECORD  *Records,
+  IN UINTN               Count
+  )
+{
+  UINTN                  Index;
+  UINT64                 Loops;
+
+  if (Records->Type == SMI_PROFILE_RECORD_SMI) {
+    Loops = 0;
+    for (Index = 0; Index < Count; Index++) {
+      Loops += Records[Index].Loops;
+    }
+    Print (L"All SMIs                     ");
+    Print (L"%8d %10ld %10ld %10ld  loops/SMI %ld\n",
+      Count,
+      TicksToMicroSeconds (Records[(Count - 1) / 2].Ticks),
+      TicksToMicroSeconds (Records[((Count - 1) * 99) / 100].Ticks),
+      TicksToMicroSeconds (Records[Count - 1].Ticks),
+      DivU64x64Remainder (Loops, Count, NULL)
+      );
+    return;
+  }
+
+  Print (L"0x%02x                         ", Records->SwSmiValue);
+  Print (L"%8d %10ld %10ld %10ld\n",
+    Count,
+    TicksToMicroSeconds (Records[(Count - 1) / 2].Ticks),
+    TicksToMicroSeconds (Records[((Count - 1) * 99) / 100].Ticks),
+    TicksToMicroSeconds (Records[Count - 1].Ticks)
+    );
+}
+
+/**
+  Check whether the application was started with a given option.
+
+  @param[in] ImageHandle    The image handle of the application.
+  @param[in] Option         The option.
+
+  @retval TRUE              The option is on the command line.
+  @retval FALSE             The option is not on the command line.
+
+**/
+BOOLEAN
+HasOption (
+  IN EFI_HANDLE          ImageHandle,
+  IN CONST CHAR16        *Option
+  )
+{
+  EFI_SHELL_PARAMETERS_PROTOCOL  *ShellParameters;
+  UINTN                          Index;
+  EFI_STATUS                     Status;
+
+  Status = gBS->HandleProtocol (ImageHandle, &gEfiShellParametersProtocolGuid, (VOID **) &ShellParameters);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  for (Index = 1; Index < ShellParameters->Argc; Index++) {
+    if (StrCmp (ShellParameters->Argv[Index], Option) == 0) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/**
+  The user Entry Point for Application. The user code starts with this function
+  as the real entry point for the application.
+
+  @param[in] ImageHandle    The firmware allocated handle for the EFI image.
+  @param[in] SystemTable    A pointer to the EFI System Table.
+
+  @retval EFI_SUCCESS       The entry point is executed successfully.
+  @retval other             Some error occurs when executing this entry point.
+
+**/
+EFI_STATUS
+EFIAPI
+UefiMain (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                           Status;
+  SMI_PROFILE_COMMUNICATE_GET_INFO     Info;
+  SMI_PROFILE_COMMUNICATE_GET_RECORDS  *GetRecords;
+  UINTN                                GetRecordsSize;
+  SMI_PROFILE_RECORD                   *Records;
+  UINTN                                RecordCount;
+  UINT64                               Lost;
+  UINTN                                Start;
+  UINTN                                Index;
+  UINT64                               Tsc;
+
+  Status = gBS->LocateProtocol (&gEfiSmmCommunicationProtocolGuid, NULL, (VOID **) &mSmmCommunication);
+  if (EFI_ERROR (Status)) {
+    Print (L"SmiProfile: SMM communication is not available - %r\n", Status);
+    return Status;
+  }
+
+  //
+  // The handler only accepts buffers outside SMRAM that stay valid at runtime
+  //
+  GetRecordsSize = OFFSET_OF (SMI_PROFILE_COMMUNICATE_GET_RECORDS, Records) +
+                   SMI_PROFILE_RECORDS_PER_CALL * sizeof (SMI_PROFILE_RECORD);
+  mCommBuffer    = AllocateRuntimePool (SMI_PROFILE_COMM_BUFFER_SIZE);
+  GetRecords     = AllocatePool (GetRecordsSize);
+  if (mCommBuffer == NULL || GetRecords == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // The profile is kept in TSC ticks
+  //
+  Tsc = AsmReadTsc ();
+  gBS->Stall (SMI_PROFILE_CALIBRATION_TIME);
+  mTscFrequency = DivU64x32 (MultU64x32 (AsmReadTsc () - Tsc, 1000000), SMI_PROFILE_CALIBRATION_TIME);
+
+  Status = SmiProfileCommunicate (SMI_PROFILE_FUNCTION_GET_INFO, &Info, sizeof (Info));
+  if (EFI_ERROR (Status)) {
+    Print (L"SmiProfile: cannot read the profile - %r\n", Status);
+    return Status;
+  }
+
+  Records = AllocatePool (Info.RingSize * sizeof (SMI_PROFILE_RECORD));
+  if (Records == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Read the ring from the oldest record on. The reads themselves add SMIs,
+  // so stop once the ring is full.
+  //
+  RecordCount        = 0;
+  Lost               = 0;
+  GetRecords->Cursor = 0;
+  while (RecordCount < Info.RingSize) {
+    GetRecords->Count = (UINT32) MIN (SMI_PROFILE_RECORDS_PER_CALL, Info.RingSize - RecordCount);
+    Status = SmiProfileCommunicate (SMI_PROFILE_FUNCTION_GET_RECORDS, GetRecords, GetRecordsSize);
+    if (EFI_ERROR (Status) || GetRecords->Count == 0) {
+      break;
+    }
+    CopyMem (&Records[RecordCount], GetRecords->Records, GetRecords->Count * sizeof (SMI_PROFILE_RECORD));
+    RecordCount += GetRecords->Count;
+    Lost        += GetRecords->Lost;
+  }
+
+  Print (L"SMIs since reset: %ld, average %ld us, max %ld us (TSC %ld MHz)\n",
+    Info.TotalSmis,
+    (Info.TotalSmis == 0) ? 0 : TicksToMicroSeconds (DivU64x64Remainder (Info.TotalSmiTicks, Info.TotalSmis, NULL)),
+    TicksToMicroSeconds (Info.MaxSmiTicks),
+    DivU64x32 (mTscFrequency, 1000000)
+    );
+  Print (L"%d records in the ring, %ld overwritten\n\n", RecordCount, Lost);
+  Print (L"SwSmi                           Count   p50 (us)   p99 (us)   max (us)\n");
+
+  if (RecordCount != 0) {
+    PerformQuickSort (Records, RecordCount, sizeof (SMI_PROFILE_RECORD), CompareRecords);
+    Start = 0;
+    for (Index = 1; Index <= RecordCount; Index++) {
+      if ((Index == RecordCount) ||
+          (Records[Index].Type != Records[Start].Type) ||
+          (Records[Index].SwSmiValue != Records[Start].SwSmiValue)) {
+        PrintGroup (&Records[Start], Index - Start);
+        Start = Index;
+      }
+    }
+  }
+
+  if (HasOption (ImageHandle, L"-r")) {
+    Status = SmiProfileCommunicate (SMI_PROFILE_FUNCTION_RESET, NULL, 0);
+    Print (L"\nProfile reset - %r\n", Status);
+  }
+
+  FreePool (Records);
+  FreePool (GetRecords);
+  FreePool (mCommBuffer);
+  return EFI_SUCCESS;
+}
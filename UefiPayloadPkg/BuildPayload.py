@@ -10,7 +10,7 @@
 # THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN 'AS IS' BASIS,
 # WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #
-import os, sys, argparse, subprocess, shutil, multiprocessing
+import os, sys, argparse, subprocess, shutil, multiprocessing, hashlib, json, filecmp
 
 def prep_env():
   os.environ['EDK_TOOLS_PATH'] = os.path.abspath('BaseTools')
@@ -67,6 +67,12 @@ def prep_env():
   return toolchain
 
 def copytree(src, dst):
+  #
+  # Only copy files whose content differs, so that the build does not see
+  # the untouched ones as dirty. A copied file gets the current time rather
+  # than the source mtime, which may be older than the objects built from
+  # the file it replaces.
+  #
   for item in os.listdir(src):
     s = os.path.join(src, item)
     d = os.path.join(dst, item)
@@ -76,10 +82,45 @@ def copytree(src, dst):
       else:
         shutil.copytree(s, d)
         print('copied %s to %s' % (s, d))
-    else:
+    elif not os.path.exists(d) or not filecmp.cmp(s, d, shallow=False):
       shutil.copy(s, d)
       print('copied %s to %s' % (s, d))
 
+def hash_files(paths):
+  digests = {}
+  for path in paths:
+    if os.path.isdir(path):
+      for root, dirs, files in os.walk(path):
+        dirs.sort()
+        for name in sorted(files):
+          digests.update(hash_files([os.path.join(root, name)]))
+    elif os.path.isfile(path):
+      with open(path, 'rb') as f:
+        digests[os.path.abspath(path)] = hashlib.sha1(f.read()).hexdigest()
+  return digests
+
+def load_manifest(path):
+  try:
+    with open(path) as f:
+      return json.load(f)
+  except (IOError, ValueError):
+    return {}
+
+def save_manifest(path, manifest):
+  if not os.path.exists(os.path.dirname(path)):
+    os.makedirs(os.path.dirname(path))
+  with open(path, 'w') as f:
+    json.dump(manifest, f, indent=2, sort_keys=True)
+
+def keep_mtime_if_unchanged(before):
+  #
+  # TranslateConfig.py rewrites every file it matches; put the times back on
+  # the ones whose content did not change
+  #
+  for path, times in before.items():
+    if os.path.isfile(path) and hash_files([path]).get(path) == times[0]:
+      os.utime(path, (times[1], times[2]))
+
 def build(platform, architectrue, target, threadnum):
     toolchain = prep_env()
     print('start building payload ...')
@@ -94,18 +135,43 @@ def build(platform, architectrue, target, threadnum):
     Inc = '../UEFIPayload/UefiPayloadPkg/CustomizationSample/Inc'
     if os.path.exists(Inc):
       copytree(Inc, '../UEFIPayload/UefiPayloadPkg/Include/Library')
-    os.chdir('../UEFIPayload/UefiPayloadPkg/Tools')
-    ret = subprocess.call(['python', 'TranslateConfig.py', '-b', platform, '-a', architectrue])
-    os.chdir(os.getenv('WORKSPACE'))
-    if ret:
-      print('translating configuration failed!')
-      sys.exit(1)
     Macro = 'IA32'
     Arch = '-a IA32'
     if architectrue == 'X64':
       Macro = 'IA32X64'
       Arch = '-a IA32 -a X64'
     platformfile = os.path.join(os.getenv('WORKSPACE'), '../UEFIPayload/UefiPayloadPkg', 'UefiPayloadPkg%s.dsc' % Macro)
+
+    #
+    # Skip the configuration translation and the FV patching when their inputs
+    # and outputs are the same as after the last run. Removing Build (-c)
+    # drops the manifest and forces both.
+    #
+    manifestfile = os.path.join(os.getenv('WORKSPACE'), 'Build', 'UefiPayloadPkg%s' % architectrue, 'BuildPayload.json')
+    manifest = load_manifest(manifestfile)
+    setup = '../UEFIPayload/UefiPayloadPkg/CustomizationSample/Platforms/%s/Setup' % platform
+    sbldsc = '../UEFIPayload/UefiPayloadPkg/WorkSpace/SlimBootloader/Platform/%s/CfgData' % \
+             ('QemuBoardPkg' if platform == 'Qemu' else 'ApollolakeBoardPkg')
+    translate = {
+      'inputs'  : hash_files([setup]),
+      'outputs' : hash_files([platformfile, sbldsc])
+    }
+    if manifest.get('translate') == translate:
+      print('configuration unchanged, skip translating')
+    else:
+      before = dict((path, (digest, os.path.getatime(path), os.path.getmtime(path)))
+                    for path, digest in translate['outputs'].items())
+      os.chdir('../UEFIPayload/UefiPayloadPkg/Tools')
+      ret = subprocess.call(['python', 'TranslateConfig.py', '-b', platform, '-a', architectrue])
+      os.chdir(os.getenv('WORKSPACE'))
+      if ret:
+        print('translating configuration failed!')
+        sys.exit(1)
+      keep_mtime_if_unchanged(before)
+      translate['outputs'] = hash_files([platformfile, sbldsc])
+      manifest['translate'] = translate
+      save_manifest(manifestfile, manifest)
+
     tool = 'build' if os.name == 'posix' else 'build.bat'
     cmd = '%s -p %s -b %s -D BD_ARCH=%s -t %s -n %d %s' % (tool, platformfile, target, Macro, toolchain, threadnum, Arch)
     ret = subprocess.call(cmd.split())
@@ -113,12 +179,19 @@ def build(platform, architectrue, target, threadnum):
       print('building payload failed')
       exit(1)
     payload = 'Build/UefiPayloadPkg%s/%s_%s/FV' % (architectrue, target, toolchain)
+    patched = hash_files([os.path.join(payload, 'PEIFV.Fv'), os.path.join(payload, 'UEFIPAYLOAD.fd')])
+    if manifest.get('patch', {}).get(payload) == patched:
+      print('payload unchanged, skip patching')
+      return
     ret = subprocess.call(['python', '../UEFIPayload/UefiPayloadPkg/Tools/PatchFv.py', payload, 'PEIFV:UEFIPAYLOAD',
                            '0x0000, SecCore:__ModuleEntryPoint, @Payload Entry point',
                            '0x0004, 0x600000                  , @Payload execution base'])
     if ret:
       print('patching failed')
       exit(1)
+    manifest.setdefault('patch', {})[payload] = \
+      hash_files([os.path.join(payload, 'PEIFV.Fv'), os.path.join(payload, 'UEFIPAYLOAD.fd')])
+    save_manifest(manifestfile, manifest)
 
 if __name__ == '__main__':
 
@@ -381,6 +381,17 @@ typedef enum {
   PID7                               = 0xA9,
 } SC_SBI_PID;
 
+//
+// One read-modify-write of a 4-byte PCR register in a PchPcrBatch() call.
+// An AndMask of 0 writes OrMask without reading the register.
+//
+typedef struct {
+  SC_SBI_PID                         Pid;
+  UINT16                             Offset;
+  UINT32                             AndMask;
+  UINT32                             OrMask;
+} SC_PCR_BATCH_OP;
+
 /**
   Read PCR register.
   It returns PCR register and size in 1byte/2bytes/4bytes.
@@ -520,6 +531,68 @@ PchPcrAndThenOr32 (
   return Status;
 }
 
+/**
+  Apply a list of read-modify-writes to 4-byte PCR registers in order.
+  The posted writes are flushed once, by reading back the last register
+  written, instead of after each write.
+
+  @param[in]  Ops                       The operations, applied in array order.
+  @param[in]  Count                     The number of operations.
+
+  @retval     EFI_SUCCESS               Successfully completed.
+  @retval     EFI_INVALID_PARAMETER     An offset is not 4-byte aligned, or a
+                                        register must be accessed through SBI.
+                                        No operation was applied.
+
+**/
+STATIC
+EFI_STATUS
+PchPcrBatch (
+  IN  CONST SC_PCR_BATCH_OP             *Ops,
+  IN  UINTN                             Count
+  )
+{
+  UINTN                                 Index;
+  UINT32                                Address;
+  UINT32                                Data32;
+
+  for (Index = 0; Index < Count; Index++) {
+    if ((Ops[Index].Offset & (sizeof (UINT32) - 1)) != 0) {
+      DEBUG ((DEBUG_ERROR, "PchPcrBatch error. Invalid Offset: %x\n", Ops[Index].Offset));
+      ASSERT (FALSE);
+      return EFI_INVALID_PARAMETER;
+    }
+#ifdef EFI_DEBUG
+    if (!PchPcrWriteMmioCheck (Ops[Index].Pid, Ops[Index].Offset)) {
+      DEBUG ((DEBUG_ERROR, "PchPcrBatch error. Pid: %x Offset: %x should access through SBI interface", Ops[Index].Pid, Ops[Index].Offset));
+      ASSERT (FALSE);
+      return EFI_INVALID_PARAMETER;
+    }
+#endif
+  }
+  if (Count == 0) {
+    return EFI_SUCCESS;
+  }
+
+  Address = 0;
+  for (Index = 0; Index < Count; Index++) {
+    Address = SC_PCR_ADDRESS (Ops[Index].Pid, Ops[Index].Offset);
+    Data32  = 0;
+    if (Ops[Index].AndMask != 0) {
+      Data32 = MmioRead32 (Address);
+    }
+    Data32 = (Data32 & Ops[Index].AndMask) | Ops[Index].OrMask;
+    MmioWrite32 (Address, Data32);
+  }
+
+  //
+  // Read back the last register to flush the posted writes
+  //
+  MmioRead32 (Address);
+
+  return EFI_SUCCESS;
+}
+
 /**
   South Cluster initialization on End-Of-DXE event
 
@@ -543,6 +616,7 @@ ScOnEndOfDxe (
   UINT16                     Data16And;
   UINT16                     Data16;
   UINTN                      SpiBar0;
+  SC_PCR_BATCH_OP            PcrOps[1];
 
   Data8 = 0;
   SpiBar0 = 0;
@@ -648,12 +722,11 @@ ScOnEndOfDxe (
 
   Data32And = 0xFFFFFFFF;
   Data32Or  = (B_PCH_PCR_RTC_CONF_UCMOS_LOCK | B_PCH_PCR_RTC_CONF_LCMOS_LOCK | B_PCH_PCR_RTC_CONF_BILD);
-  PchPcrAndThenOr32 (
-    0xD1,
-    R_PCH_PCR_RTC_CONF,
-    Data32And,
-    Data32Or
-    );
+  PcrOps[0].Pid     = PID0;
+  PcrOps[0].Offset  = R_PCH_PCR_RTC_CONF;
+  PcrOps[0].AndMask = Data32And;
+  PcrOps[0].OrMask  = Data32Or;
+  PchPcrBatch (PcrOps, sizeof (PcrOps) / sizeof (PcrOps[0]));
 
   DEBUG ((DEBUG_INFO, "ScOnEndOfDxe() End\n"));
 
@@ -137,12 +137,114 @@ ScSmmEnableGlobalSmiBit (
 }
 
 
+//
+// SMI status register cleared by the SMI handler
+//
+typedef struct {
+  UINT16    StsOffset;    ///< Status register, relative to the ACPI base
+  UINT8     Width;        ///< Register width in bytes, 2 or 4
+  BOOLEAN   SciShared;    ///< The sources become SCIs once SCI_EN is set
+  UINT32    W1cMask;      ///< Status bits to clear, write 1 to clear
+  UINT16    EnOffset;     ///< Enable register, relative to the ACPI base
+  UINT32    EnMask;       ///< Enables that route any of the sources to an SMI
+} SC_SMI_STS_SOURCE;
+
+//
+// Entry of the table built by SwSmiInitHardware()
+//
+typedef struct {
+  UINT16    Port;
+  UINT8     Width;
+  BOOLEAN   SciShared;
+  UINT32    W1cMask;
+} SC_SMI_STS_CLEAR;
+
+//
+// Enables programmed into SMI_EN each time EOS is set
+//
+#define SC_SMI_EN_VALUE   (B_SMI_EN_SWSMI_TMR | B_SMI_EN_APMC | B_SMI_EN_GBL_SMI)
+
+STATIC CONST SC_SMI_STS_SOURCE mSmiStsSources[] = {
+  {
+    R_ACPI_PM1_STS, 2, TRUE,
+    B_ACPI_PM1_STS_WAK | B_ACPI_PM1_STS_WAK_PCIE0 | B_ACPI_PM1_STS_PRBTNOR |
+    B_ACPI_PM1_STS_RTC | B_ACPI_PM1_STS_PWRBTN | B_ACPI_PM1_STS_GBL |
+    B_ACPI_PM1_STS_WAK_PCIE3 | B_ACPI_PM1_STS_WAK_PCIE2 | B_ACPI_PM1_STS_WAK_PCIE1 |
+    B_ACPI_PM1_STS_TMROF,
+    R_ACPI_PM1_EN,
+    B_ACPI_PM1_EN_RTC | B_ACPI_PM1_EN_PWRBTN | B_ACPI_PM1_EN_GBL | B_ACPI_PM1_EN_TMROF
+  },
+  {
+    R_ACPI_GPE0a_STS, 4, TRUE,
+    B_ACPI_GPE0a_STS_PME_B0 | B_ACPI_GPE0a_STS_BATLOW | B_ACPI_GPE0a_STS_PCI_EXP |
+    B_ACPI_GPE0a_STS_GUNIT_SCI | B_ACPI_GPE0a_STS_PUNIT_SCI | B_ACPI_GPE0a_STS_SWGPE |
+    B_ACPI_GPE0a_STS_HOT_PLUG,
+    R_ACPI_GPE0a_EN,
+    B_ACPI_GPE0a_EN_XHCI_PME_EN | B_ACPI_GPE0a_EN_BATLOW_EN | B_ACPI_GPE0a_EN_PCIE_GPE_EN |
+    B_ACPI_GPE0a_EN_PUNIT_SCI_EN | B_ACPI_GPE0a_EN_SWGPE_EN
+  },
+  {
+    //
+    // Sources whose enables live outside SMI_EN also latch here, so every set
+    // bit is written back
+    //
+    R_SMI_STS, 4, FALSE,
+    MAX_UINT32,
+    R_SMI_EN,
+    B_SMI_EN_PERIODIC | B_SMI_EN_TCO | B_SMI_EN_SWSMI_TMR | B_SMI_EN_APMC |
+    B_SMI_EN_ON_SLP_EN | B_SMI_EN_BIOS
+  },
+  {
+    R_TCO_STS, 4, FALSE,
+    B_TCO_STS_SECOND_TO | B_TCO_STS_TIMEOUT,
+    R_SMI_EN,
+    B_SMI_EN_TCO
+  }
+};
+
+STATIC SC_SMI_STS_CLEAR  mSmiStsClear[sizeof (mSmiStsSources) / sizeof (mSmiStsSources[0])];
+STATIC UINTN             mSmiStsClearCount = 0;
+STATIC BOOLEAN           mSmiStsSciShared  = FALSE;
+
+/**
+  Clear the latched status bits of a register in the SMI status table.
+
+  Only the bits that read back as set are written, so sources that latch
+  after the read stay pending for the next SMI.
+
+  @param[in]  Entry     The table entry.
+
+**/
+STATIC
+VOID
+ScSmmClearLatched (
+  IN CONST SC_SMI_STS_CLEAR  *Entry
+  )
+{
+  UINT32    Latched;
+
+  if (Entry->Width == 2) {
+    Latched = IoRead16 (Entry->Port) & Entry->W1cMask;
+    if (Latched != 0) {
+      IoWrite16 (Entry->Port, (UINT16) Latched);
+    }
+  } else {
+    Latched = IoRead32 (Entry->Port) & Entry->W1cMask;
+    if (Latched != 0) {
+      IoWrite32 (Entry->Port, Latched);
+    }
+  }
+}
+
 /**
-  Clears the SMI after all SMI source have been processed.
-  Note that this function will not work correctly (as it is
-  written) unless all SMI sources have been processed.
-  A revision of this function could manually clear all SMI
-  status bits to guarantee success.
+  Clears all SMI sources regardless of their enables, then builds the table of
+  status registers that SwSmiSetAndCheckEos() clears on each SMI.
+
+  A register is left out of the table when none of its sources can raise an
+  SMI with the current enables. SMI_EN is reprogrammed with SC_SMI_EN_VALUE
+  on every EOS, so the SMI_STS and TCO_STS entries are filtered against it.
+  SMI_STS always stays in the table with all of its bits, since it also
+  latches sources enabled outside SMI_EN, such as GPIO and eSPI SMIs.
 
   @retval  EFI_SUCCESS             Clears the SMIs completed
   @retval  EFI_DEVICE_ERROR        EOS was not set to a 1
@@ -153,79 +255,57 @@ ScSmmClearSmi (
   VOID
   )
 {
-  BOOLEAN   EosSet;
-  BOOLEAN   SciEn;
-  UINT32    Pm1Cnt;
-  UINT16    Pm1Sts;
-  UINT32    Gpe0aStsLow;
-  UINT32    SmiSts;
-  UINT32    TcoSts;
+  BOOLEAN                   EosSet;
+  BOOLEAN                   SciEn;
+  UINTN                     Index;
+  CONST SC_SMI_STS_SOURCE   *Source;
+  SC_SMI_STS_CLEAR          *Entry;
+  UINT32                    Enables;
 
   //
   // Determine whether an ACPI OS is present (via the SCI_EN bit)
   //
-  Pm1Cnt  = IoRead32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_ACPI_PM1_CNT));
-  SciEn   = (BOOLEAN) ((Pm1Cnt & B_ACPI_PM1_CNT_SCI_EN) == B_ACPI_PM1_CNT_SCI_EN);
-  if (!SciEn) {
+  SciEn = IsSciEnabled ();
+
+  mSmiStsClearCount = 0;
+  mSmiStsSciShared  = FALSE;
+  for (Index = 0; Index < sizeof (mSmiStsSources) / sizeof (mSmiStsSources[0]); Index++) {
+    Source = &mSmiStsSources[Index];
+    if (Source->SciShared && SciEn) {
+      //
+      // The OS owns the sources that double as SCIs
+      //
+      continue;
+    }
+
+    Entry            = &mSmiStsClear[mSmiStsClearCount];
+    Entry->Port      = (UINT16) (mAcpiBaseAddr + Source->StsOffset);
+    Entry->Width     = Source->Width;
+    Entry->SciShared = Source->SciShared;
+    Entry->W1cMask   = Source->W1cMask;
+
     //
-    // Clear any SMIs that double as SCIs (when SCI_EN==0)
+    // Clear everything that is latched, enabled or not
     //
-    Pm1Sts        = IoRead16 ((UINTN)(UINT32)(mAcpiBaseAddr + R_ACPI_PM1_STS));
-    Gpe0aStsLow   = IoRead32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_ACPI_GPE0a_STS));
-
-    Pm1Sts |=
-      (
-       B_ACPI_PM1_STS_WAK |
-       B_ACPI_PM1_STS_WAK_PCIE0 |
-       B_ACPI_PM1_STS_PRBTNOR |
-       B_ACPI_PM1_STS_RTC |
-       B_ACPI_PM1_STS_PWRBTN |
-       B_ACPI_PM1_STS_GBL |
-       B_ACPI_PM1_STS_WAK_PCIE3 |
-       B_ACPI_PM1_STS_WAK_PCIE2 |
-       B_ACPI_PM1_STS_WAK_PCIE1 |
-       B_ACPI_PM1_STS_TMROF
-       );
-
-    Gpe0aStsLow |=
-      (
-       B_ACPI_GPE0a_STS_PME_B0 |
-       B_ACPI_GPE0a_STS_BATLOW |
-       B_ACPI_GPE0a_STS_PCI_EXP |
-       B_ACPI_GPE0a_STS_GUNIT_SCI |
-       B_ACPI_GPE0a_STS_PUNIT_SCI |
-       B_ACPI_GPE0a_STS_SWGPE |
-       B_ACPI_GPE0a_STS_HOT_PLUG
-       );
-
-    IoWrite16 ((UINTN)(UINT32)(mAcpiBaseAddr + R_ACPI_PM1_STS), (UINT16) Pm1Sts);
-    IoWrite32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_ACPI_GPE0a_STS), (UINT32) Gpe0aStsLow);
+    ScSmmClearLatched (Entry);
+
+    if (Source->EnOffset == R_SMI_EN) {
+      Enables = SC_SMI_EN_VALUE;
+    } else if (Source->Width == 2) {
+      Enables = IoRead16 ((UINTN)(UINT32)(mAcpiBaseAddr + Source->EnOffset));
+    } else {
+      Enables = IoRead32 ((UINTN)(UINT32)(mAcpiBaseAddr + Source->EnOffset));
+    }
+    if ((Enables & Source->EnMask) == 0) {
+      continue;
+    }
+
+    mSmiStsSciShared |= Source->SciShared;
+    mSmiStsClearCount++;
   }
-
-  //
-  // Clear all SMIs that are unaffected by SCI_EN
-  //
-  SmiSts = IoRead32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_SMI_STS));
-  TcoSts = IoRead32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_TCO_STS));
-
-  SmiSts |=
-    (
-     B_SMI_STS_PERIODIC |
-     B_SMI_STS_TCO |
-     B_SMI_STS_SWSMI_TMR |
-     B_SMI_STS_APM |
-     B_SMI_STS_ON_SLP_EN |
-     B_SMI_STS_BIOS
-     );
-
-  TcoSts |=
-    (
-     B_TCO_STS_SECOND_TO |
-     B_TCO_STS_TIMEOUT
-     );
+  DEBUG ((DEBUG_INFO, "ScSmmClearSmi: %d SMI status registers cleared per SMI\n", mSmiStsClearCount));
 
 //to-do GpioClearAllGpiSmiSts ();
-  IoWrite32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_SMI_STS), SmiSts);
 
   //
   // Try to clear the EOS bit. ASSERT on an error
@@ -256,7 +336,7 @@ SwSmiInitHardware (
   EFI_STATUS  Status;
 
   //
-  // Clear all SMIs
+  // Clear all SMIs and build the table cleared on each SMI
   //
   ScSmmClearSmi ();
 
@@ -280,21 +360,32 @@ SwSmiSetAndCheckEos (
   VOID
   )
 {
-  UINT32  SmiEn;
+  UINTN     Index;
+  UINT32    SmiEn;
 
   //
-  // to-do: check this
+  // Once an ACPI OS has set SCI_EN the sources that double as SCIs are its
+  // own, so drop them from the table for good
   //
-  IoWrite32 (0x444, 0xFFFFFFFF); // clear SMI_STS
-  IoWrite32 (0x440, 0x63); // set APMC, Global SMI, and EOS
+  if (mSmiStsSciShared && IsSciEnabled ()) {
+    for (Index = 0; Index < mSmiStsClearCount; ) {
+      if (mSmiStsClear[Index].SciShared) {
+        mSmiStsClear[Index] = mSmiStsClear[--mSmiStsClearCount];
+      } else {
+        Index++;
+      }
+    }
+    mSmiStsSciShared = FALSE;
+  }
 
-  SmiEn = IoRead32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_SMI_EN));
+  for (Index = 0; Index < mSmiStsClearCount; Index++) {
+    ScSmmClearLatched (&mSmiStsClear[Index]);
+  }
 
   //
   // Reset the SC to generate subsequent SMIs
   //
-  SmiEn |= B_SMI_EN_EOS;
-  IoWrite32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_SMI_EN), SmiEn);
+  IoWrite32 ((UINTN)(UINT32)(mAcpiBaseAddr + R_SMI_EN), SC_SMI_EN_VALUE | B_SMI_EN_EOS);
 
   //
   // Double check that the assert worked
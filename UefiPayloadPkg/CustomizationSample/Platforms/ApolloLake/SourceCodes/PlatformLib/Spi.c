@@ -0,0 +1,302 @@
+/** @file
+  Access to the SPI flash variable region through hardware sequencing.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "Variable.h"
+#include <Library/CacheMaintenanceLib.h>
+#include "Include/ScAccess.h"
+
+STATIC FLASH_VARIABLE_DEVICE  mSpiFlashDevice;
+STATIC UINTN                  mSpiBar0;
+STATIC UINT32                 mSpiFlashOffset;
+STATIC UINTN                  mSpiMmioBase;
+
+/**
+  Run one hardware sequencing cycle and wait for it to finish.
+
+  @param[in] Cycle       Flash cycle type (V_SPI_HSFS_CYCLE_xxx).
+  @param[in] Address     Linear flash address.
+  @param[in] Count       Number of data bytes, 1 to SPI_FLASH_FDATA_SIZE. Ignored for erase.
+
+  @retval EFI_SUCCESS        The cycle completed.
+  @retval EFI_DEVICE_ERROR   The cycle failed, was blocked, or timed out.
+
+**/
+STATIC
+EFI_STATUS
+SpiHwSeqCycle (
+  IN UINT32       Cycle,
+  IN UINT32       Address,
+  IN UINT32       Count
+  )
+{
+  UINT32          HsfsCtl;
+  UINTN           Index;
+
+  for (Index = 0; Index < SPI_FLASH_POLL_COUNT; Index++) {
+    if ((MmioRead32 (mSpiBar0 + R_SPI_HSFS) & B_SPI_HSFS_SCIP) == 0) {
+      break;
+    }
+  }
+  if (Index == SPI_FLASH_POLL_COUNT) {
+    return EFI_DEVICE_ERROR;
+  }
+
+  //
+  // Clear the status bits left by the previous cycle
+  //
+  MmioOr32 (mSpiBar0 + R_SPI_HSFS, B_SPI_HSFS_AEL | B_SPI_HSFS_FCERR | B_SPI_HSFS_FDONE);
+  MmioWrite32 (mSpiBar0 + R_SPI_FADDR, Address & B_SPI_FADDR_MASK);
+
+  HsfsCtl  = MmioRead32 (mSpiBar0 + R_SPI_HSFS);
+  HsfsCtl &= ~(B_SPI_HSFS_CYCLE_MASK | B_SPI_HSFS_FDBC_MASK | B_SPI_HSFS_AEL | B_SPI_HSFS_FCERR | B_SPI_HSFS_FDONE);
+  HsfsCtl |= (Cycle << N_SPI_HSFS_CYCLE) & B_SPI_HSFS_CYCLE_MASK;
+  if (Count != 0) {
+    HsfsCtl |= ((Count - 1) << N_SPI_HSFS_FDBC) & B_SPI_HSFS_FDBC_MASK;
+  }
+  MmioWrite32 (mSpiBar0 + R_SPI_HSFS, HsfsCtl | B_SPI_HSFS_CYCLE_FGO);
+
+  for (Index = 0; Index < SPI_FLASH_POLL_COUNT; Index++) {
+    HsfsCtl = MmioRead32 (mSpiBar0 + R_SPI_HSFS);
+    if ((HsfsCtl & (B_SPI_HSFS_FDONE | B_SPI_HSFS_FCERR)) != 0) {
+      break;
+    }
+  }
+  if ((HsfsCtl & (B_SPI_HSFS_FCERR | B_SPI_HSFS_AEL)) != 0 || (HsfsCtl & B_SPI_HSFS_FDONE) == 0) {
+    DEBUG ((DEBUG_ERROR, "SpiFlash: cycle %d at 0x%x failed, HSFS 0x%x\n", Cycle, Address, HsfsCtl));
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Allow or forbid writes to the BIOS region. Once EndOfDxe sets SMM_BWP, this
+  only succeeds in SMM.
+
+  @param[in] Enable    TRUE to allow writes.
+
+**/
+STATIC
+VOID
+SpiSetBiosWrite (
+  IN BOOLEAN      Enable
+  )
+{
+  UINTN           PciSpiRegBase;
+
+  PciSpiRegBase = MmPciBase (DEFAULT_PCI_BUS_NUMBER_SC, PCI_DEVICE_NUMBER_SPI, PCI_FUNCTION_NUMBER_SPI);
+  if (Enable) {
+    MmioOr32 (PciSpiRegBase + R_SPI_BCR, B_SPI_BCR_BIOSWE);
+  } else {
+    MmioAnd32 (PciSpiRegBase + R_SPI_BCR, (UINT32) ~B_SPI_BCR_BIOSWE);
+  }
+}
+
+/**
+  Read from the flash variable region.
+
+  The memory mapped copy of the region is used when the bootloader provides one.
+
+  @param[in]  Device     The flash device.
+  @param[in]  Offset     Offset in the region.
+  @param[out] Buffer     Buffer receiving the data.
+  @param[in]  Size       Number of bytes to read.
+
+  @retval EFI_SUCCESS        The data was read.
+  @retval EFI_DEVICE_ERROR   The SPI controller reported an error.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SpiFlashRead (
+  IN  FLASH_VARIABLE_DEVICE  *Device,
+  IN  UINT32                 Offset,
+  OUT VOID                   *Buffer,
+  IN  UINT32                 Size
+  )
+{
+  EFI_STATUS                 Status;
+  UINT8                      *Destination;
+  UINT32                     Count;
+  UINT32                     Index;
+
+  if (mSpiMmioBase != 0) {
+    CopyMem (Buffer, (VOID *) (mSpiMmioBase + Offset), Size);
+    return EFI_SUCCESS;
+  }
+
+  Destination = (UINT8 *) Buffer;
+  while (Size > 0) {
+    Count  = MIN (Size, SPI_FLASH_FDATA_SIZE);
+    Status = SpiHwSeqCycle (V_SPI_HSFS_CYCLE_READ, mSpiFlashOffset + Offset, Count);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    for (Index = 0; Index < Count; Index++) {
+      Destination[Index] = MmioRead8 (mSpiBar0 + R_SPI_FDATA00 + Index);
+    }
+    Destination += Count;
+    Offset      += Count;
+    Size        -= Count;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Program the flash variable region.
+
+  @param[in] Device      The flash device.
+  @param[in] Offset      Offset in the region.
+  @param[in] Buffer      Data to program.
+  @param[in] Size        Number of bytes to program.
+
+  @retval EFI_SUCCESS        The data was programmed.
+  @retval EFI_DEVICE_ERROR   The SPI controller reported an error.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SpiFlashWrite (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset,
+  IN CONST VOID              *Buffer,
+  IN UINT32                  Size
+  )
+{
+  EFI_STATUS                 Status;
+  CONST UINT8                *Source;
+  UINT32                     Count;
+  UINT32                     Index;
+  UINT32                     Data;
+  UINT32                     Start;
+  UINT32                     Length;
+
+  Status = EFI_SUCCESS;
+  Source = (CONST UINT8 *) Buffer;
+  Start  = Offset;
+  Length = Size;
+
+  SpiSetBiosWrite (TRUE);
+  while (Size > 0) {
+    //
+    // A cycle must not cross a flash page
+    //
+    Count = MIN (Size, SPI_FLASH_FDATA_SIZE);
+    Count = MIN (Count, SPI_FLASH_PAGE_SIZE - ((mSpiFlashOffset + Offset) & (SPI_FLASH_PAGE_SIZE - 1)));
+    for (Index = 0; Index < Count; Index += sizeof (UINT32)) {
+      Data = 0xFFFFFFFF;
+      CopyMem (&Data, Source + Index, MIN (sizeof (UINT32), Count - Index));
+      MmioWrite32 (mSpiBar0 + R_SPI_FDATA00 + Index, Data);
+    }
+    Status = SpiHwSeqCycle (V_SPI_HSFS_CYCLE_WRITE, mSpiFlashOffset + Offset, Count);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+    Source += Count;
+    Offset += Count;
+    Size   -= Count;
+  }
+  SpiSetBiosWrite (FALSE);
+
+  if (mSpiMmioBase != 0) {
+    WriteBackInvalidateDataCacheRange ((VOID *) (mSpiMmioBase + Start), Length);
+  }
+  return Status;
+}
+
+/**
+  Erase one block of the flash variable region.
+
+  @param[in] Device      The flash device.
+  @param[in] Offset      Block aligned offset in the region.
+
+  @retval EFI_SUCCESS        The block was erased.
+  @retval EFI_DEVICE_ERROR   The SPI controller reported an error.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SpiFlashErase (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset
+  )
+{
+  EFI_STATUS                 Status;
+  UINT32                     Erased;
+
+  ASSERT ((Offset % Device->BlockSize) == 0);
+
+  Status = EFI_SUCCESS;
+  SpiSetBiosWrite (TRUE);
+  for (Erased = 0; Erased < Device->BlockSize; Erased += SPI_FLASH_ERASE_SIZE) {
+    Status = SpiHwSeqCycle (V_SPI_HSFS_CYCLE_4K_ERASE, mSpiFlashOffset + Offset + Erased, 0);
+    if (EFI_ERROR (Status)) {
+      break;
+    }
+  }
+  SpiSetBiosWrite (FALSE);
+
+  if (mSpiMmioBase != 0) {
+    WriteBackInvalidateDataCacheRange ((VOID *) (mSpiMmioBase + Offset), Device->BlockSize);
+  }
+  return Status;
+}
+
+/**
+  Set up the SPI flash device over the variable region.
+
+  @param[in]  FlashVarInfo   The variable region described by the bootloader.
+
+  @return The flash device, or NULL if the region cannot be used.
+
+**/
+FLASH_VARIABLE_DEVICE *
+SpiFlashDeviceInitialize (
+  IN CONST FLASH_VARIABLE_INFO  *FlashVarInfo
+  )
+{
+  UINTN                         PciSpiRegBase;
+
+  if ((FlashVarInfo->BlockSize == 0) || ((FlashVarInfo->BlockSize % SPI_FLASH_ERASE_SIZE) != 0) ||
+      ((FlashVarInfo->FlashOffset % FlashVarInfo->BlockSize) != 0) ||
+      ((FlashVarInfo->Size % FlashVarInfo->BlockSize) != 0)) {
+    DEBUG ((DEBUG_ERROR, "SpiFlash: unusable variable region 0x%x/0x%x, block 0x%x\n",
+      FlashVarInfo->FlashOffset, FlashVarInfo->Size, FlashVarInfo->BlockSize));
+    return NULL;
+  }
+
+  PciSpiRegBase = MmPciBase (DEFAULT_PCI_BUS_NUMBER_SC, PCI_DEVICE_NUMBER_SPI, PCI_FUNCTION_NUMBER_SPI);
+  mSpiBar0      = MmioRead32 (PciSpiRegBase + R_SPI_BASE) & B_SPI_BASE_BAR;
+  if (mSpiBar0 == 0) {
+    mSpiBar0 = SPI_BASE_ADDRESS;
+    MmioWrite32 (PciSpiRegBase + R_SPI_BASE, (UINT32) mSpiBar0);
+    MmioOr16 (PciSpiRegBase + R_SPI_COMMAND, BIT1);
+  }
+  mSpiFlashOffset = FlashVarInfo->FlashOffset;
+  mSpiMmioBase    = (UINTN) FlashVarInfo->MmioBase;
+
+  mSpiFlashDevice.Size      = FlashVarInfo->Size;
+  mSpiFlashDevice.BlockSize = FlashVarInfo->BlockSize;
+  mSpiFlashDevice.Read      = SpiFlashRead;
+  mSpiFlashDevice.Write     = SpiFlashWrite;
+  mSpiFlashDevice.Erase     = SpiFlashErase;
+
+  DEBUG ((DEBUG_INFO, "SpiFlash: variable region at 0x%x, size 0x%x, SPI BAR 0x%lx\n",
+    mSpiFlashOffset, FlashVarInfo->Size, (UINT64) mSpiBar0));
+  return &mSpiFlashDevice;
+}
@@ -0,0 +1,48 @@
+/** @file
+  Definitions for the ApolloLake platform variable store.
+
+  Variables are kept by FlashVariableStoreLib in the SPI flash region that the
+  bootloader describes with the flash variable info HOB. The region is reached
+  through the hardware sequencing interface of the SPI controller.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _APL_VARIABLE_H_
+#define _APL_VARIABLE_H_
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/FlashVariableStoreLib.h>
+#include <Guid/FlashVariableInfoGuid.h>
+
+#define SPI_FLASH_ERASE_SIZE            0x1000
+#define SPI_FLASH_PAGE_SIZE             0x100
+#define SPI_FLASH_FDATA_SIZE            0x40
+#define SPI_FLASH_POLL_COUNT            0x1000000
+
+/**
+  Set up the SPI flash device over the variable region.
+
+  @param[in]  FlashVarInfo   The variable region described by the bootloader.
+
+  @return The flash device, or NULL if the region cannot be used.
+
+**/
+FLASH_VARIABLE_DEVICE *
+SpiFlashDeviceInitialize (
+  IN CONST FLASH_VARIABLE_INFO  *FlashVarInfo
+  );
+
+#endif
@@ -0,0 +1,229 @@
+/** @file
+  Access to the Qemu pflash (Intel CFI command set) variable region.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "Variable.h"
+
+#define CFI_QUERY_OFFSET        0x55
+#define CFI_QUERY_STRING_OFFSET 0x10
+
+#define WRITE_BYTE_CMD          0x10
+#define BLOCK_ERASE_CMD         0x20
+#define CLEAR_STATUS_CMD        0x50
+#define READ_STATUS_CMD         0x70
+#define CFI_QUERY_CMD           0x98
+#define BLOCK_ERASE_CONFIRM_CMD 0xD0
+#define READ_ARRAY_CMD          0xFF
+
+#define STATUS_READY            BIT7
+#define STATUS_ERROR_MASK       (BIT5 | BIT4 | BIT3 | BIT1)
+
+#define FLASH_POLL_COUNT        0x100000
+
+STATIC UINTN                    mFlashBase;
+STATIC FLASH_VARIABLE_DEVICE    mFlashDevice;
+
+/**
+  Wait for the flash to finish the current operation and return to read array mode.
+
+  @param[in] Address   Address the last command was issued to.
+
+  @retval EFI_SUCCESS        The operation completed without error.
+  @retval EFI_DEVICE_ERROR   The operation failed or timed out.
+
+**/
+STATIC
+EFI_STATUS
+QemuFlashWaitReady (
+  IN UINTN      Address
+  )
+{
+  UINTN         Count;
+  UINT8         FlashStatus;
+
+  MmioWrite8 (Address, READ_STATUS_CMD);
+  FlashStatus = 0;
+  for (Count = 0; Count < FLASH_POLL_COUNT; Count++) {
+    FlashStatus = MmioRead8 (Address);
+    if ((FlashStatus & STATUS_READY) != 0) {
+      break;
+    }
+  }
+
+  if ((FlashStatus & STATUS_ERROR_MASK) != 0) {
+    MmioWrite8 (Address, CLEAR_STATUS_CMD);
+  }
+  MmioWrite8 (Address, READ_ARRAY_CMD);
+
+  if (((FlashStatus & STATUS_READY) == 0) || ((FlashStatus & STATUS_ERROR_MASK) != 0)) {
+    DEBUG ((DEBUG_ERROR, "QemuFlash: operation at 0x%lx failed, status 0x%x\n", (UINT64) Address, FlashStatus));
+    return EFI_DEVICE_ERROR;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Read from the flash variable region.
+
+  @param[in]  Device     The flash device.
+  @param[in]  Offset     Offset in the region.
+  @param[out] Buffer     Buffer receiving the data.
+  @param[in]  Size       Number of bytes to read.
+
+  @retval EFI_SUCCESS    The data was read.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+QemuFlashRead (
+  IN  FLASH_VARIABLE_DEVICE  *Device,
+  IN  UINT32                 Offset,
+  OUT VOID                   *Buffer,
+  IN  UINT32                 Size
+  )
+{
+  ASSERT (Offset + Size <= Device->Size);
+
+  CopyMem (Buffer, (VOID *) (mFlashBase + Offset), Size);
+  return EFI_SUCCESS;
+}
+
+/**
+  Program a buffer into the flash variable region.
+
+  The target bytes are expected to be erased or to only need bits cleared.
+
+  @param[in] Device      The flash device.
+  @param[in] Offset      Offset in the region.
+  @param[in] Buffer      Data to program.
+  @param[in] Size        Number of bytes to program.
+
+  @retval EFI_SUCCESS        The data was programmed.
+  @retval EFI_DEVICE_ERROR   The flash reported an error.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+QemuFlashWrite (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset,
+  IN CONST VOID              *Buffer,
+  IN UINT32                  Size
+  )
+{
+  EFI_STATUS      Status;
+  UINTN           Address;
+  CONST UINT8     *Source;
+  UINTN           Index;
+
+  ASSERT (Offset + Size <= Device->Size);
+
+  Address = mFlashBase + Offset;
+  Source  = (CONST UINT8 *) Buffer;
+  for (Index = 0; Index < Size; Index++) {
+    //
+    // Erased bytes need no programming
+    //
+    if (Source[Index] == 0xFF) {
+      continue;
+    }
+    MmioWrite8 (Address + Index, WRITE_BYTE_CMD);
+    MmioWrite8 (Address + Index, Source[Index]);
+    Status = QemuFlashWaitReady (Address + Index);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Erase one block of the flash variable region.
+
+  @param[in] Device      The flash device.
+  @param[in] Offset      Block aligned offset in the region.
+
+  @retval EFI_SUCCESS        The block was erased.
+  @retval EFI_DEVICE_ERROR   The flash reported an error.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+QemuFlashErase (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset
+  )
+{
+  UINTN           Address;
+
+  ASSERT ((Offset % Device->BlockSize) == 0);
+  ASSERT (Offset < Device->Size);
+
+  Address = mFlashBase + Offset;
+  MmioWrite8 (Address, BLOCK_ERASE_CMD);
+  MmioWrite8 (Address, BLOCK_ERASE_CONFIRM_CMD);
+
+  return QemuFlashWaitReady (Address);
+}
+
+/**
+  Set up the Qemu pflash device over the variable region.
+
+  @param[in]  FlashVarInfo   The variable region described by the bootloader.
+
+  @return The flash device, or NULL if the region is not mapped or does not
+          respond to CFI commands.
+
+**/
+FLASH_VARIABLE_DEVICE *
+QemuFlashDeviceInitialize (
+  IN CONST FLASH_VARIABLE_INFO  *FlashVarInfo
+  )
+{
+  UINTN         Base;
+  BOOLEAN       Detected;
+
+  if ((FlashVarInfo->MmioBase == 0) ||
+      (FlashVarInfo->MmioBase + FlashVarInfo->Size > BASE_4GB) ||
+      (FlashVarInfo->BlockSize != QEMU_FLASH_BLOCK_SIZE) ||
+      ((FlashVarInfo->MmioBase & (QEMU_FLASH_BLOCK_SIZE - 1)) != 0)) {
+    DEBUG ((DEBUG_ERROR, "QemuFlash: unusable variable region 0x%lx size 0x%x block 0x%x\n",
+      FlashVarInfo->MmioBase, FlashVarInfo->Size, FlashVarInfo->BlockSize));
+    return NULL;
+  }
+  Base = (UINTN) FlashVarInfo->MmioBase;
+
+  MmioWrite8 (Base + CFI_QUERY_OFFSET, CFI_QUERY_CMD);
+  Detected = (BOOLEAN) (MmioRead8 (Base + CFI_QUERY_STRING_OFFSET)     == 'Q' &&
+                        MmioRead8 (Base + CFI_QUERY_STRING_OFFSET + 1) == 'R' &&
+                        MmioRead8 (Base + CFI_QUERY_STRING_OFFSET + 2) == 'Y');
+  MmioWrite8 (Base, READ_ARRAY_CMD);
+
+  DEBUG ((DEBUG_INFO, "QemuFlash: variable region at 0x%lx %a\n", (UINT64) Base, Detected ? "detected" : "not writable"));
+  if (!Detected) {
+    return NULL;
+  }
+
+  mFlashBase             = Base;
+  mFlashDevice.Size      = FlashVarInfo->Size;
+  mFlashDevice.BlockSize = FlashVarInfo->BlockSize;
+  mFlashDevice.Read      = QemuFlashRead;
+  mFlashDevice.Write     = QemuFlashWrite;
+  mFlashDevice.Erase     = QemuFlashErase;
+  return &mFlashDevice;
+}
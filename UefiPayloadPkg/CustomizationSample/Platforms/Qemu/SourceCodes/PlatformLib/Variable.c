@@ -0,0 +1,407 @@
+/** @file
+  Variable services for the Qemu platform.
+
+  Variables are kept in a log-structured store on the Qemu pflash region that
+  the bootloader reports with the flash variable info HOB. Without that region,
+  or if the region holds data that is not a variable store, the non-volatile
+  store is emulated in SMRAM and does not survive a reset.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "Variable.h"
+#include <Library/PlatformLib.h>
+#include <Library/HobLib.h>
+
+STATIC BOOLEAN                  mVariableStoreReady = FALSE;
+STATIC UINT8                    *mEmulatedStore;
+STATIC FLASH_VARIABLE_DEVICE    mEmulatedDevice;
+
+/**
+  Read from the RAM device that emulates the flash region.
+
+  @param[in]  Device     The RAM device.
+  @param[in]  Offset     Offset in the device.
+  @param[out] Buffer     Buffer receiving the data.
+  @param[in]  Size       Number of bytes to read.
+
+  @retval EFI_SUCCESS    The data was read.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+EmulatedDeviceRead (
+  IN  FLASH_VARIABLE_DEVICE  *Device,
+  IN  UINT32                 Offset,
+  OUT VOID                   *Buffer,
+  IN  UINT32                 Size
+  )
+{
+  CopyMem (Buffer, mEmulatedStore + Offset, Size);
+  return EFI_SUCCESS;
+}
+
+/**
+  Program the RAM device that emulates the flash region. Like flash, it only clears bits.
+
+  @param[in] Device      The RAM device.
+  @param[in] Offset      Offset in the device.
+  @param[in] Buffer      Data to program.
+  @param[in] Size        Number of bytes to program.
+
+  @retval EFI_SUCCESS    The data was programmed.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+EmulatedDeviceWrite (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset,
+  IN CONST VOID              *Buffer,
+  IN UINT32                  Size
+  )
+{
+  CONST UINT8                *Source;
+  UINT32                     Index;
+
+  Source = (CONST UINT8 *) Buffer;
+  for (Index = 0; Index < Size; Index++) {
+    mEmulatedStore[Offset + Index] &= Source[Index];
+  }
+  return EFI_SUCCESS;
+}
+
+/**
+  Erase one block of the RAM device that emulates the flash region.
+
+  @param[in] Device      The RAM device.
+  @param[in] Offset      Block aligned offset in the device.
+
+  @retval EFI_SUCCESS    The block was erased.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+EmulatedDeviceErase (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset
+  )
+{
+  SetMem (mEmulatedStore + Offset, Device->BlockSize, 0xFF);
+  return EFI_SUCCESS;
+}
+
+/**
+  Platform specific initialization for variable services
+
+  @retval EFI_SUCCESS           Initialization succeeded
+  @retval EFI_DEVICE_ERROR      Some hardware error occurred
+  @retval EFI_OUT_OF_RESOURCES  There are not enough resources to complete initialization
+
+**/
+EFI_STATUS
+EFIAPI
+PlatformLibInitializeVariable (
+  VOID
+  )
+{
+  EFI_HOB_GUID_TYPE      *GuidHob;
+  FLASH_VARIABLE_DEVICE  *Device;
+  EFI_STATUS             Status;
+
+  Device  = NULL;
+  GuidHob = GetFirstGuidHob (&gUefiFlashVariableInfoGuid);
+  if (GuidHob == NULL) {
+    DEBUG ((DEBUG_WARN, "QemuVariable: no flash variable region\n"));
+  } else {
+    Device = QemuFlashDeviceInitialize ((FLASH_VARIABLE_INFO *) GET_GUID_HOB_DATA (GuidHob));
+  }
+
+  if (Device != NULL) {
+    Status = FlashVariableStoreInitialize (Device);
+    if (!EFI_ERROR (Status)) {
+      mVariableStoreReady = TRUE;
+      return EFI_SUCCESS;
+    }
+    DEBUG ((DEBUG_ERROR, "QemuVariable: flash variable store unusable - %r\n", Status));
+  }
+
+  //
+  // Keep variable services working on an emulated region rather than losing them
+  //
+  DEBUG ((DEBUG_WARN, "QemuVariable: variables will not persist\n"));
+  mEmulatedStore = AllocatePool (QEMU_EMULATED_STORE_SIZE);
+  if (mEmulatedStore == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  SetMem (mEmulatedStore, QEMU_EMULATED_STORE_SIZE, 0xFF);
+  mEmulatedDevice.Size      = QEMU_EMULATED_STORE_SIZE;
+  mEmulatedDevice.BlockSize = QEMU_FLASH_BLOCK_SIZE;
+  mEmulatedDevice.Read      = EmulatedDeviceRead;
+  mEmulatedDevice.Write     = EmulatedDeviceWrite;
+  mEmulatedDevice.Erase     = EmulatedDeviceErase;
+
+  Status = FlashVariableStoreInitialize (&mEmulatedDevice);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  mVariableStoreReady = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Set a Variable's content (Volatile or Non-Volatile).
+
+  Caution: This function may receive untrusted input.
+  This function may be invoked in SMM mode, and datasize and data are external input.
+  This function will do basic validation, before parse the data.
+  This function will parse the authentication carefully to avoid security issues, like
+  buffer overflow, integer overflow.
+  This function will check attribute carefully to avoid authentication bypass.
+
+  @param[in] VariableName                     Name of Variable to be found.
+  @param[in] VendorGuid                       Variable vendor GUID.
+  @param[in] Attributes                       Attribute value of the variable found
+  @param[in] DataSize                         Size of Data found. If size is less than the
+                                              data, this value contains the required size.
+  @param[in] Data                             Data pointer.
+
+  @return    EFI_INVALID_PARAMETER            Invalid parameter.
+  @return    EFI_SUCCESS                      Set successfully.
+  @return    EFI_OUT_OF_RESOURCES             Resource not enough to set variable.
+  @return    EFI_NOT_FOUND                    Not found.
+  @return    EFI_WRITE_PROTECTED              Variable is read-only.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableServiceSetVariable (
+  IN CHAR16                  *VariableName,
+  IN EFI_GUID                *VendorGuid,
+  IN UINT32                  Attributes,
+  IN UINTN                   DataSize,
+  IN VOID                    *Data
+  )
+{
+  if (!mVariableStoreReady) {
+    return EFI_UNSUPPORTED;
+  }
+
+  return FlashVariableStoreSetVariable (VariableName, VendorGuid, Attributes, DataSize, Data);
+}
+
+/**
+  Get a variable's content (Volatile or Non-Volatile).
+
+  Caution: This function may receive untrusted input.
+  This function may be invoked in SMM mode, and datasize and data are external input.
+  This function will do basic validation, before parse the data.
+
+  @param[in]      VariableName               Name of Variable to be found.
+  @param[in]      VendorGuid                 Variable vendor GUID.
+  @param[out]     Attributes                 Attribute value of the variable found.
+  @param[in, out] DataSize                   Size of Data found. If size is less than the
+                                             data, this value contains the required size.
+  @param[out]     Data                       Data pointer.
+
+  @return         EFI_INVALID_PARAMETER      Invalid parameter.
+  @return         EFI_SUCCESS                Find the specified variable.
+  @return         EFI_NOT_FOUND              Not found.
+  @return         EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableServiceGetVariable (
+  IN      CHAR16            *VariableName,
+  IN      EFI_GUID          *VendorGuid,
+  OUT     UINT32            *Attributes OPTIONAL,
+  IN OUT  UINTN             *DataSize,
+  OUT     VOID              *Data
+  )
+{
+  if (!mVariableStoreReady) {
+    return EFI_UNSUPPORTED;
+  }
+
+  return FlashVariableStoreGetVariable (VariableName, VendorGuid, Attributes, DataSize, Data);
+}
+
+/**
+
+  Find the next available variable.
+
+  Caution: This function may receive untrusted input.
+  This function may be invoked in SMM mode. This function will do basic validation, before parse the data.
+
+  @param[in, out] VariableNameSize           Size of the variable name.
+  @param[in, out] VariableName               Pointer to variable name.
+  @param[in, out] VendorGuid                 Variable Vendor Guid.
+
+  @return         EFI_INVALID_PARAMETER      Invalid parameter.
+  @return         EFI_SUCCESS                Find the specified variable.
+  @return         EFI_NOT_FOUND              Not found.
+  @return         EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableServiceGetNextVariableName (
+  IN OUT  UINTN             *VariableNameSize,
+  IN OUT  CHAR16            *VariableName,
+  IN OUT  EFI_GUID          *VendorGuid
+  )
+{
+  if (!mVariableStoreReady) {
+    return EFI_UNSUPPORTED;
+  }
+
+  return FlashVariableStoreGetNextVariableName (VariableNameSize, VariableName, VendorGuid);
+}
+
+/**
+  Return information about the UEFI variables.
+
+  Caution: This function may receive untrusted input.
+  This function may be invoked in SMM mode. This function will do basic validation, before parse the data.
+
+  @param[in] Attributes                     Attributes bitmask to specify the type of variables
+                                            on which to return information.
+  @param[out] MaximumVariableStorageSize    Pointer to the maximum size of the storage space available
+                                            for the EFI variables associated with the attributes specified.
+  @param[out] RemainingVariableStorageSize  Pointer to the remaining size of the storage space available
+                                            for EFI variables associated with the attributes specified.
+  @param[out] MaximumVariableSize           Pointer to the maximum size of an individual EFI variables
+                                            associated with the attributes specified.
+
+  @return     EFI_INVALID_PARAMETER         An invalid combination of attribute bits was supplied.
+  @return     EFI_SUCCESS                   Query successfully.
+  @return     EFI_UNSUPPORTED               The attribute is not supported on this platform.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableServiceQueryVariableInfo (
+  IN  UINT32                 Attributes,
+  OUT UINT64                 *MaximumVariableStorageSize,
+  OUT UINT64                 *RemainingVariableStorageSize,
+  OUT UINT64                 *MaximumVariableSize
+  )
+{
+  if (!mVariableStoreReady) {
+    return EFI_UNSUPPORTED;
+  }
+
+  return FlashVariableStoreQueryVariableInfo (
+           Attributes,
+           MaximumVariableStorageSize,
+           RemainingVariableStorageSize,
+           MaximumVariableSize
+           );
+}
+
+/**
+  Get the size of implementation specific variable header
+
+  @return Size of variable header in bytes in type UINTN.
+
+**/
+UINTN
+GetVariableHeaderSize (
+  VOID
+  )
+{
+  return FlashVariableStoreGetHeaderSize ();
+}
+
+/**
+  Get maxim size of a non-volatile Variable.
+
+  @return Non-volatile maximum variable size.
+
+**/
+UINTN
+GetNonVolatileMaxVariableSize (
+  VOID
+  )
+{
+  return FlashVariableStoreGetMaxVariableSize ();
+}
+
+/**
+  Initialize variable quota.
+
+**/
+VOID
+InitializeVariableQuota (
+  VOID
+  )
+{
+  return;
+}
+
+/**
+  This function reclaims variable storage if free space size is below the threshold for OS
+
+**/
+VOID
+ReclaimForOS (
+  VOID
+  )
+{
+  EFI_STATUS                       Status;
+  FLASH_VARIABLE_STORE_STATISTICS  Statistics;
+
+  if (!mVariableStoreReady) {
+    return;
+  }
+
+  Status = FlashVariableStoreReclaim (0);
+  if (EFI_ERROR (Status)) {
+    DEBUG ((DEBUG_ERROR, "QemuVariable: reclaim failed - %r\n", Status));
+  }
+
+  FlashVariableStoreGetStatistics (&Statistics);
+  DEBUG ((DEBUG_INFO, "QemuVariable: requested 0x%lx programmed 0x%lx erased %ld blocks\n",
+    Statistics.BytesRequested, Statistics.BytesProgrammed, Statistics.BlocksErased));
+  DEBUG ((DEBUG_INFO, "QemuVariable: %d/%d banks free, erase count %d..%d, %ld reads in %ld ns\n",
+    Statistics.FreeBanks, Statistics.BankCount, Statistics.MinEraseCount, Statistics.MaxEraseCount,
+    Statistics.ReadCount, Statistics.ReadTime));
+}
+
+/**
+  Mark a variable that will become read-only after leaving the DXE phase of execution.
+
+  @param[in] VariableName          A pointer to the variable name that will be made read-only subsequently.
+  @param[in] VendorGuid            A pointer to the vendor GUID that will be made read-only subsequently.
+
+  @retval    EFI_SUCCESS           The variable specified by the VariableName and the VendorGuid was marked
+                                   as pending to be read-only.
+  @retval    EFI_INVALID_PARAMETER VariableName or VendorGuid is NULL.
+                                   Or VariableName is an empty string.
+  @retval    EFI_ACCESS_DENIED     EFI_END_OF_DXE_EVENT_GROUP_GUID or EFI_EVENT_GROUP_READY_TO_BOOT has
+                                   already been signaled.
+  @retval    EFI_OUT_OF_RESOURCES  There is not enough resource to hold the lock request.
+
+**/
+EFI_STATUS
+EFIAPI
+VariableLockRequestToLock (
+  IN       CHAR16                       *VariableName,
+  IN       EFI_GUID                     *VendorGuid
+  )
+{
+  return EFI_UNSUPPORTED;
+}
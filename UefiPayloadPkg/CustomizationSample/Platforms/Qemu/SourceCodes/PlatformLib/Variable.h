@@ -0,0 +1,52 @@
+/** @file
+  Definitions for the Qemu platform variable store.
+
+  Variables are kept by FlashVariableStoreLib in the Qemu pflash region that the
+  bootloader describes with the flash variable info HOB. Without a usable region
+  the non-volatile store is emulated in SMRAM and does not survive a reset.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef _QEMU_VARIABLE_H_
+#define _QEMU_VARIABLE_H_
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/IoLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/FlashVariableStoreLib.h>
+#include <Guid/FlashVariableInfoGuid.h>
+
+#define QEMU_FLASH_BLOCK_SIZE           0x1000
+
+//
+// Size of the RAM region that stands in for the flash region when there is none
+//
+#define QEMU_EMULATED_STORE_SIZE        0x40000
+
+/**
+  Set up the Qemu pflash device over the variable region.
+
+  @param[in]  FlashVarInfo   The variable region described by the bootloader.
+
+  @return The flash device, or NULL if the region is not mapped or does not
+          respond to CFI commands.
+
+**/
+FLASH_VARIABLE_DEVICE *
+QemuFlashDeviceInitialize (
+  IN CONST FLASH_VARIABLE_INFO  *FlashVarInfo
+  );
+
+#endif
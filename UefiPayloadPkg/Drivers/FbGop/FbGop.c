@@ -1203,6 +1203,7 @@ FbGopVbeBltWorker (
   UINT32                         VbePixelWidth;
   UINT32                         Pixel;
   UINTN                          TotalBytes;
+  BOOLEAN                        FullScanLines;
 
   PciIo             = FbGopPrivate->PciIo;
 
@@ -1257,6 +1258,11 @@ FbGopVbeBltWorker (
     Delta = Width * sizeof (EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
   }
   //
+  // When the destination rows cover whole scan lines they are contiguous in
+  // the frame buffer, so the physical frame buffer is updated in one write.
+  //
+  FullScanLines = (BOOLEAN) (DestinationX == 0 && TotalBytes == BytesPerScanLine);
+  //
   // We have to raise to TPL Notify, so we make an atomic write the frame buffer.
   // We would not want a timer based event (Cursor, ...) to come in while we are
   // doing this operation.
@@ -1285,6 +1291,29 @@ FbGopVbeBltWorker (
     break;
 
   case EfiBltVideoToVideo:
+    if (FullScanLines && SourceX == 0) {
+      //
+      // CopyMem handles the overlap of a scroll
+      //
+      VbeBuffer = (UINT8 *) VbeFrameBuffer + DestinationY * BytesPerScanLine;
+      gBS->CopyMem (
+            VbeBuffer,
+            (UINT8 *) VbeFrameBuffer + SourceY * BytesPerScanLine,
+            TotalBytes * Height
+            );
+      CopyVideoBuffer (
+        PciIo,
+        VbeBuffer,
+        MemAddress,
+        0,
+        DestinationY,
+        TotalBytes * Height,
+        VbePixelWidth,
+        BytesPerScanLine
+        );
+      break;
+    }
+
     for (Index = 0; Index < Height; Index++) {
       if (DestinationY <= SourceY) {
         SrcY  = SourceY + Index;
@@ -1332,13 +1361,16 @@ FbGopVbeBltWorker (
       ) |
           ((Blt->Blue & Mode->Blue.Mask) << Mode->Blue.Position);
 
-    for (Index = 0; Index < Width; Index++) {
-      gBS->CopyMem (
-            VbeBuffer,
-            &Pixel,
-            VbePixelWidth
-            );
-      VbeBuffer += VbePixelWidth;
+    if (VbePixelWidth == sizeof (UINT32)) {
+      for (Index = 0; Index < Width; Index++) {
+        WriteUnaligned32 ((UINT32 *) VbeBuffer, Pixel);
+        VbeBuffer += sizeof (UINT32);
+      }
+    } else {
+      for (Index = 0; Index < Width; Index++) {
+        CopyMem (VbeBuffer, &Pixel, VbePixelWidth);
+        VbeBuffer += VbePixelWidth;
+      }
     }
 
     VbeBuffer = (UINT8 *) ((UINTN) VbeFrameBuffer + (DestinationY * BytesPerScanLine) + DestinationX * VbePixelWidth);
@@ -1350,6 +1382,20 @@ FbGopVbeBltWorker (
             );
     }
 
+    if (FullScanLines) {
+      CopyVideoBuffer (
+        PciIo,
+        VbeBuffer,
+        MemAddress,
+        0,
+        DestinationY,
+        TotalBytes * Height,
+        VbePixelWidth,
+        BytesPerScanLine
+        );
+      break;
+    }
+
     for (DstY = DestinationY; DstY < (Height + DestinationY); DstY++) {
       //
       // Update physical frame buffer.
@@ -1378,15 +1424,19 @@ FbGopVbeBltWorker (
         Pixel = ((Blt->Red & Mode->Red.Mask) << Mode->Red.Position) |
           ((Blt->Green & Mode->Green.Mask) << Mode->Green.Position) |
             ((Blt->Blue & Mode->Blue.Mask) << Mode->Blue.Position);
-        gBS->CopyMem (
-              VbeBuffer,
-              &Pixel,
-              VbePixelWidth
-              );
+        if (VbePixelWidth == sizeof (UINT32)) {
+          WriteUnaligned32 ((UINT32 *) VbeBuffer, Pixel);
+        } else {
+          CopyMem (VbeBuffer, &Pixel, VbePixelWidth);
+        }
         Blt++;
         VbeBuffer += VbePixelWidth;
       }
 
+      if (FullScanLines) {
+        continue;
+      }
+
       VbeBuffer = ((UINT8 *) VbeFrameBuffer + (DstY * BytesPerScanLine + DestinationX * VbePixelWidth));
 
       //
@@ -1403,6 +1453,19 @@ FbGopVbeBltWorker (
         BytesPerScanLine
         );
     }
+
+    if (FullScanLines) {
+      CopyVideoBuffer (
+        PciIo,
+        (UINT8 *) VbeFrameBuffer + DestinationY * BytesPerScanLine,
+        MemAddress,
+        0,
+        DestinationY,
+        TotalBytes * Height,
+        VbePixelWidth,
+        BytesPerScanLine
+        );
+    }
     break;
 
     default: ;
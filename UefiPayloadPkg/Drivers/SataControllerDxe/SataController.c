@@ -90,6 +90,207 @@ AhciWriteReg (
   return;
 }
 
+/**
+  Load the mode cache of the controller, or start an empty one if the variable
+  is missing or was written for a different controller layout.
+
+  @param SataPrivateData      The private data of the SATA controller.
+  @param ChannelDeviceCount   The number of (Channel, Device) pairs.
+
+  @retval EFI_SUCCESS             The mode cache is ready.
+  @retval EFI_OUT_OF_RESOURCES    Memory allocation failed.
+
+**/
+EFI_STATUS
+SataModeCacheLoad (
+  IN EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData,
+  IN UINTN                             ChannelDeviceCount
+  )
+{
+  EFI_STATUS           Status;
+  UINTN                Segment;
+  UINTN                Bus;
+  UINTN                Device;
+  UINTN                Function;
+  UINTN                Size;
+
+  SataPrivateData->PciIo->GetLocation (SataPrivateData->PciIo, &Segment, &Bus, &Device, &Function);
+  UnicodeSPrint (
+    SataPrivateData->ModeCacheName,
+    sizeof (SataPrivateData->ModeCacheName),
+    L"%s%04x%02x%02x%02x",
+    SATA_MODE_CACHE_VARIABLE_PREFIX,
+    (UINT32) Segment,
+    (UINT32) Bus,
+    (UINT32) Device,
+    (UINT32) Function
+    );
+
+  SataPrivateData->ModeCacheSize = sizeof (SATA_MODE_CACHE_HEADER) + ChannelDeviceCount * sizeof (SATA_MODE_CACHE_ENTRY);
+  SataPrivateData->ModeCache = AllocateZeroPool (SataPrivateData->ModeCacheSize);
+  if (SataPrivateData->ModeCache == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  SataPrivateData->ModeCacheHit = AllocateZeroPool ((sizeof (BOOLEAN)) * ChannelDeviceCount);
+  if (SataPrivateData->ModeCacheHit == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Size = SataPrivateData->ModeCacheSize;
+  Status = gRT->GetVariable (
+                  SataPrivateData->ModeCacheName,
+                  &gSataControllerModeCacheGuid,
+                  NULL,
+                  &Size,
+                  SataPrivateData->ModeCache
+                  );
+  if (EFI_ERROR (Status) ||
+      (Size != SataPrivateData->ModeCacheSize) ||
+      (SataPrivateData->ModeCache->Revision != SATA_MODE_CACHE_REVISION) ||
+      (SataPrivateData->ModeCache->EntryCount != ChannelDeviceCount)) {
+    ZeroMem (SataPrivateData->ModeCache, SataPrivateData->ModeCacheSize);
+    SataPrivateData->ModeCache->Revision   = SATA_MODE_CACHE_REVISION;
+    SataPrivateData->ModeCache->EntryCount = (UINT32) ChannelDeviceCount;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Write the mode cache of the controller back to its variable.
+
+  @param SataPrivateData      The private data of the SATA controller.
+
+**/
+VOID
+SataModeCacheSave (
+  IN EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData
+  )
+{
+  EFI_STATUS           Status;
+
+  Status = gRT->SetVariable (
+                  SataPrivateData->ModeCacheName,
+                  &gSataControllerModeCacheGuid,
+                  EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+                  SataPrivateData->ModeCacheSize,
+                  SataPrivateData->ModeCache
+                  );
+  DEBUG ((EFI_D_INFO, "SataModeCacheSave: %s %r\n", SataPrivateData->ModeCacheName, Status));
+}
+
+/**
+  Compute the key of a mode cache entry from the IDENTIFY data of a device.
+
+  @param IdentifyData       The IDENTIFY data of the device.
+
+  @return The CRC32 of the SATA_MODE_CACHE_KEY built from IdentifyData.
+
+**/
+UINT32
+SataModeCacheKey (
+  IN EFI_IDENTIFY_DATA                 *IdentifyData
+  )
+{
+  SATA_MODE_CACHE_KEY  Key;
+  UINT32               Crc;
+
+  ZeroMem (&Key, sizeof (Key));
+  CopyMem (Key.SerialNo, IdentifyData->AtaData.SerialNo, sizeof (Key.SerialNo));
+  CopyMem (Key.FirmwareVer, IdentifyData->AtaData.FirmwareVer, sizeof (Key.FirmwareVer));
+  CopyMem (Key.ModelName, IdentifyData->AtaData.ModelName, sizeof (Key.ModelName));
+  Key.PioCycleTiming           = ((ATA5_IDENTIFY_DATA *) (&(IdentifyData->AtaData)))->pio_cycle_timing;
+  Key.FieldValidity            = IdentifyData->AtaData.field_validity;
+  Key.MultiWordDmaSupported    = IdentifyData->AtaData.multi_word_dma_mode & 0xFF;
+  Key.AdvancedPioModes         = IdentifyData->AtaData.advanced_pio_modes;
+  Key.MinPioCycleTimeWithIordy = IdentifyData->AtaData.min_pio_cycle_time_with_flow_control;
+  Key.UltraDmaSupported        = IdentifyData->AtaData.ultra_dma_mode & 0xFF;
+
+  Crc = 0;
+  gBS->CalculateCrc32 (&Key, sizeof (Key), &Crc);
+  return Crc;
+}
+
+/**
+  Check the mode cache entry of a device against the IDENTIFY data submitted
+  for it, and drop the entry if another device, or no device, is attached now.
+
+  A dropped entry is only written back once new modes are calculated for the
+  slot, so a device change costs one variable write.
+
+  @param SataPrivateData    The private data of the SATA controller.
+  @param DeviceIndex        The flat index of the (Channel, Device) pair.
+  @param IdentifyData       The IDENTIFY data of the device, or NULL if absent.
+
+**/
+VOID
+SataModeCacheCheck (
+  IN EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData,
+  IN UINTN                             DeviceIndex,
+  IN EFI_IDENTIFY_DATA                 *IdentifyData OPTIONAL
+  )
+{
+  SATA_MODE_CACHE_ENTRY  *Entry;
+
+  Entry = &((SATA_MODE_CACHE_ENTRY *) (SataPrivateData->ModeCache + 1))[DeviceIndex];
+  SataPrivateData->ModeCacheHit[DeviceIndex] = FALSE;
+  if (!Entry->Valid) {
+    return;
+  }
+
+  if ((IdentifyData != NULL) && (Entry->IdentifyCrc == SataModeCacheKey (IdentifyData))) {
+    SataPrivateData->ModeCacheHit[DeviceIndex] = TRUE;
+    SataPrivateData->ModeCacheValidated++;
+  } else {
+    ZeroMem (Entry, sizeof (SATA_MODE_CACHE_ENTRY));
+    SataPrivateData->ModeCacheInvalidated++;
+  }
+
+  DEBUG ((
+    EFI_D_INFO,
+    "SataModeCacheCheck: device %d %a, validated %d, invalidated %d\n",
+    (UINT32) DeviceIndex,
+    SataPrivateData->ModeCacheHit[DeviceIndex] ? "unchanged" : "changed",
+    SataPrivateData->ModeCacheValidated,
+    SataPrivateData->ModeCacheInvalidated
+    ));
+}
+
+/**
+  Record the modes calculated for a device in the mode cache.
+
+  @param SataPrivateData    The private data of the SATA controller.
+  @param DeviceIndex        The flat index of the (Channel, Device) pair.
+  @param IdentifyData       The IDENTIFY data of the device.
+  @param Modes              The modes calculated for the device.
+
+**/
+VOID
+SataModeCacheUpdate (
+  IN EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData,
+  IN UINTN                             DeviceIndex,
+  IN EFI_IDENTIFY_DATA                 *IdentifyData,
+  IN EFI_ATA_COLLECTIVE_MODE           *Modes
+  )
+{
+  SATA_MODE_CACHE_ENTRY  *Entry;
+  SATA_MODE_CACHE_ENTRY  NewEntry;
+
+  ZeroMem (&NewEntry, sizeof (NewEntry));
+  NewEntry.Valid    = TRUE;
+  NewEntry.PioMode  = Modes->PioMode.Valid ? (UINT8) Modes->PioMode.Mode : SATA_MODE_CACHE_NO_MODE;
+  NewEntry.UdmaMode = Modes->UdmaMode.Valid ? (UINT8) Modes->UdmaMode.Mode : SATA_MODE_CACHE_NO_MODE;
+  NewEntry.IdentifyCrc = SataModeCacheKey (IdentifyData);
+
+  Entry = &((SATA_MODE_CACHE_ENTRY *) (SataPrivateData->ModeCache + 1))[DeviceIndex];
+  if (CompareMem (Entry, &NewEntry, sizeof (SATA_MODE_CACHE_ENTRY)) != 0) {
+    CopyMem (Entry, &NewEntry, sizeof (SATA_MODE_CACHE_ENTRY));
+    SataModeCacheSave (SataPrivateData);
+  }
+  SataPrivateData->ModeCacheHit[DeviceIndex] = TRUE;
+}
+
 /**
   This function is used to calculate the best PIO mode supported by specific IDE device
 
@@ -393,6 +594,7 @@ SataControllerStart (
   PCI_TYPE00                        PciData;
   EFI_SATA_CONTROLLER_PRIVATE_DATA  *SataPrivateData;
   UINT32                            Data32;
+  UINT32                            PortsImplemented;
   UINTN                             ChannelDeviceCount;
 
   DEBUG ((EFI_D_INFO, "SataControllerStart START\n"));
@@ -461,6 +663,14 @@ SataControllerStart (
     if ((Data32 & B_AHCI_CAP_SPM) == B_AHCI_CAP_SPM) {
       SataPrivateData->DeviceCount = AHCI_MULTI_MAX_DEVICES;
     }
+
+    //
+    // Ports Implemented(PI) may be sparse, so the channels must reach its highest port
+    //
+    PortsImplemented = AhciReadReg (PciIo, R_AHCI_PI);
+    if (PortsImplemented != 0) {
+      SataPrivateData->IdeInit.ChannelCount = (UINT8) (HighBitSet32 (PortsImplemented) + 1);
+    }
   }
 
   ChannelDeviceCount = (UINTN) (SataPrivateData->IdeInit.ChannelCount) * (UINTN) (SataPrivateData->DeviceCount);
@@ -482,6 +692,11 @@ SataControllerStart (
     goto Done;
   }
 
+  Status = SataModeCacheLoad (SataPrivateData, ChannelDeviceCount);
+  if (EFI_ERROR (Status)) {
+    goto Done;
+  }
+
   //
   // Install IDE Controller Init Protocol to this instance
   //
@@ -511,6 +726,12 @@ Done:
       if (SataPrivateData->IdentifyValid != NULL) {
         FreePool (SataPrivateData->IdentifyValid);
       }
+      if (SataPrivateData->ModeCache != NULL) {
+        FreePool (SataPrivateData->ModeCache);
+      }
+      if (SataPrivateData->ModeCacheHit != NULL) {
+        FreePool (SataPrivateData->ModeCacheHit);
+      }
       FreePool (SataPrivateData);
     }
   }
@@ -586,6 +807,12 @@ SataControllerStop (
     if (SataPrivateData->IdentifyValid != NULL) {
       FreePool (SataPrivateData->IdentifyValid);
     }
+    if (SataPrivateData->ModeCache != NULL) {
+      FreePool (SataPrivateData->ModeCache);
+    }
+    if (SataPrivateData->ModeCacheHit != NULL) {
+      FreePool (SataPrivateData->ModeCacheHit);
+    }
     FreePool (SataPrivateData);
   }
 
@@ -803,6 +1030,8 @@ IdeInitSubmitData (
     SataPrivateData->IdentifyValid[DeviceIndex] = FALSE;
   }
 
+  SataModeCacheCheck (SataPrivateData, DeviceIndex, IdentifyData);
+
   return EFI_SUCCESS;
 }
 
@@ -950,6 +1179,8 @@ IdeInitCalculateMode (
   UINT16                            SelectedMode;
   EFI_STATUS                        Status;
   UINTN                             DeviceIndex;
+  BOOLEAN                           Disqualified;
+  SATA_MODE_CACHE_ENTRY             *Entry;
 
   SataPrivateData = SATA_CONTROLLER_PRIVATE_DATA_FROM_THIS (This);
   ASSERT (SataPrivateData != NULL);
@@ -978,6 +1209,24 @@ IdeInitCalculateMode (
     return EFI_NOT_READY;
   }
 
+  //
+  // Reuse the modes of an unchanged device, unless modes were disqualified since
+  //
+  Disqualified = (BOOLEAN) (DisqualifiedModes->PioMode.Valid || DisqualifiedModes->UdmaMode.Valid);
+  if (SataPrivateData->ModeCacheHit[DeviceIndex] && !Disqualified) {
+    Entry = &((SATA_MODE_CACHE_ENTRY *) (SataPrivateData->ModeCache + 1))[DeviceIndex];
+    if (Entry->PioMode != SATA_MODE_CACHE_NO_MODE) {
+      (*SupportedModes)->PioMode.Valid = TRUE;
+      (*SupportedModes)->PioMode.Mode  = Entry->PioMode;
+    }
+    if (Entry->UdmaMode != SATA_MODE_CACHE_NO_MODE) {
+      (*SupportedModes)->UdmaMode.Valid = TRUE;
+      (*SupportedModes)->UdmaMode.Mode  = Entry->UdmaMode;
+    }
+    DEBUG ((EFI_D_INFO, "IdeInitCalculateMode: cached PioMode = %x, UdmaMode = %x\n", Entry->PioMode, Entry->UdmaMode));
+    return EFI_SUCCESS;
+  }
+
   Status = CalculateBestPioMode (
             IdentifyData,
             (DisqualifiedModes->PioMode.Valid ? ((UINT16 *) &(DisqualifiedModes->PioMode.Mode)) : NULL),
@@ -1007,6 +1256,10 @@ IdeInitCalculateMode (
   }
   DEBUG ((EFI_D_INFO, "IdeInitCalculateMode: UdmaMode = %x\n", (*SupportedModes)->UdmaMode.Mode));
 
+  if (!Disqualified) {
+    SataModeCacheUpdate (SataPrivateData, DeviceIndex, IdentifyData, *SupportedModes);
+  }
+
   //
   // The modes other than PIO and UDMA are not supported
   //
@@ -27,6 +27,8 @@
 #include <Library/BaseMemoryLib.h>
 #include <Library/MemoryAllocationLib.h>
 #include <Library/UefiBootServicesTableLib.h>
+#include <Library/UefiRuntimeServicesTableLib.h>
+#include <Library/PrintLib.h>
 #include <IndustryStandard/Pci.h>
 
 //
@@ -40,6 +42,7 @@ extern EFI_COMPONENT_NAME2_PROTOCOL gSataControllerComponentName2;
 #define R_AHCI_CAP 0x0
 #define   B_AHCI_CAP_NPS (BIT4 | BIT3 | BIT2 | BIT1 | BIT0) // Number of Ports
 #define   B_AHCI_CAP_SPM BIT17 // Supports Port Multiplier
+#define R_AHCI_PI 0xC
 
 ///
 /// AHCI each channel can have up to 1 device
@@ -63,6 +66,49 @@ extern EFI_COMPONENT_NAME2_PROTOCOL gSataControllerComponentName2;
 
 #define SATA_ENUMER_ALL FALSE
 
+///
+/// Transfer modes of the attached devices are cached across boots in a variable
+/// per controller, named after its PCI location, under gSataControllerModeCacheGuid
+///
+#define SATA_MODE_CACHE_VARIABLE_PREFIX L"SataModeCache"
+#define SATA_MODE_CACHE_REVISION 2
+#define SATA_MODE_CACHE_NO_MODE 0xFF
+
+typedef struct {
+  UINT32    Revision;
+  UINT32    EntryCount;
+} SATA_MODE_CACHE_HEADER;
+
+///
+/// Cached modes of the device at one (Channel, Device) pair, keyed by the
+/// CRC32 of its SATA_MODE_CACHE_KEY
+///
+typedef struct {
+  BOOLEAN   Valid;
+  UINT8     PioMode;      ///< SATA_MODE_CACHE_NO_MODE if no PIO mode is supported
+  UINT8     UdmaMode;     ///< SATA_MODE_CACHE_NO_MODE if no UDMA mode is supported
+  UINT8     Reserved;
+  UINT32    IdentifyCrc;
+} SATA_MODE_CACHE_ENTRY;
+
+///
+/// The IDENTIFY data a cache entry is keyed on: the device and its firmware,
+/// and the words the PIO and UDMA mode calculation reads. Words 63 and 88 keep
+/// only their supported mode bits, since the selected mode bits follow the
+/// mode set on the previous boot.
+///
+typedef struct {
+  CHAR8     SerialNo[20];
+  CHAR8     FirmwareVer[8];
+  CHAR8     ModelName[40];
+  UINT16    PioCycleTiming;               ///< word 51
+  UINT16    FieldValidity;                ///< word 53
+  UINT16    MultiWordDmaSupported;        ///< word 63, bits 7:0
+  UINT16    AdvancedPioModes;             ///< word 64
+  UINT16    MinPioCycleTimeWithIordy;     ///< word 68
+  UINT16    UltraDmaSupported;            ///< word 88, bits 7:0
+} SATA_MODE_CACHE_KEY;
+
 //
 // Sata Controller driver private data structure
 //
@@ -102,6 +148,17 @@ typedef struct _EFI_SATA_CONTROLLER_PRIVATE_DATA {
   //
   EFI_IDENTIFY_DATA                 *IdentifyData;
   BOOLEAN                           *IdentifyValid;
+
+  //
+  // Mode cache of the controller, a header followed by an entry for each
+  // attached device, and whether each entry matched the device this boot
+  //
+  CHAR16                            ModeCacheName[32];
+  SATA_MODE_CACHE_HEADER            *ModeCache;
+  UINTN                             ModeCacheSize;
+  BOOLEAN                           *ModeCacheHit;
+  UINT32                            ModeCacheValidated;
+  UINT32                            ModeCacheInvalidated;
 } EFI_SATA_CONTROLLER_PRIVATE_DATA;
 
 #define SATA_CONTROLLER_PRIVATE_DATA_FROM_THIS(a) CR(a, EFI_SATA_CONTROLLER_PRIVATE_DATA, IdeInit, SATA_CONTROLLER_SIGNATURE)
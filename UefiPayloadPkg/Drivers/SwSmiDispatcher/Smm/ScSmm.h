@@ -240,6 +240,11 @@ extern CONTEXT_FUNCTIONS          ContextFunctions[ScSmmProtocolTypeMax];
 
 #define MAXIMUM_SWI_VALUE 0xFF
 
+//
+// Passes of the dispatch loop before ScSmmCoreDispatcher gives up on EOS
+//
+#define SC_SMM_ESCAPE_COUNT 100
+
 /**
   Clear the SMI status bit by set the source bit of SMI status register
 
@@ -265,6 +270,12 @@ typedef struct _DATABASE_RECORD {
   LIST_ENTRY            Link;
   BOOLEAN               Processed;
 
+  //
+  // Unregistered while ScSmmCoreDispatcher() was walking the database. The
+  // record is not dispatched and is freed when the walk ends.
+  //
+  BOOLEAN               MarkedForDeletion;
+
   //
   // Status and Enable bit description
   //
@@ -433,6 +444,7 @@ typedef struct {
 //
 typedef struct {
   LIST_ENTRY                  CallbackDataBase;
+  BOOLEAN                     DispatchInProgress;
   EFI_HANDLE                  SmiHandle;
   EFI_HANDLE                  InstallMultProtHandle;
   SC_SMM_QUALIFIED_PROTOCOL   Protocols[ScSmmProtocolTypeMax];
@@ -16,6 +16,8 @@
 **/
 
 #include "ScSmmHelpers.h"
+#include "SmiProfile.h"
+#include <Library/PcdLib.h>
 #include <Protocol/SmmBase2.h>
 #include <Protocol/SmmControl2.h>
 
@@ -61,6 +63,7 @@ PRIVATE_DATA          mPrivateData = {  // for the structure
   {
     NULL
   },                                    // CallbackDataBase linked list head
+  FALSE,                                // DispatchInProgress
   NULL,                                 // Handler returned when calling SmiHandlerRegister
   NULL,                                 // EFI handle returned when calling InstallMultipleProtocolInterfaces
   {                                     // protocol arrays
@@ -143,6 +146,14 @@ InitializeSwSmmDispatcher (
   Status = gSmst->SmiHandlerRegister (ScSmmCoreDispatcher, NULL, &mPrivateData.SmiHandle);
   ASSERT_EFI_ERROR (Status);
 
+  //
+  // Export the SMI latency profile kept by ScSmmCoreDispatcher
+  //
+  if (FeaturePcdGet (PcdSmiProfileEnable)) {
+    Status = SmiProfileInitialize ();
+    ASSERT_EFI_ERROR (Status);
+  }
+
   //
   // Initialize Callback DataBase
   //
@@ -185,7 +196,7 @@ SmiInputValueDuplicateCheck (
   while (!IsNull (&mPrivateData.CallbackDataBase, LinkInDb)) {
     RecordInDb = DATABASE_RECORD_FROM_LINK (LinkInDb);
 
-    if (RecordInDb->ProtocolType == SwType) {
+    if ((RecordInDb->ProtocolType == SwType) && !RecordInDb->MarkedForDeletion) {
       if (RecordInDb->ChildContext.Sw.SwSmiInputValue == FedSwSmiInputValue) {
         return EFI_INVALID_PARAMETER;
       }
@@ -253,6 +264,7 @@ ScSmmCoreRegister (
   Qualified                 = QUALIFIED_PROTOCOL_FROM_GENERIC (This);
   Record->ProtocolType      = Qualified->Type;
   Record->ContextFunctions  = mContextFunctions[Qualified->Type];
+  Record->MarkedForDeletion = FALSE;
 
   //
   // Perform linked list housekeeping
@@ -358,22 +370,14 @@ ScSmmCoreUnRegister (
     return EFI_INVALID_PARAMETER;
   }
 
-  RecordToDelete = DATABASE_RECORD_FROM_LINK (DispatchHandle);
-
-  //
-  // See if this is a valid entry
-  //
-  if (RecordToDelete->Link.ForwardLink == (LIST_ENTRY *) EFI_BAD_POINTER) {
-    return EFI_INVALID_PARAMETER;
-  }
-
   //
-  // See if this entry exists in the database
+  // See if this entry exists in the database before touching the record,
+  // the handle of a record already freed must not be dereferenced
   //  
   Found = FALSE;
   LinkInDb = GetFirstNode (&mPrivateData.CallbackDataBase);
   while (!IsNull (&mPrivateData.CallbackDataBase, LinkInDb) && !Found) {
-    if (&RecordToDelete->Link == LinkInDb) {
+    if ((LIST_ENTRY *) DispatchHandle == LinkInDb) {
       Found = TRUE;
     }
     LinkInDb = GetNextNode (&mPrivateData.CallbackDataBase, LinkInDb);
@@ -382,14 +386,54 @@ ScSmmCoreUnRegister (
     return EFI_INVALID_PARAMETER;
   }
 
+  RecordToDelete = DATABASE_RECORD_FROM_LINK (DispatchHandle);
+  if (RecordToDelete->MarkedForDeletion) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (mPrivateData.DispatchInProgress) {
+    //
+    // ScSmmCoreDispatcher() may hold links to this record, so leave it in the
+    // database until the walk ends
+    //
+    RecordToDelete->MarkedForDeletion = TRUE;
+    return EFI_SUCCESS;
+  }
+
   //
   // Remove the entry
   //
   RemoveEntryList (&RecordToDelete->Link);
+  RecordToDelete->Signature = 0;
+  gSmst->SmmFreePool (RecordToDelete);
 
   return EFI_SUCCESS;
 }
 
+/**
+  Remove and free the records unregistered during the last dispatch.
+
+**/
+VOID
+ScSmmCoreRemoveMarkedRecords (
+  VOID
+  )
+{
+  DATABASE_RECORD     *RecordInDb;
+  LIST_ENTRY          *LinkInDb;
+
+  LinkInDb = GetFirstNode (&mPrivateData.CallbackDataBase);
+  while (!IsNull (&mPrivateData.CallbackDataBase, LinkInDb)) {
+    RecordInDb = DATABASE_RECORD_FROM_LINK (LinkInDb);
+    LinkInDb   = GetNextNode (&mPrivateData.CallbackDataBase, LinkInDb);
+    if (RecordInDb->MarkedForDeletion) {
+      RemoveEntryList (&RecordInDb->Link);
+      RecordInDb->Signature = 0;
+      gSmst->SmmFreePool (RecordInDb);
+    }
+  }
+}
+
 
 /**
 
@@ -427,14 +471,23 @@ ScSmmCoreDispatcher (
   UINTN               CommBufferSize;
   EFI_STATUS          Status;
   SC_SMM_SOURCE_DESC  ActiveSource = NULL_SOURCE_DESC_INITIALIZER;
+  UINT64              EntryTsc;
+  UINT64              HandlerTsc;
+  UINTN               SwSmiValue;
 
-  EscapeCount           = 100;
+  EntryTsc              = FeaturePcdGet (PcdSmiProfileEnable) ? AsmReadTsc () : 0;
+  EscapeCount           = SC_SMM_ESCAPE_COUNT;
   ContextsMatch         = FALSE;
   EosSet                = FALSE;
 //  SxChildWasDispatched  = FALSE;
   Status                = EFI_SUCCESS;
 
   if (!IsListEmpty (&mPrivateData.CallbackDataBase)) {
+    //
+    // Children unregistered from here on stay linked until the walk ends
+    //
+    mPrivateData.DispatchInProgress = TRUE;
+
     //
     // We have children registered w/ us -- continue
     //
@@ -474,13 +527,14 @@ ScSmmCoreDispatcher (
           while (!IsNull (&mPrivateData.CallbackDataBase, LinkToExhaust)) {
             RecordToExhaust = DATABASE_RECORD_FROM_LINK (LinkToExhaust);
             //
-            // RecordToExhaust->Link might be removed (unregistered) by Callback function, and then the
-            // system will hang in ASSERT() while calling GetNextNode().
-            // To prevent the issue, we need to get next record in DB here (before Callback function).
+            // A Callback function that unregisters a child only marks its record, and the record
+            // stays linked until the walk ends, so the next link stays valid across the callback.
+            // Records marked during this walk are skipped below.
             //
             LinkToExhaust = GetNextNode (&mPrivateData.CallbackDataBase, &RecordToExhaust->Link);
 
-            if (CompareSources (&RecordToExhaust->SrcDesc, &ActiveSource)) {
+            if (!RecordToExhaust->MarkedForDeletion &&
+                CompareSources (&RecordToExhaust->SrcDesc, &ActiveSource)) {
               //
               // These source descriptions are equal, so this callback should be
               // dispatched.
@@ -526,9 +580,17 @@ ScSmmCoreDispatcher (
                     CommBufferSize = 0;
                   }
 
-                  PERF_START_EX (NULL, "SmmFunction", NULL, AsmReadTsc(), RecordToExhaust->ProtocolType);
-                  RecordToExhaust->Callback ((EFI_HANDLE) & RecordToExhaust->Link, &Context, CommBuffer, &CommBufferSize);
-                  PERF_END_EX (NULL, "SmmFunction", NULL, AsmReadTsc(), RecordToExhaust->ProtocolType);
+                  if (FeaturePcdGet (PcdSmiProfileEnable)) {
+                    //
+                    // The callback may unregister itself, so take what the profile needs first
+                    //
+                    SwSmiValue = RecordToExhaust->ChildContext.Sw.SwSmiInputValue;
+                    HandlerTsc = AsmReadTsc ();
+                    RecordToExhaust->Callback ((EFI_HANDLE) & RecordToExhaust->Link, &Context, CommBuffer, &CommBufferSize);
+                    SmiProfileRecordHandler (SwSmiValue, HandlerTsc, AsmReadTsc ());
+                  } else {
+                    RecordToExhaust->Callback ((EFI_HANDLE) & RecordToExhaust->Link, &Context, CommBuffer, &CommBufferSize);
+                  }
                 } else {
                   ASSERT (FALSE);
                 }
@@ -558,9 +620,15 @@ ScSmmCoreDispatcher (
         }
       }
     }
+
+    mPrivateData.DispatchInProgress = FALSE;
+    ScSmmCoreRemoveMarkedRecords ();
   }
   BeforeExitSmi ();
 
+  if (FeaturePcdGet (PcdSmiProfileEnable)) {
+    SmiProfileRecordSmi (EntryTsc, AsmReadTsc (), SC_SMM_ESCAPE_COUNT - EscapeCount);
+  }
   return Status;
 }
 
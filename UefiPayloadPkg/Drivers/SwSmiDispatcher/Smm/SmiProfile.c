@@ -0,0 +1,316 @@
+/** @file
+  SMI latency profile of the software SMI dispatcher.
+
+  Every pass of ScSmmCoreDispatcher() and every child handler call is recorded
+  in a fixed ring in SMRAM, with TSC timestamps. Recording a sample is a few
+  stores, so the profile is always on. The ring is read through the SMM
+  communication buffer with gUefiSmiProfileGuid.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "ScSmmHelpers.h"
+#include "SmiProfile.h"
+#include <Library/SmmMemLib.h>
+
+STATIC SMI_PROFILE_RECORD     mSmiProfileRing[SMI_PROFILE_RING_SIZE];
+STATIC UINT64                 mSmiProfileTotalRecords;
+STATIC UINT64                 mSmiProfileTotalSmis;
+STATIC UINT64                 mSmiProfileTotalSmiTicks;
+STATIC UINT64                 mSmiProfileMaxSmiTicks;
+STATIC BOOLEAN                mSmiProfileAtRuntime = FALSE;
+
+/**
+  Take the next record of the ring.
+
+  @return The record to fill.
+
+**/
+STATIC
+SMI_PROFILE_RECORD *
+SmiProfileNextRecord (
+  VOID
+  )
+{
+  SMI_PROFILE_RECORD  *Record;
+
+  Record = &mSmiProfileRing[(UINTN) mSmiProfileTotalRecords & (SMI_PROFILE_RING_SIZE - 1)];
+  mSmiProfileTotalRecords++;
+  return Record;
+}
+
+/**
+  Return the ticks between two TSC readings, saturated to 32 bits.
+
+  @param[in] EntryTsc             The earlier reading
+  @param[in] ExitTsc              The later reading
+
+  @return Ticks between the readings.
+
+**/
+STATIC
+UINT32
+SmiProfileTicks (
+  IN UINT64                       EntryTsc,
+  IN UINT64                       ExitTsc
+  )
+{
+  UINT64  Ticks;
+
+  Ticks = ExitTsc - EntryTsc;
+  return (Ticks > MAX_UINT32) ? MAX_UINT32 : (UINT32) Ticks;
+}
+
+/**
+  Record one call of a child handler.
+
+  @param[in] SwSmiValue           Software SMI value the handler is registered for
+  @param[in] EntryTsc             TSC before the call
+  @param[in] ExitTsc              TSC after the call
+
+**/
+VOID
+SmiProfileRecordHandler (
+  IN UINTN                        SwSmiValue,
+  IN UINT64                       EntryTsc,
+  IN UINT64                       ExitTsc
+  )
+{
+  SMI_PROFILE_RECORD  *Record;
+
+  Record             = SmiProfileNextRecord ();
+  Record->EntryTsc   = EntryTsc;
+  Record->Ticks      = SmiProfileTicks (EntryTsc, ExitTsc);
+  Record->SwSmiValue = (UINT16) SwSmiValue;
+  Record->Type       = SMI_PROFILE_RECORD_HANDLER;
+  Record->Loops      = 0;
+}
+
+/**
+  Record one pass of the dispatcher.
+
+  @param[in] EntryTsc             TSC on entry to the dispatcher
+  @param[in] ExitTsc              TSC on exit from the dispatcher
+  @param[in] Loops                Iterations of the dispatch loop
+
+**/
+VOID
+SmiProfileRecordSmi (
+  IN UINT64                       EntryTsc,
+  IN UINT64                       ExitTsc,
+  IN UINTN                        Loops
+  )
+{
+  SMI_PROFILE_RECORD  *Record;
+
+  Record             = SmiProfileNextRecord ();
+  Record->EntryTsc   = EntryTsc;
+  Record->Ticks      = SmiProfileTicks (EntryTsc, ExitTsc);
+  Record->SwSmiValue = SMI_PROFILE_NO_SW_SMI_VALUE;
+  Record->Type       = SMI_PROFILE_RECORD_SMI;
+  Record->Loops      = (UINT8) MIN (Loops, MAX_UINT8);
+
+  mSmiProfileTotalSmis++;
+  mSmiProfileTotalSmiTicks += ExitTsc - EntryTsc;
+  if (ExitTsc - EntryTsc > mSmiProfileMaxSmiTicks) {
+    mSmiProfileMaxSmiTicks = ExitTsc - EntryTsc;
+  }
+}
+
+/**
+  Copy profile records to the communication buffer.
+
+  @param[in, out] GetRecords      The request, in SMRAM
+  @param[in]      Capacity        Number of records the caller buffer can take
+  @param[out]     Records         The caller buffer
+
+**/
+STATIC
+VOID
+SmiProfileGetRecords (
+  IN OUT SMI_PROFILE_COMMUNICATE_GET_RECORDS  *GetRecords,
+  IN     UINTN                                Capacity,
+  OUT    SMI_PROFILE_RECORD                   *Records
+  )
+{
+  UINT64              Oldest;
+  UINT64              Cursor;
+  UINT32              Count;
+
+  Oldest = 0;
+  if (mSmiProfileTotalRecords > SMI_PROFILE_RING_SIZE) {
+    Oldest = mSmiProfileTotalRecords - SMI_PROFILE_RING_SIZE;
+  }
+
+  Cursor           = GetRecords->Cursor;
+  GetRecords->Lost = 0;
+  if (Cursor > mSmiProfileTotalRecords) {
+    Cursor = mSmiProfileTotalRecords;
+  }
+  if (Cursor < Oldest) {
+    GetRecords->Lost = (UINT32) MIN (Oldest - Cursor, MAX_UINT32);
+    Cursor           = Oldest;
+  }
+
+  for (Count = 0; (Count < Capacity) && (Cursor < mSmiProfileTotalRecords); Count++, Cursor++) {
+    CopyMem (
+      &Records[Count],
+      &mSmiProfileRing[(UINTN) Cursor & (SMI_PROFILE_RING_SIZE - 1)],
+      sizeof (SMI_PROFILE_RECORD)
+      );
+  }
+
+  GetRecords->Cursor = Cursor;
+  GetRecords->Count  = Count;
+}
+
+/**
+  Communication service SMI Handler entry.
+
+  This SMI handler exports the SMI latency profile.
+
+  Caution: This function may receive untrusted input.
+  The communicate buffer is external input, so this function will do basic validation.
+
+  @param[in]      DispatchHandle                      The unique handle assigned to this handler by SmiHandlerRegister().
+  @param[in]      RegisterContext                     Points to an optional handler context which was specified when the
+                                                      handler was registered.
+  @param[in, out] CommBuffer                          A pointer to a collection of data in memory that will
+                                                      be conveyed from a non-SMM environment into an SMM environment.
+  @param[in, out] CommBufferSize                      The size of the CommBuffer.
+
+  @retval         EFI_SUCCESS                         The interrupt was handled and quiesced. No other handlers
+                                                      should still be called.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+SmiProfileHandler (
+  IN     EFI_HANDLE                                DispatchHandle,
+  IN     CONST VOID                                *RegisterContext,
+  IN OUT VOID                                      *CommBuffer,
+  IN OUT UINTN                                     *CommBufferSize
+  )
+{
+  SMI_PROFILE_COMMUNICATE_HEADER                   *ProfileHeader;
+  SMI_PROFILE_COMMUNICATE_GET_INFO                 *GetInfo;
+  SMI_PROFILE_COMMUNICATE_GET_RECORDS              *GetRecords;
+  SMI_PROFILE_COMMUNICATE_GET_RECORDS              GetRecordsRequest;
+  UINTN                                            TempCommBufferSize;
+  UINTN                                            CommBufferPayloadSize;
+  UINTN                                            Capacity;
+  EFI_STATUS                                       Status;
+
+  //
+  // If input is invalid, stop processing this SMI
+  //
+  if (CommBuffer == NULL || CommBufferSize == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  TempCommBufferSize = *CommBufferSize;
+  if (TempCommBufferSize < SMI_PROFILE_COMMUNICATE_HEADER_SIZE) {
+    DEBUG ((EFI_D_ERROR, "SmiProfileHandler: SMM communication buffer size invalid!\n"));
+    return EFI_SUCCESS;
+  }
+  CommBufferPayloadSize = TempCommBufferSize - SMI_PROFILE_COMMUNICATE_HEADER_SIZE;
+
+  if (!SmmIsBufferOutsideSmmValid ((UINTN)CommBuffer, TempCommBufferSize)) {
+    DEBUG ((EFI_D_ERROR, "SmiProfileHandler: SMM communication buffer in SMRAM or overflow!\n"));
+    return EFI_SUCCESS;
+  }
+
+  ProfileHeader = (SMI_PROFILE_COMMUNICATE_HEADER *) CommBuffer;
+  switch (ProfileHeader->Function) {
+    case SMI_PROFILE_FUNCTION_GET_INFO:
+      if (CommBufferPayloadSize < sizeof (SMI_PROFILE_COMMUNICATE_GET_INFO)) {
+        Status = EFI_BUFFER_TOO_SMALL;
+        break;
+      }
+      GetInfo                = (SMI_PROFILE_COMMUNICATE_GET_INFO *) ProfileHeader->Data;
+      GetInfo->RingSize      = SMI_PROFILE_RING_SIZE;
+      GetInfo->Reserved      = 0;
+      GetInfo->TotalRecords  = mSmiProfileTotalRecords;
+      GetInfo->TotalSmis     = mSmiProfileTotalSmis;
+      GetInfo->TotalSmiTicks = mSmiProfileTotalSmiTicks;
+      GetInfo->MaxSmiTicks   = mSmiProfileMaxSmiTicks;
+      Status                 = EFI_SUCCESS;
+      break;
+
+    case SMI_PROFILE_FUNCTION_GET_RECORDS:
+      if (CommBufferPayloadSize < OFFSET_OF (SMI_PROFILE_COMMUNICATE_GET_RECORDS, Records)) {
+        Status = EFI_BUFFER_TOO_SMALL;
+        break;
+      }
+      //
+      // Copy the request to SMRAM so the caller cannot change it while it is used
+      //
+      GetRecords = (SMI_PROFILE_COMMUNICATE_GET_RECORDS *) ProfileHeader->Data;
+      CopyMem (&GetRecordsRequest, GetRecords, OFFSET_OF (SMI_PROFILE_COMMUNICATE_GET_RECORDS, Records));
+      Capacity = (CommBufferPayloadSize - OFFSET_OF (SMI_PROFILE_COMMUNICATE_GET_RECORDS, Records)) / sizeof (SMI_PROFILE_RECORD);
+      Capacity = MIN (Capacity, GetRecordsRequest.Count);
+      SmiProfileGetRecords (&GetRecordsRequest, Capacity, GetRecords->Records);
+      CopyMem (GetRecords, &GetRecordsRequest, OFFSET_OF (SMI_PROFILE_COMMUNICATE_GET_RECORDS, Records));
+      Status = EFI_SUCCESS;
+      break;
+
+    case SMI_PROFILE_FUNCTION_RESET:
+      if (mSmiProfileAtRuntime) {
+        Status = EFI_ACCESS_DENIED;
+        break;
+      }
+      mSmiProfileTotalRecords  = 0;
+      mSmiProfileTotalSmis     = 0;
+      mSmiProfileTotalSmiTicks = 0;
+      mSmiProfileMaxSmiTicks   = 0;
+      Status                   = EFI_SUCCESS;
+      break;
+
+    default:
+      Status = EFI_UNSUPPORTED;
+      break;
+  }
+
+  ProfileHeader->ReturnStatus = Status;
+  return EFI_SUCCESS;
+}
+
+/**
+  Register the SMM communication handler that exports the profile.
+
+  @retval    EFI_SUCCESS          The handler is registered.
+  @retval    Others               The handler could not be registered.
+
+**/
+EFI_STATUS
+SmiProfileInitialize (
+  VOID
+  )
+{
+  EFI_HANDLE  ProfileHandle;
+
+  ProfileHandle = NULL;
+  return gSmst->SmiHandlerRegister (SmiProfileHandler, &gUefiSmiProfileGuid, &ProfileHandle);
+}
+
+/**
+  Stop accepting SMI_PROFILE_FUNCTION_RESET, so the OS cannot clear the profile.
+
+**/
+VOID
+SmiProfileExitBootServices (
+  VOID
+  )
+{
+  mSmiProfileAtRuntime = TRUE;
+}
@@ -0,0 +1,79 @@
+/** @file
+  SMI latency profile of the software SMI dispatcher.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef SMI_PROFILE_H
+#define SMI_PROFILE_H
+
+#include <Guid/SmiProfileGuid.h>
+
+//
+// Number of records kept in SMRAM. Must be a power of 2.
+//
+#define SMI_PROFILE_RING_SIZE    1024
+
+/**
+  Record one call of a child handler. The handler is identified by its software
+  SMI value, which is unique in the dispatcher database, so no SMRAM address is
+  exported.
+
+  @param[in] SwSmiValue           Software SMI value the handler is registered for
+  @param[in] EntryTsc             TSC before the call
+  @param[in] ExitTsc              TSC after the call
+
+**/
+VOID
+SmiProfileRecordHandler (
+  IN UINTN                        SwSmiValue,
+  IN UINT64                       EntryTsc,
+  IN UINT64                       ExitTsc
+  );
+
+/**
+  Record one pass of the dispatcher.
+
+  @param[in] EntryTsc             TSC on entry to the dispatcher
+  @param[in] ExitTsc              TSC on exit from the dispatcher
+  @param[in] Loops                Iterations of the dispatch loop
+
+**/
+VOID
+SmiProfileRecordSmi (
+  IN UINT64                       EntryTsc,
+  IN UINT64                       ExitTsc,
+  IN UINTN                        Loops
+  );
+
+/**
+  Register the SMM communication handler that exports the profile.
+
+  @retval    EFI_SUCCESS          The handler is registered.
+  @retval    Others               The handler could not be registered.
+
+**/
+EFI_STATUS
+SmiProfileInitialize (
+  VOID
+  );
+
+/**
+  Stop accepting SMI_PROFILE_FUNCTION_RESET, so the OS cannot clear the profile.
+
+**/
+VOID
+SmiProfileExitBootServices (
+  VOID
+  );
+
+#endif
@@ -52,14 +52,17 @@
 #include <Library/MemoryAllocationLib.h>
 #include <Library/AuthVariableLib.h>
 #include <Library/VarCheckLib.h>
+#include <Library/TimerLib.h>
+#include <Library/FlashVariableStoreLib.h>
 #include <Guid/GlobalVariable.h>
 #include <Guid/EventGroup.h>
 #include <Guid/VariableFormat.h>
 #include <Guid/SystemNvDataGuid.h>
 #include <Guid/VarErrorFlag.h>
+#include <Guid/SmmVariableStatistics.h>
 #include "PlatformLib.h"
+#include "SmiProfile.h"
 
-VARIABLE_INFO_ENTRY                                  *gVariableInfo = NULL;
 EFI_HANDLE                                           mSmmVariableHandle      = NULL;
 EFI_HANDLE                                           mVariableHandle         = NULL;
 UINT8                                                *mVariableBufferPayload = NULL;
@@ -68,6 +71,39 @@ BOOLEAN                                              mEndOfDxe  =  FALSE;
 // extern VAR_CHECK_REQUEST_SOURCE                      mRequestSource;
 STATIC BOOLEAN                                       mVariableSmmAtRuntime = FALSE;
 
+//
+// Variable statistics, collected when PcdVariableCollectStatistics is TRUE.
+// Records live in an array so that their index can serve as enumeration cursor.
+//
+#define VARIABLE_STATISTICS_MAX_ENTRIES                  256
+#define VARIABLE_STATISTICS_HASH_BUCKETS                 64
+#define VARIABLE_STATISTICS_INVALID_INDEX                MAX_UINT32
+
+typedef enum {
+  VariableStatisticsRead,
+  VariableStatisticsWrite,
+  VariableStatisticsDelete
+} VARIABLE_STATISTICS_ACCESS;
+
+typedef struct {
+  EFI_GUID                                           VendorGuid;
+  CHAR16                                             *Name;
+  UINTN                                              NameSize;
+  UINT32                                             Hash;
+  UINT32                                             HashNext;
+  BOOLEAN                                            Volatile;
+  UINT32                                             ReadCount;
+  UINT32                                             WriteCount;
+  UINT32                                             DeleteCount;
+  UINT64                                             SmmTicks;
+} VARIABLE_STATISTICS_RECORD;
+
+STATIC VARIABLE_STATISTICS_RECORD                    mVariableStatistics[VARIABLE_STATISTICS_MAX_ENTRIES];
+STATIC UINT32                                        mVariableStatisticsBuckets[VARIABLE_STATISTICS_HASH_BUCKETS];
+STATIC UINT32                                        mVariableStatisticsCount = 0;
+STATIC UINT64                                        mPerformanceCounterStart;
+STATIC UINT64                                        mPerformanceCounterEnd;
+
 /**
   SecureBoot Hook for SetVariable.
 
@@ -142,7 +178,147 @@ EDKII_SMM_VAR_CHECK_PROTOCOL mSmmVarCheck = { VarCheckLibRegisterSetVariableChec
                                               VarCheckLibVariablePropertyGet };
 
 /**
-  Get the variable statistics information from the information buffer pointed by gVariableInfo.
+  Find the statistics record of a variable, creating it on first use.
+
+  Records are never removed, so the index of a record is stable for the whole boot.
+
+  @param[in] VariableName    Null-terminated variable name.
+  @param[in] VendorGuid      Variable vendor GUID.
+
+  @return The statistics record, or NULL if the table is full.
+
+**/
+STATIC
+VARIABLE_STATISTICS_RECORD *
+GetStatisticsRecord (
+  IN CONST CHAR16                                      *VariableName,
+  IN CONST EFI_GUID                                    *VendorGuid
+  )
+{
+  VARIABLE_STATISTICS_RECORD                           *Record;
+  UINTN                                                NameSize;
+  UINT32                                               Hash;
+  UINT32                                               Index;
+
+  NameSize = StrSize (VariableName);
+  Hash     = FlashVariableStoreComputeHash (VariableName, NameSize, VendorGuid);
+  for (Index = mVariableStatisticsBuckets[Hash % VARIABLE_STATISTICS_HASH_BUCKETS];
+       Index != VARIABLE_STATISTICS_INVALID_INDEX;
+       Index = mVariableStatistics[Index].HashNext) {
+    Record = &mVariableStatistics[Index];
+    if ((Record->Hash == Hash) &&
+        (Record->NameSize == NameSize) &&
+        CompareGuid (&Record->VendorGuid, VendorGuid) &&
+        (CompareMem (Record->Name, VariableName, NameSize) == 0)) {
+      return Record;
+    }
+  }
+
+  if (mVariableStatisticsCount == VARIABLE_STATISTICS_MAX_ENTRIES) {
+    return NULL;
+  }
+  Record = &mVariableStatistics[mVariableStatisticsCount];
+  Record->Name = AllocateCopyPool (NameSize, VariableName);
+  if (Record->Name == NULL) {
+    return NULL;
+  }
+  CopyGuid (&Record->VendorGuid, VendorGuid);
+  Record->NameSize = NameSize;
+  Record->Hash     = Hash;
+  Record->HashNext = mVariableStatisticsBuckets[Hash % VARIABLE_STATISTICS_HASH_BUCKETS];
+  mVariableStatisticsBuckets[Hash % VARIABLE_STATISTICS_HASH_BUCKETS] = mVariableStatisticsCount;
+  mVariableStatisticsCount++;
+
+  return Record;
+}
+
+/**
+  Return the performance counter value to start timing a variable service with.
+
+  @return The current performance counter, or 0 if statistics are not collected.
+
+**/
+STATIC
+UINT64
+GetStatisticsTimestamp (
+  VOID
+  )
+{
+  if (!FeaturePcdGet (PcdVariableCollectStatistics)) {
+    return 0;
+  }
+  return GetPerformanceCounter ();
+}
+
+/**
+  Account one variable service call to the statistics of the variable.
+
+  @param[in] VariableName    Null-terminated variable name.
+  @param[in] VendorGuid      Variable vendor GUID.
+  @param[in] Attributes      Attributes of the variable, or 0 if not known.
+  @param[in] Access          Kind of access.
+  @param[in] StartTicks      Performance counter value taken before the service was called.
+
+**/
+STATIC
+VOID
+UpdateVariableStatistics (
+  IN CONST CHAR16                                      *VariableName,
+  IN CONST EFI_GUID                                    *VendorGuid,
+  IN UINT32                                            Attributes,
+  IN VARIABLE_STATISTICS_ACCESS                        Access,
+  IN UINT64                                            StartTicks
+  )
+{
+  VARIABLE_STATISTICS_RECORD                           *Record;
+  UINT64                                               EndTicks;
+
+  if (!FeaturePcdGet (PcdVariableCollectStatistics)) {
+    return;
+  }
+
+  EndTicks = GetPerformanceCounter ();
+  Record   = GetStatisticsRecord (VariableName, VendorGuid);
+  if (Record == NULL) {
+    return;
+  }
+
+  switch (Access) {
+    case VariableStatisticsRead:
+      Record->ReadCount++;
+      break;
+    case VariableStatisticsWrite:
+      Record->WriteCount++;
+      break;
+    case VariableStatisticsDelete:
+      Record->DeleteCount++;
+      break;
+  }
+  if (Attributes != 0) {
+    Record->Volatile = (BOOLEAN) ((Attributes & EFI_VARIABLE_NON_VOLATILE) == 0);
+  }
+
+  //
+  // Handle a counter that counts down or wraps while the service ran
+  //
+  if (mPerformanceCounterEnd > mPerformanceCounterStart) {
+    if (EndTicks < StartTicks) {
+      EndTicks += mPerformanceCounterEnd - mPerformanceCounterStart;
+    }
+    Record->SmmTicks += EndTicks - StartTicks;
+  } else {
+    if (StartTicks < EndTicks) {
+      StartTicks += mPerformanceCounterStart - mPerformanceCounterEnd;
+    }
+    Record->SmmTicks += StartTicks - EndTicks;
+  }
+}
+
+/**
+  Get the variable statistics information from the statistics table.
+
+  The cursor is the index of the returned entry plus one. It travels in the Next field
+  of the returned entry, so each call costs O(1) no matter how many variables exist.
 
   Caution: This function may be invoked at SMM runtime.
   InfoEntry and InfoSize are external input. Care must be taken to make sure not security issue at runtime.
@@ -167,80 +343,121 @@ SmmVariableGetStatistics (
   IN OUT UINTN                                         *InfoSize
   )
 {
-  VARIABLE_INFO_ENTRY                                  *VariableInfo;
-  UINTN                                                NameLength;
+  VARIABLE_STATISTICS_RECORD                           *Record;
+  UINTN                                                Cursor;
   UINTN                                                StatisticsInfoSize;
-  CHAR16                                               *InfoName;
   EFI_GUID                                             VendorGuid;
 
   if (InfoEntry == NULL) {
     return EFI_INVALID_PARAMETER;
   }
 
-  VariableInfo = gVariableInfo;
-  if (VariableInfo == NULL) {
+  if (mVariableStatisticsCount == 0) {
     return EFI_UNSUPPORTED;
   }
 
-  StatisticsInfoSize = sizeof (VARIABLE_INFO_ENTRY) + StrSize (VariableInfo->Name);
-  if (*InfoSize < StatisticsInfoSize) {
+  StatisticsInfoSize = sizeof (VARIABLE_INFO_ENTRY) + mVariableStatistics[0].NameSize;
+  if (*InfoSize < sizeof (VARIABLE_INFO_ENTRY)) {
     *InfoSize = StatisticsInfoSize;
     return EFI_BUFFER_TOO_SMALL;
   }
-  InfoName = (CHAR16 *)(InfoEntry + 1);
 
   CopyGuid (&VendorGuid, &InfoEntry->VendorGuid);
+  Cursor = (UINTN) InfoEntry->Next;
 
   if (CompareGuid (&VendorGuid, &gZeroGuid)) {
     //
     // Return the first variable info
     //
-    CopyMem (InfoEntry, VariableInfo, sizeof (VARIABLE_INFO_ENTRY));
-    CopyMem (InfoName, VariableInfo->Name, StrSize (VariableInfo->Name));
-    *InfoSize = StatisticsInfoSize;
-    return EFI_SUCCESS;
-  }
-
-  //
-  // Get the next variable info
-  //
-  while (VariableInfo != NULL) {
-    if (CompareGuid (&VariableInfo->VendorGuid, &VendorGuid)) {
-      NameLength = StrSize (VariableInfo->Name);
-      if (NameLength == StrSize (InfoName)) {
-        if (CompareMem (VariableInfo->Name, InfoName, NameLength) == 0) {
-          //
-          // Find the match one
-          //
-          VariableInfo = VariableInfo->Next;
-          break;
-        }
-      }
+    Cursor = 0;
+  } else {
+    if ((Cursor == 0) || (Cursor > mVariableStatisticsCount) ||
+        !CompareGuid (&mVariableStatistics[Cursor - 1].VendorGuid, &VendorGuid)) {
+      return EFI_INVALID_PARAMETER;
+    }
+    if (Cursor == mVariableStatisticsCount) {
+      *InfoSize = 0;
+      return EFI_SUCCESS;
     }
-    VariableInfo = VariableInfo->Next;
-  };
-
-  if (VariableInfo == NULL) {
-    *InfoSize = 0;
-    return EFI_SUCCESS;
   }
 
   //
   // Output the new variable info
   //
-  StatisticsInfoSize = sizeof (VARIABLE_INFO_ENTRY) + StrSize (VariableInfo->Name);
+  Record             = &mVariableStatistics[Cursor];
+  StatisticsInfoSize = sizeof (VARIABLE_INFO_ENTRY) + Record->NameSize;
   if (*InfoSize < StatisticsInfoSize) {
     *InfoSize = StatisticsInfoSize;
     return EFI_BUFFER_TOO_SMALL;
   }
 
-  CopyMem (InfoEntry, VariableInfo, sizeof (VARIABLE_INFO_ENTRY));
-  CopyMem (InfoName, VariableInfo->Name, StrSize (VariableInfo->Name));
+  InfoEntry->Next        = (VARIABLE_INFO_ENTRY *) (Cursor + 1);
+  InfoEntry->Name        = NULL;
+  InfoEntry->Volatile    = Record->Volatile;
+  InfoEntry->ReadCount   = Record->ReadCount;
+  InfoEntry->WriteCount  = Record->WriteCount;
+  InfoEntry->DeleteCount = Record->DeleteCount;
+  InfoEntry->CacheCount  = 0;
+  CopyGuid (&InfoEntry->VendorGuid, &Record->VendorGuid);
+  CopyMem (InfoEntry + 1, Record->Name, Record->NameSize);
   *InfoSize = StatisticsInfoSize;
 
   return EFI_SUCCESS;
 }
 
+/**
+  Get the statistics of one variable, including the time spent in SMM for it.
+
+  Caution: This function may be invoked at SMM runtime.
+  StatisticsEx is external input. Care must be taken to make sure not security issue at runtime.
+
+  @param[in, out]  StatisticsEx          On input, Cursor selects the entry to return.
+                                         On output, the entry, with Cursor advanced to the next one.
+  @param[in]       NameBufferSize        Size of the buffer following StatisticsEx->Name.
+
+  @retval          EFI_SUCCESS           The variable statistics are returned.
+  @retval          EFI_UNSUPPORTED       PcdVariableCollectStatistics is FALSE.
+  @retval          EFI_NOT_FOUND         Cursor is past the last entry.
+  @retval          EFI_BUFFER_TOO_SMALL  The name does not fit; NameSize holds the needed size.
+
+**/
+EFI_STATUS
+SmmVariableGetStatisticsEx (
+  IN OUT SMM_VARIABLE_COMMUNICATE_GET_STATISTICS_EX    *StatisticsEx,
+  IN     UINTN                                         NameBufferSize
+  )
+{
+  VARIABLE_STATISTICS_RECORD                           *Record;
+  UINT32                                               Cursor;
+
+  if (!FeaturePcdGet (PcdVariableCollectStatistics)) {
+    return EFI_UNSUPPORTED;
+  }
+
+  Cursor = StatisticsEx->Cursor;
+  if (Cursor >= mVariableStatisticsCount) {
+    return EFI_NOT_FOUND;
+  }
+
+  Record = &mVariableStatistics[Cursor];
+  if (NameBufferSize < Record->NameSize) {
+    StatisticsEx->NameSize = Record->NameSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  StatisticsEx->Cursor      = Cursor + 1;
+  StatisticsEx->Volatile    = Record->Volatile;
+  StatisticsEx->ReadCount   = Record->ReadCount;
+  StatisticsEx->WriteCount  = Record->WriteCount;
+  StatisticsEx->DeleteCount = Record->DeleteCount;
+  StatisticsEx->SmmTime     = GetTimeInNanoSecond (Record->SmmTicks);
+  StatisticsEx->NameSize    = Record->NameSize;
+  CopyGuid (&StatisticsEx->VendorGuid, &Record->VendorGuid);
+  CopyMem (StatisticsEx->Name, Record->Name, Record->NameSize);
+
+  return EFI_SUCCESS;
+}
+
 
 /**
   Communication service SMI Handler entry.
@@ -287,10 +504,13 @@ SmmVariableHandler (
   VARIABLE_INFO_ENTRY                                   *VariableInfo;
   SMM_VARIABLE_COMMUNICATE_LOCK_VARIABLE                *VariableToLock;
   SMM_VARIABLE_COMMUNICATE_VAR_CHECK_VARIABLE_PROPERTY  *CommVariableProperty;
+  SMM_VARIABLE_COMMUNICATE_GET_STATISTICS_EX            *StatisticsEx;
   UINTN                                                 InfoSize;
   UINTN                                                 NameBufferSize;
   UINTN                                                 CommBufferPayloadSize;
   UINTN                                                 TempCommBufferSize;
+  UINT64                                                StartTicks;
+  VARIABLE_STATISTICS_ACCESS                            Access;
 
   //
   // If input is invalid, stop processing this SMI
@@ -356,6 +576,7 @@ SmmVariableHandler (
         goto EXIT;
       }
 
+      StartTicks = GetStatisticsTimestamp ();
       Status = VariableServiceGetVariable (
                  SmmVariableHeader->Name,
                  &SmmVariableHeader->Guid,
@@ -363,6 +584,13 @@ SmmVariableHandler (
                  &SmmVariableHeader->DataSize,
                  (UINT8 *)SmmVariableHeader->Name + SmmVariableHeader->NameSize
                  );
+      UpdateVariableStatistics (
+        SmmVariableHeader->Name,
+        &SmmVariableHeader->Guid,
+        EFI_ERROR (Status) ? 0 : SmmVariableHeader->Attributes,
+        VariableStatisticsRead,
+        StartTicks
+        );
       CopyMem (SmmVariableFunctionHeader->Data, mVariableBufferPayload, CommBufferPayloadSize);
       break;
 
@@ -450,6 +678,7 @@ SmmVariableHandler (
         goto EXIT;
       }
 
+      StartTicks = GetStatisticsTimestamp ();
       Status = VariableServiceSetVariable (
                  SmmVariableHeader->Name,
                  &SmmVariableHeader->Guid,
@@ -457,6 +686,18 @@ SmmVariableHandler (
                  SmmVariableHeader->DataSize,
                  (UINT8 *) SmmVariableHeader->Name + SmmVariableHeader->NameSize
                  );
+      Access = VariableStatisticsWrite;
+      if (((SmmVariableHeader->Attributes & ~EFI_VARIABLE_APPEND_WRITE) == 0) ||
+          ((SmmVariableHeader->DataSize == 0) && ((SmmVariableHeader->Attributes & EFI_VARIABLE_APPEND_WRITE) == 0))) {
+        Access = VariableStatisticsDelete;
+      }
+      UpdateVariableStatistics (
+        SmmVariableHeader->Name,
+        &SmmVariableHeader->Guid,
+        SmmVariableHeader->Attributes,
+        Access,
+        StartTicks
+        );
       break;
 
     case SMM_VARIABLE_FUNCTION_QUERY_VARIABLE_INFO:
@@ -503,6 +744,7 @@ SmmVariableHandler (
 
     case SMM_VARIABLE_FUNCTION_EXIT_BOOT_SERVICE:
       mVariableSmmAtRuntime = TRUE;
+      SmiProfileExitBootServices ();
       PlatformLibEndOfBootHookSmm();
       Status = EFI_SUCCESS;
       break;
@@ -525,6 +767,18 @@ SmmVariableHandler (
       *CommBufferSize = InfoSize + SMM_VARIABLE_COMMUNICATE_HEADER_SIZE;
       break;
 
+    case SMM_VARIABLE_FUNCTION_GET_STATISTICS_EX:
+      if (CommBufferPayloadSize < OFFSET_OF (SMM_VARIABLE_COMMUNICATE_GET_STATISTICS_EX, Name)) {
+        DEBUG ((EFI_D_ERROR, "GetStatisticsEx: SMM communication buffer size invalid!\n"));
+        return EFI_SUCCESS;
+      }
+      StatisticsEx = (SMM_VARIABLE_COMMUNICATE_GET_STATISTICS_EX *) SmmVariableFunctionHeader->Data;
+      Status = SmmVariableGetStatisticsEx (
+                 StatisticsEx,
+                 CommBufferPayloadSize - OFFSET_OF (SMM_VARIABLE_COMMUNICATE_GET_STATISTICS_EX, Name)
+                 );
+      break;
+
     case SMM_VARIABLE_FUNCTION_LOCK_VARIABLE:
       if (mEndOfDxe) {
         Status = EFI_ACCESS_DENIED;
@@ -691,6 +945,9 @@ VariableServiceInitialize (
                     );
   ASSERT_EFI_ERROR (Status);
 
+  SetMem (mVariableStatisticsBuckets, sizeof (mVariableStatisticsBuckets), 0xFF);
+  GetPerformanceCounterProperties (&mPerformanceCounterStart, &mPerformanceCounterEnd);
+
   mVariableBufferPayloadSize = GetNonVolatileMaxVariableSize () +
                                OFFSET_OF (SMM_VARIABLE_COMMUNICATE_VAR_CHECK_VARIABLE_PROPERTY, Name) - GetVariableHeaderSize ();
 
@@ -14,6 +14,10 @@
 #include "UefiPayloadDxe.h"
 #include <Protocol/Tcg2Protocol.h>
 
+//
+// Completion bitmap of the end of boot MP hook, indexed by processor number
+//
+volatile UINT32   mEndOfBootMpDone[END_OF_BOOT_MP_MAX_CPUS / 32];
 
 /**
   Reserve MMIO/IO resource in GCD
@@ -187,9 +191,10 @@ OnReadyToBoot (
 /**
   MP function to be passed to MP Services Protocol
 
-  This function wraps PlatformLib's hook function for ExitBootServices event
+  This function wraps PlatformLib's hook function for ExitBootServices event,
+  and marks the calling CPU thread done in mEndOfBootMpDone.
 
-  @param  Buffer        MP function parameter. Not used.
+  @param  Buffer        MP function parameter. Points to the MP Services Protocol.
 
 **/
 VOID
@@ -198,7 +203,65 @@ ExitBootServicesMpFunc (
   IN VOID *Buffer
   )
 {
+  EFI_MP_SERVICES_PROTOCOL *MpService;
+  UINTN                    ProcessorNumber;
+  UINT32                   Done;
+
   PlatformLibEndOfBootHookMp ();
+
+  MpService = (EFI_MP_SERVICES_PROTOCOL *) Buffer;
+  if (EFI_ERROR (MpService->WhoAmI (MpService, &ProcessorNumber)) ||
+      (ProcessorNumber >= END_OF_BOOT_MP_MAX_CPUS)) {
+    return;
+  }
+
+  do {
+    Done = mEndOfBootMpDone[ProcessorNumber / 32];
+  } while (InterlockedCompareExchange32 (
+             (UINT32 *) &mEndOfBootMpDone[ProcessorNumber / 32],
+             Done,
+             Done | (1u << (ProcessorNumber % 32))
+             ) != Done);
+}
+
+/**
+  Report the CPU threads that did not finish the end of boot MP hook.
+
+  @param  MpService     The MP Services Protocol.
+
+  @return Number of CPU threads that finished the hook.
+
+**/
+UINTN
+CheckEndOfBootMpDone (
+  IN EFI_MP_SERVICES_PROTOCOL  *MpService
+  )
+{
+  EFI_PROCESSOR_INFORMATION    ProcessorInfo;
+  UINTN                        NumberOfProcessors;
+  UINTN                        NumberOfEnabledProcessors;
+  UINTN                        ProcessorNumber;
+  UINTN                        DoneCount;
+  EFI_STATUS                   Status;
+
+  Status = MpService->GetNumberOfProcessors (MpService, &NumberOfProcessors, &NumberOfEnabledProcessors);
+  if (EFI_ERROR (Status)) {
+    return 0;
+  }
+
+  DoneCount = 0;
+  for (ProcessorNumber = 0; ProcessorNumber < MIN (NumberOfProcessors, END_OF_BOOT_MP_MAX_CPUS); ProcessorNumber++) {
+    if ((mEndOfBootMpDone[ProcessorNumber / 32] & (1u << (ProcessorNumber % 32))) != 0) {
+      DoneCount++;
+      continue;
+    }
+    Status = MpService->GetProcessorInfo (MpService, ProcessorNumber, &ProcessorInfo);
+    if (!EFI_ERROR (Status) && ((ProcessorInfo.StatusFlag & PROCESSOR_ENABLED_BIT) != 0)) {
+      DEBUG ((EFI_D_ERROR, "EndOfBootHookMp: CPU %d (APIC ID 0x%lx) did not finish\n", (UINT32) ProcessorNumber, ProcessorInfo.ProcessorId));
+    }
+  }
+
+  return DoneCount;
 }
 
 
@@ -221,6 +284,11 @@ OnExitBootServices (
 {
   EFI_MP_SERVICES_PROTOCOL *MpService;
   EFI_STATUS               Status;
+  BOOLEAN                  SingleThread;
+  UINT64                   StartTicks;
+  UINT64                   EndTicks;
+  UINT64                   CounterStart;
+  UINT64                   CounterEnd;
 
   //
   // Calls Platform hook
@@ -237,17 +305,61 @@ OnExitBootServices (
                   );
 
   if (!EFI_ERROR (Status)) {
-    ExitBootServicesMpFunc (NULL);
-    Status = MpService->StartupAllAPs (
-                          MpService,
-                          ExitBootServicesMpFunc,
-                          TRUE,
-                          NULL,
-                          0,
-                          NULL,
-                          NULL
-                          );
-//    ASSERT_EFI_ERROR (Status);
+    ZeroMem ((VOID *) mEndOfBootMpDone, sizeof (mEndOfBootMpDone));
+    StartTicks = GetPerformanceCounter ();
+    ExitBootServicesMpFunc (MpService);
+
+    //
+    // Run the hook on all APs at once unless it needs serializing. The hook
+    // is not idempotent, so the APs are waited for without a timeout: one that
+    // timed out would be reset in the middle of it. Memory cannot be allocated
+    // here, so the APs that did not finish are found with the completion
+    // bitmap rather than a failed CPU list.
+    //
+    SingleThread = FeaturePcdGet (PcdEndOfBootHookMpSerialize);
+    Status       = EFI_SUCCESS;
+    if (!SingleThread) {
+      Status = MpService->StartupAllAPs (
+                            MpService,
+                            ExitBootServicesMpFunc,
+                            FALSE,
+                            NULL,
+                            0,
+                            MpService,
+                            NULL
+                            );
+      if (EFI_ERROR (Status) && (Status != EFI_NOT_STARTED)) {
+        SingleThread = TRUE;
+      }
+    }
+    if (SingleThread) {
+      Status = MpService->StartupAllAPs (
+                            MpService,
+                            ExitBootServicesMpFunc,
+                            TRUE,
+                            NULL,
+                            0,
+                            MpService,
+                            NULL
+                            );
+    }
+
+    EndTicks = GetPerformanceCounter ();
+    if (EndTicks < StartTicks) {
+      //
+      // The counter counts up and wrapped around
+      //
+      GetPerformanceCounterProperties (&CounterStart, &CounterEnd);
+      EndTicks += CounterEnd - CounterStart + 1;
+    }
+    DEBUG ((
+      EFI_D_INFO,
+      "EndOfBootHookMp: %a, %d CPUs done in %ld us - %r\n",
+      SingleThread ? "serial" : "parallel",
+      (UINT32) CheckEndOfBootMpDone (MpService),
+      DivU64x32 (GetTimeInNanoSecond (EndTicks - StartTicks), 1000),
+      Status
+      ));
   }
 
   return;
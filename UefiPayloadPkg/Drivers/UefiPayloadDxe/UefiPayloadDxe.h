@@ -25,6 +25,9 @@
 #include <Library/IoLib.h>
 #include <Library/HobLib.h>
 #include <Library/PlatformLib.h>
+#include <Library/TimerLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/PcdLib.h>
 
 #include <Guid/Acpi.h>
 #include <Guid/SmBios.h>
@@ -37,4 +40,9 @@
 
 #include <IndustryStandard/Acpi.h>
 
+//
+// CPU threads tracked by the end of boot MP hook
+//
+#define END_OF_BOOT_MP_MAX_CPUS       1024
+
 #endif
@@ -16,6 +16,17 @@
 #define LEGACY_8259_MASK_REGISTER_MASTER  0x21
 #define LEGACY_8259_MASK_REGISTER_SLAVE   0xA1
 
+//
+// The HPET that UefiPayloadDxe reserves, used when there is no ACPI PM timer
+//
+#define HPET_BASE_ADDRESS                 0xFED00000
+#define HPET_COUNTER_PERIOD_OFFSET        0x04
+#define HPET_GENERAL_CONFIGURATION_OFFSET 0x10
+#define HPET_MAIN_COUNTER_OFFSET          0xF0
+#define HPET_MAX_COUNTER_PERIOD           100000000   // 100ns in femtoseconds
+
+#define TSC_CALIBRATION_TIME_US           1000
+
 extern VOID *mPayLoadHOBBase;
 
 EFI_MEMORY_TYPE_INFORMATION mDefaultMemoryTypeInformation[] = {
@@ -65,6 +76,85 @@ BuildMemoryMappedIoRangeHob (
     );
 }
 
+/**
+  Measure the frequency of the invariant TSC.
+
+  The TSC is counted over about TSC_CALIBRATION_TIME_US of the ACPI PM timer,
+  or of the HPET main counter if there is no PM timer.
+
+  @param  PmTimerRegBase  I/O port of the ACPI PM timer, or 0 if there is none
+
+  @return The TSC frequency in Hz, or 0 if the TSC is not invariant or there is
+          no reference timer.
+
+**/
+STATIC
+UINT64
+CalibrateTscFrequency (
+  IN UINTN                      PmTimerRegBase
+  )
+{
+  UINT32                        RegEax;
+  UINT32                        RegEdx;
+  UINT64                        ReferenceFrequency;
+  UINT32                        ReferenceTicks;
+  UINT32                        ReferenceMask;
+  UINT32                        HpetPeriod;
+  UINT32                        HpetConfig;
+  UINT32                        Start;
+  UINT32                        Elapsed;
+  UINT64                        TscStart;
+  UINT64                        TscElapsed;
+
+  //
+  // Only an invariant TSC keeps its rate across P-state and C-state changes
+  //
+  AsmCpuid (0x80000000, &RegEax, NULL, NULL, NULL);
+  if (RegEax < 0x80000007) {
+    return 0;
+  }
+  AsmCpuid (0x80000007, NULL, NULL, NULL, &RegEdx);
+  if ((RegEdx & BIT8) == 0) {
+    DEBUG ((EFI_D_INFO, "TSC is not invariant, keep the ACPI timer\n"));
+    return 0;
+  }
+
+  HpetConfig = 0;
+  if (PmTimerRegBase != 0) {
+    ReferenceFrequency = ACPI_TIMER_FREQUENCY;
+    ReferenceMask      = BIT24 - 1;
+  } else {
+    HpetPeriod = MmioRead32 (HPET_BASE_ADDRESS + HPET_COUNTER_PERIOD_OFFSET);
+    if ((HpetPeriod == 0) || (HpetPeriod > HPET_MAX_COUNTER_PERIOD)) {
+      DEBUG ((EFI_D_INFO, "No timer to calibrate the TSC against\n"));
+      return 0;
+    }
+    ReferenceFrequency = DivU64x32 (1000000000000000ull, HpetPeriod);
+    ReferenceMask      = MAX_UINT32;
+    HpetConfig = MmioRead32 (HPET_BASE_ADDRESS + HPET_GENERAL_CONFIGURATION_OFFSET);
+    MmioWrite32 (HPET_BASE_ADDRESS + HPET_GENERAL_CONFIGURATION_OFFSET, HpetConfig | BIT0);
+  }
+  ReferenceTicks = (UINT32) DivU64x32 (MultU64x32 (ReferenceFrequency, TSC_CALIBRATION_TIME_US), 1000000);
+
+  if (PmTimerRegBase != 0) {
+    Start    = IoRead32 (PmTimerRegBase);
+    TscStart = AsmReadTsc ();
+    do {
+      Elapsed = (IoRead32 (PmTimerRegBase) - Start) & ReferenceMask;
+    } while (Elapsed < ReferenceTicks);
+  } else {
+    Start    = MmioRead32 (HPET_BASE_ADDRESS + HPET_MAIN_COUNTER_OFFSET);
+    TscStart = AsmReadTsc ();
+    do {
+      Elapsed = (MmioRead32 (HPET_BASE_ADDRESS + HPET_MAIN_COUNTER_OFFSET) - Start) & ReferenceMask;
+    } while (Elapsed < ReferenceTicks);
+    MmioWrite32 (HPET_BASE_ADDRESS + HPET_GENERAL_CONFIGURATION_OFFSET, HpetConfig);
+  }
+  TscElapsed = AsmReadTsc () - TscStart;
+
+  return DivU64x64Remainder (MultU64x64 (TscElapsed, ReferenceFrequency), Elapsed, NULL);
+}
+
 /**
   Check the integrity of firmware volume header
 
@@ -376,7 +466,13 @@ PayloadPeiEntryPoint (
   SYSTEM_TABLE_INFO*   pSystemTableInfo;
   FRAME_BUFFER_INFO    FbInfo;
   FRAME_BUFFER_INFO*   pFbInfo;
+  FLASH_VARIABLE_INFO  FlashVarInfo;
+  FLASH_VARIABLE_INFO  *pFlashVarInfo;
+  PCI_RESOURCE_INFO    *pPciResInfo;
+  UINTN                PciResInfoSize;
   ACPI_BOARD_INFO*     pAcpiBoardInfo;
+  TSC_FREQUENCY_INFO*  pTscFrequencyInfo;
+  UINT64               TscFrequency;
   UINTN                PmCtrlRegBase, PmTimerRegBase, ResetRegAddress, ResetValue;
   UINTN                PmEvtBase;
   UINTN                PmGpeEnBase;
@@ -615,6 +711,18 @@ PayloadPeiEntryPoint (
   pAcpiBoardInfo->TpmChecksum = (UINT64) ((UINTN)TpmChecksum);
   DEBUG ((EFI_D_INFO, "Created acpi board info guid hob\n"));
 
+  //
+  // Create guid hob for the TSC frequency, so TimerLib calibrates only once
+  //
+  TscFrequency = CalibrateTscFrequency (PmTimerRegBase);
+  if (TscFrequency != 0) {
+    pTscFrequencyInfo = BuildGuidHob (&gUefiTscFrequencyInfoGuid, sizeof (TSC_FREQUENCY_INFO));
+    ASSERT (pTscFrequencyInfo != NULL);
+    ZeroMem (pTscFrequencyInfo, sizeof (TSC_FREQUENCY_INFO));
+    pTscFrequencyInfo->Frequency = TscFrequency;
+    DEBUG ((EFI_D_INFO, "Created TSC frequency info guid hob, %ld Hz\n", TscFrequency));
+  }
+
   //
   // Create guid hob for frame buffer information
   //
@@ -631,6 +739,33 @@ PayloadPeiEntryPoint (
     DEBUG ((EFI_D_INFO, "Created frame buffer info guid hob\n"));
   }
 
+  //
+  // Create guid hob for the flash variable region
+  //
+  if (CorebootFound) {
+    Status = ParseFlashVariableInfoByCb (&FlashVarInfo);
+  } else {
+    Status = ParseFlashVariableInfoByHob (&FlashVarInfo);
+  }
+  if (!EFI_ERROR (Status)) {
+    pFlashVarInfo = BuildGuidHob (&gUefiFlashVariableInfoGuid, sizeof (FLASH_VARIABLE_INFO));
+    ASSERT (pFlashVarInfo != NULL);
+    CopyMem (pFlashVarInfo, &FlashVarInfo, sizeof (FLASH_VARIABLE_INFO));
+    DEBUG ((EFI_D_INFO, "Created flash variable info guid hob, region 0x%x size 0x%x\n", FlashVarInfo.FlashOffset, FlashVarInfo.Size));
+  }
+
+  //
+  // Create guid hob for the PCI resources assigned by the bootloader. The
+  // coreboot tables do not carry them, so with coreboot the BARs are sized.
+  //
+  if (!CorebootFound) {
+    Status = ParsePciResourceInfoByHob (&pPciResInfo, &PciResInfoSize);
+    if (!EFI_ERROR (Status)) {
+      BuildGuidDataHob (&gUefiPciResourceInfoGuid, pPciResInfo, PciResInfoSize);
+      DEBUG ((EFI_D_INFO, "Created PCI resource info guid hob, %d resources\n", pPciResInfo->Count));
+    }
+  }
+
   if (!CorebootFound) {
     //
     // Update FSPs base
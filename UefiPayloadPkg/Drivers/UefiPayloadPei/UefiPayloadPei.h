@@ -35,6 +35,9 @@
 #include <Guid/FrameBufferInfoGuid.h>
 #include <Guid/SystemTableInfoGuid.h>
 #include <Guid/AcpiBoardInfoGuid.h>
+#include <Guid/TscFrequencyInfoGuid.h>
+
+#include <IndustryStandard/Acpi.h>
 
 #include <Ppi/MasterBootMode.h>
 #include <Ppi/VtdInfo.h>
@@ -80,7 +80,7 @@ struct imd_root {
   UINT32 max_entries;
   UINT32 num_entries;
   UINT32 flags;
-  UINT32 entry_align;
+  UINT32 entry_align;
   UINT32 max_offset;
   struct imd_entry entries[0];
 };
@@ -165,21 +165,21 @@ struct cb_serial {
   UINT32 type;
   UINT32 baseaddr;
   UINT32 baud;
-  UINT32 regwidth;
-
-  // Crystal or input frequency to the chip containing the UART.
-  // Provide the board specific details to allow the payload to
-  // initialize the chip containing the UART and make independent
-  // decisions as to which dividers to select and their values
-  // to eventually arrive at the desired console baud-rate.
-  UINT32 input_hertz;
-
-  // UART PCI address: bus, device, function
-  // 1 << 31 - Valid bit, PCI UART in use
-  // Bus << 20
-  // Device << 15
-  // Function << 12
-  UINT32 uart_pci_addr;
+  UINT32 regwidth;
+
+  // Crystal or input frequency to the chip containing the UART.
+  // Provide the board specific details to allow the payload to
+  // initialize the chip containing the UART and make independent
+  // decisions as to which dividers to select and their values
+  // to eventually arrive at the desired console baud-rate.
+  UINT32 input_hertz;
+
+  // UART PCI address: bus, device, function
+  // 1 << 31 - Valid bit, PCI UART in use
+  // Bus << 20
+  // Device << 15
+  // Function << 12
+  UINT32 uart_pci_addr;
 };
 
 #define CB_TAG_CONSOLE       0x00010
@@ -242,6 +242,42 @@ struct cb_cbmem_tab {
   UINT64 cbmem_tab;
 };
 
+#define CB_TAG_BOOT_MEDIA_PARAMS  0x0030
+struct cb_boot_media_params {
+  UINT32 tag;
+  UINT32 size;
+  /* offsets are relative to start of boot media */
+  UINT64 fmap_offset;
+  UINT64 cbfs_offset;
+  UINT64 cbfs_size;
+  UINT64 boot_media_size;
+};
+
+/* Flash map (FMAP) of the boot media */
+
+#define FMAP_SIGNATURE  "__FMAP__"
+#define FMAP_STRLEN     32
+
+#pragma pack(1)
+struct fmap_area {
+  UINT32 offset;
+  UINT32 size;
+  UINT8  name[FMAP_STRLEN];
+  UINT16 flags;
+};
+
+struct fmap {
+  UINT8  signature[8];
+  UINT8  ver_major;
+  UINT8  ver_minor;
+  UINT64 base;
+  UINT32 size;
+  UINT8  name[FMAP_STRLEN];
+  UINT16 nareas;
+  struct fmap_area areas[0];
+};
+#pragma pack()
+
 /* Helpful macros */
 
 #define MEM_RANGE_COUNT(_rec) \
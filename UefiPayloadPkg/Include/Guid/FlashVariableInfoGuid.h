@@ -0,0 +1,33 @@
+/** @file
+  This file defines the hob structure for the flash region that holds the
+  non-volatile variables.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __FLASH_VARIABLE_INFO_GUID_H__
+#define __FLASH_VARIABLE_INFO_GUID_H__
+
+///
+/// Flash Variable Region Information GUID
+///
+extern EFI_GUID gUefiFlashVariableInfoGuid;
+
+typedef struct {
+  UINT8              Revision;
+  UINT8              Reserved0[3];
+  UINT32             FlashOffset;   // Linear offset of the region in the flash part
+  UINT64             MmioBase;      // Memory mapped address of the region, 0 if not mapped
+  UINT32             Size;
+  UINT32             BlockSize;     // Erase block size
+} FLASH_VARIABLE_INFO;
+
+#endif
@@ -0,0 +1,54 @@
+/** @file
+  This file defines the hob structure for the PCI resources that the bootloader
+  assigned while it enumerated the PCI bus.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __PCI_RESOURCE_INFO_GUID_H__
+#define __PCI_RESOURCE_INFO_GUID_H__
+
+///
+/// PCI Resource Information GUID
+///
+extern EFI_GUID gUefiPciResourceInfoGuid;
+
+#define PCI_RESOURCE_TYPE_IO       0
+#define PCI_RESOURCE_TYPE_MEM32    1
+#define PCI_RESOURCE_TYPE_PMEM32   2
+#define PCI_RESOURCE_TYPE_MEM64    3
+#define PCI_RESOURCE_TYPE_PMEM64   4
+
+///
+/// One BAR the bootloader assigned. A 64-bit BAR takes a single entry.
+///
+typedef struct {
+  UINT8              Bus;
+  UINT8              Device;
+  UINT8              Function;
+  UINT8              Type;          // PCI_RESOURCE_TYPE_*
+  UINT32             Reserved;
+  UINT64             Base;
+  UINT64             Length;
+} PCI_RESOURCE_DESCRIPTOR;
+
+///
+/// The header is followed by Count PCI_RESOURCE_DESCRIPTOR entries, one for each
+/// BAR of every function the bootloader enumerated. A function without entries
+/// decodes no resources.
+///
+typedef struct {
+  UINT8              Revision;
+  UINT8              Reserved0[3];
+  UINT32             Count;
+} PCI_RESOURCE_INFO;
+
+#endif
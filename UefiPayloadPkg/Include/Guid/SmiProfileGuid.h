@@ -0,0 +1,97 @@
+/** @file
+  This file defines the SMI latency profile kept by the software SMI dispatcher
+  and the SMM communication buffer used to read it.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __SMI_PROFILE_GUID_H__
+#define __SMI_PROFILE_GUID_H__
+
+///
+/// SMI Profile GUID, also the HeaderGuid of the communication buffer
+///
+extern EFI_GUID gUefiSmiProfileGuid;
+
+//
+// Function codes of SMI_PROFILE_COMMUNICATE_HEADER
+//
+#define SMI_PROFILE_FUNCTION_GET_INFO     1
+#define SMI_PROFILE_FUNCTION_GET_RECORDS  2
+#define SMI_PROFILE_FUNCTION_RESET        3   ///< EFI_ACCESS_DENIED after ExitBootServices
+
+//
+// Record types
+//
+#define SMI_PROFILE_RECORD_SMI            0   ///< One pass of the dispatcher, SMI entry to exit
+#define SMI_PROFILE_RECORD_HANDLER        1   ///< One call of a child handler
+
+#define SMI_PROFILE_NO_SW_SMI_VALUE       0xFFFF
+
+///
+/// One entry of the profile ring. Times are in TSC ticks. Child handlers are
+/// identified by their software SMI value only; SMRAM addresses are not exported.
+///
+typedef struct {
+  UINT64    EntryTsc;
+  ///
+  /// Duration, saturated at MAX_UINT32
+  ///
+  UINT32    Ticks;
+  ///
+  /// Software SMI value of the child handler, SMI_PROFILE_NO_SW_SMI_VALUE for SMI records
+  ///
+  UINT16    SwSmiValue;
+  UINT8     Type;
+  ///
+  /// SMI records: dispatch loop iterations. Handler records: 0.
+  ///
+  UINT8     Loops;
+} SMI_PROFILE_RECORD;
+
+typedef struct {
+  UINTN       Function;
+  EFI_STATUS  ReturnStatus;
+  UINT8       Data[1];
+} SMI_PROFILE_COMMUNICATE_HEADER;
+
+#define SMI_PROFILE_COMMUNICATE_HEADER_SIZE  (OFFSET_OF (SMI_PROFILE_COMMUNICATE_HEADER, Data))
+
+///
+/// Data of SMI_PROFILE_FUNCTION_GET_INFO
+///
+typedef struct {
+  UINT32    RingSize;
+  UINT32    Reserved;
+  ///
+  /// Records written since boot or the last reset. Older ones are overwritten.
+  ///
+  UINT64    TotalRecords;
+  UINT64    TotalSmis;
+  UINT64    TotalSmiTicks;
+  UINT64    MaxSmiTicks;
+} SMI_PROFILE_COMMUNICATE_GET_INFO;
+
+///
+/// Data of SMI_PROFILE_FUNCTION_GET_RECORDS. Cursor is the sequence number of
+/// the first record to return; on return it is the sequence number of the next
+/// record. Count is the number of entries in Records on input and the number
+/// returned on output. Lost is the number of records overwritten before they
+/// could be read.
+///
+typedef struct {
+  UINT64              Cursor;
+  UINT32              Count;
+  UINT32              Lost;
+  SMI_PROFILE_RECORD  Records[1];
+} SMI_PROFILE_COMMUNICATE_GET_RECORDS;
+
+#endif
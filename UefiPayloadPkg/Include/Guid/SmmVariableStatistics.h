@@ -0,0 +1,47 @@
+/** @file
+  This file defines the payload specific variable statistics command of the
+  SMM variable communication buffer.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __SMM_VARIABLE_STATISTICS_H__
+#define __SMM_VARIABLE_STATISTICS_H__
+
+//
+// Function code of SMM_VARIABLE_COMMUNICATE_HEADER. It is outside the range
+// used by MdeModulePkg SmmVariableCommon.h.
+//
+#define SMM_VARIABLE_FUNCTION_GET_STATISTICS_EX  0x80
+
+///
+/// Statistics of one variable. Cursor is the index of the entry to return
+/// (0 for the first entry); on return it holds the index of the next entry.
+/// EFI_NOT_FOUND is returned once Cursor is past the last entry.
+///
+typedef struct {
+  UINT32    Cursor;
+  BOOLEAN   Volatile;
+  UINT8     Reserved[3];
+  UINT32    ReadCount;
+  UINT32    WriteCount;
+  UINT32    DeleteCount;
+  UINT32    Reserved2;
+  ///
+  /// Cumulative time spent in the variable services for this variable, in nanoseconds
+  ///
+  UINT64    SmmTime;
+  EFI_GUID  VendorGuid;
+  UINTN     NameSize;
+  CHAR16    Name[1];
+} SMM_VARIABLE_COMMUNICATE_GET_STATISTICS_EX;
+
+#endif
@@ -0,0 +1,34 @@
+/** @file
+  This file defines the hob structure for the TSC frequency that the payload
+  measured once against the ACPI PM timer or the HPET.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __TSC_FREQUENCY_INFO_GUID_H__
+#define __TSC_FREQUENCY_INFO_GUID_H__
+
+///
+/// TSC Frequency Information GUID
+///
+extern EFI_GUID gUefiTscFrequencyInfoGuid;
+
+///
+/// The HOB is only built when the TSC is invariant, so that it can time the
+/// TimerLib delays in every phase.
+///
+typedef struct {
+  UINT8              Revision;
+  UINT8              Reserved0[7];
+  UINT64             Frequency;     // In Hz
+} TSC_FREQUENCY_INFO;
+
+#endif
@@ -0,0 +1,320 @@
+/** @file
+  Log-structured variable store on a flash region.
+
+  Non-volatile variables are appended as records to a flash region that is split
+  into banks. Each record is written ahead of its commit state, so a power loss
+  leaves at most one incomplete record. Deleted records are reclaimed one bank at
+  a time in small steps, and the bank that is erased next is chosen with its erase
+  count in mind so that wear is spread over the region. Volatile variables use the
+  same log on a RAM buffer.
+
+  The flash part is reached only through FLASH_VARIABLE_DEVICE, so a platform can
+  back it with its SPI controller and a host build can back it with an emulator.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __FLASH_VARIABLE_STORE_LIB_H__
+#define __FLASH_VARIABLE_STORE_LIB_H__
+
+typedef struct _FLASH_VARIABLE_DEVICE FLASH_VARIABLE_DEVICE;
+
+/**
+  Read from the flash region.
+
+  @param[in]  Device     The flash device.
+  @param[in]  Offset     Offset in the region.
+  @param[out] Buffer     Buffer receiving the data.
+  @param[in]  Size       Number of bytes to read.
+
+  @retval EFI_SUCCESS        The data was read.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *FLASH_VARIABLE_DEVICE_READ) (
+  IN  FLASH_VARIABLE_DEVICE  *Device,
+  IN  UINT32                 Offset,
+  OUT VOID                   *Buffer,
+  IN  UINT32                 Size
+  );
+
+/**
+  Program the flash region. Programming may only clear bits.
+
+  @param[in] Device      The flash device.
+  @param[in] Offset      Offset in the region.
+  @param[in] Buffer      Data to program.
+  @param[in] Size        Number of bytes to program.
+
+  @retval EFI_SUCCESS        The data was programmed.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *FLASH_VARIABLE_DEVICE_WRITE) (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset,
+  IN CONST VOID              *Buffer,
+  IN UINT32                  Size
+  );
+
+/**
+  Erase one block of the flash region to all 0xFF.
+
+  @param[in] Device      The flash device.
+  @param[in] Offset      Block aligned offset in the region.
+
+  @retval EFI_SUCCESS        The block was erased.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+typedef
+EFI_STATUS
+(EFIAPI *FLASH_VARIABLE_DEVICE_ERASE) (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset
+  );
+
+struct _FLASH_VARIABLE_DEVICE {
+  UINT32                       Size;
+  UINT32                       BlockSize;
+  FLASH_VARIABLE_DEVICE_READ   Read;
+  FLASH_VARIABLE_DEVICE_WRITE  Write;
+  FLASH_VARIABLE_DEVICE_ERASE  Erase;
+};
+
+typedef struct {
+  ///
+  /// Record bytes of the SetVariable() calls that reached flash
+  ///
+  UINT64    BytesRequested;
+  ///
+  /// All bytes programmed, including relocated records and bank headers.
+  /// BytesProgrammed / BytesRequested is the write amplification.
+  ///
+  UINT64    BytesProgrammed;
+  UINT64    BlocksErased;
+  UINT32    MinEraseCount;
+  UINT32    MaxEraseCount;
+  UINT32    FreeBanks;
+  UINT32    BankCount;
+  ///
+  /// Number of GetVariable() calls and the time spent in them, in nanoseconds
+  ///
+  UINT64    ReadCount;
+  UINT64    ReadTime;
+} FLASH_VARIABLE_STORE_STATISTICS;
+
+/**
+  Initialize the variable store.
+
+  The non-volatile log is loaded from the device, or the region is formatted if it
+  is blank. A region that holds other data is not touched. Records left incomplete
+  by a power loss are discarded. If this fails, it may be called again with another
+  device, for example one emulated in RAM.
+
+  @param[in] Device     The flash device of the non-volatile store.
+
+  @retval EFI_SUCCESS           The store is ready.
+  @retval EFI_INVALID_PARAMETER The device geometry cannot hold a store.
+  @retval EFI_VOLUME_CORRUPTED  The region holds data that is not a variable store.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreInitialize (
+  IN FLASH_VARIABLE_DEVICE   *Device
+  );
+
+/**
+  Get a variable's content.
+
+  @param[in]      VariableName    Name of Variable to be found.
+  @param[in]      VendorGuid      Variable vendor GUID.
+  @param[out]     Attributes      Attribute value of the variable found.
+  @param[in, out] DataSize        Size of Data found. If size is less than the
+                                  data, this value contains the required size.
+  @param[out]     Data            Data pointer.
+
+  @return         EFI_INVALID_PARAMETER      Invalid parameter.
+  @return         EFI_SUCCESS                Find the specified variable.
+  @return         EFI_NOT_FOUND              Not found.
+  @return         EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreGetVariable (
+  IN      CHAR16            *VariableName,
+  IN      EFI_GUID          *VendorGuid,
+  OUT     UINT32            *Attributes OPTIONAL,
+  IN OUT  UINTN             *DataSize,
+  OUT     VOID              *Data
+  );
+
+/**
+  Set a variable's content.
+
+  @param[in] VariableName         Name of Variable to be found.
+  @param[in] VendorGuid           Variable vendor GUID.
+  @param[in] Attributes           Attribute value of the variable.
+  @param[in] DataSize             Size of Data.
+  @param[in] Data                 Data pointer.
+
+  @return    EFI_INVALID_PARAMETER            Invalid parameter.
+  @return    EFI_SUCCESS                      Set successfully.
+  @return    EFI_OUT_OF_RESOURCES             Resource not enough to set variable.
+  @return    EFI_NOT_FOUND                    Not found.
+  @return    EFI_DEVICE_ERROR                 The flash reported an error.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreSetVariable (
+  IN CHAR16                  *VariableName,
+  IN EFI_GUID                *VendorGuid,
+  IN UINT32                  Attributes,
+  IN UINTN                   DataSize,
+  IN VOID                    *Data
+  );
+
+/**
+  Find the next variable.
+
+  @param[in, out] VariableNameSize           Size of the variable name.
+  @param[in, out] VariableName               Pointer to variable name.
+  @param[in, out] VendorGuid                 Variable Vendor Guid.
+
+  @return         EFI_INVALID_PARAMETER      Invalid parameter.
+  @return         EFI_SUCCESS                Find the specified variable.
+  @return         EFI_NOT_FOUND              Not found.
+  @return         EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreGetNextVariableName (
+  IN OUT  UINTN             *VariableNameSize,
+  IN OUT  CHAR16            *VariableName,
+  IN OUT  EFI_GUID          *VendorGuid
+  );
+
+/**
+  Return information about the variable store.
+
+  @param[in]  Attributes                    Attributes bitmask to specify the type of variables
+                                            on which to return information.
+  @param[out] MaximumVariableStorageSize    Maximum size of the storage space.
+  @param[out] RemainingVariableStorageSize  Remaining size of the storage space.
+  @param[out] MaximumVariableSize           Maximum size of an individual variable.
+
+  @return     EFI_INVALID_PARAMETER         An invalid combination of attribute bits was supplied.
+  @return     EFI_SUCCESS                   Query successfully.
+  @return     EFI_UNSUPPORTED               The attribute is not supported on this platform.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreQueryVariableInfo (
+  IN  UINT32                 Attributes,
+  OUT UINT64                 *MaximumVariableStorageSize,
+  OUT UINT64                 *RemainingVariableStorageSize,
+  OUT UINT64                 *MaximumVariableSize
+  );
+
+/**
+  Get the size of the record header of a variable.
+
+  @return Size of variable header in bytes.
+
+**/
+UINTN
+EFIAPI
+FlashVariableStoreGetHeaderSize (
+  VOID
+  );
+
+/**
+  Get the maximum size of a non-volatile variable, including its record header.
+
+  @return Non-volatile maximum variable size.
+
+**/
+UINTN
+EFIAPI
+FlashVariableStoreGetMaxVariableSize (
+  VOID
+  );
+
+/**
+  Run reclaim steps until enough free banks are available again.
+
+  Each step copies a bounded amount of live data, so callers can spread reclaim
+  over several calls by passing a small step count.
+
+  @param[in] MaxSteps   Maximum number of steps to run, or 0 for no limit.
+
+  @retval EFI_SUCCESS        Enough banks are free, or the step budget is used up.
+  @retval EFI_DEVICE_ERROR   The flash reported an error.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreReclaim (
+  IN UINTN                   MaxSteps
+  );
+
+/**
+  Restrict the store to runtime access rules after ExitBootServices.
+
+**/
+VOID
+EFIAPI
+FlashVariableStoreExitBootServices (
+  VOID
+  );
+
+/**
+  Compute the FNV-1a hash of a variable name and vendor GUID.
+
+  @param[in] VariableName    Variable name.
+  @param[in] NameSize        Size of VariableName in bytes, including the terminator.
+  @param[in] VendorGuid      Variable vendor GUID.
+
+  @return The 32-bit hash.
+
+**/
+UINT32
+EFIAPI
+FlashVariableStoreComputeHash (
+  IN CONST CHAR16            *VariableName,
+  IN UINTN                   NameSize,
+  IN CONST EFI_GUID          *VendorGuid
+  );
+
+/**
+  Return the write amplification, wear and latency statistics of the store.
+
+  @param[out] Statistics   Receives the statistics.
+
+**/
+VOID
+EFIAPI
+FlashVariableStoreGetStatistics (
+  OUT FLASH_VARIABLE_STORE_STATISTICS  *Statistics
+  );
+
+#endif
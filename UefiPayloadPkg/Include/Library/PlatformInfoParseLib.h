@@ -14,6 +14,8 @@
 **/
 #include <PiPei.h>
 #include <Guid/FrameBufferInfoGuid.h>
+#include <Guid/FlashVariableInfoGuid.h>
+#include <Guid/PciResourceInfoGuid.h>
 #include <Guid/SerialPortInfoGuid.h>
 #include <Guid/SystemTableInfoGuid.h>
 #include <Guid/MemoryMapInfoGuid.h>
@@ -298,6 +300,54 @@ ParseFrameBufferInfoByCb (
   IN FRAME_BUFFER_INFO*     pFbInfo
   );
 
+/**
+  Find the flash variable region information from Slim Bootloader
+
+  @param  pFlashVarInfo      Pointer to the FLASH_VARIABLE_INFO structure
+
+  @retval RETURN_SUCCESS     Successfully find the flash variable region information.
+  @retval RETURN_NOT_FOUND   Failed to find the flash variable region information.
+
+**/
+RETURN_STATUS
+EFIAPI
+ParseFlashVariableInfoByHob (
+  OUT FLASH_VARIABLE_INFO   *pFlashVarInfo
+  );
+
+/**
+  Find the flash variable region from the SMMSTORE area of the coreboot flash map
+
+  @param  pFlashVarInfo      Pointer to the FLASH_VARIABLE_INFO structure
+
+  @retval RETURN_SUCCESS     Successfully find the flash variable region information.
+  @retval RETURN_NOT_FOUND   Failed to find the flash variable region information.
+
+**/
+RETURN_STATUS
+EFIAPI
+ParseFlashVariableInfoByCb (
+  OUT FLASH_VARIABLE_INFO   *pFlashVarInfo
+  );
+
+/**
+  Find the PCI resources assigned by Slim Bootloader
+
+  @param  pPciResInfo        Pointer to receive the PCI_RESOURCE_INFO structure in the
+                             Slim Bootloader hob list
+  @param  pSize              Pointer to receive the size of the structure, descriptors included
+
+  @retval RETURN_SUCCESS     Successfully find the PCI resource information.
+  @retval RETURN_NOT_FOUND   Failed to find the PCI resource information.
+
+**/
+RETURN_STATUS
+EFIAPI
+ParsePciResourceInfoByHob (
+  OUT PCI_RESOURCE_INFO     **pPciResInfo,
+  OUT UINTN                 *pSize
+  );
+
 /**
   Find FSP information from Slim Bootloader
 
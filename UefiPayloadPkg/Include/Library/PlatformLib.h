@@ -433,6 +433,11 @@ BeforeExitSmi (
 /**
   Sends formatted command to TPM for execution and returns formatted response data.
 
+  The command must be executed before this function returns, and ReturnBuffer must
+  hold the response of the TPM itself. The locality granted by
+  Tpm2PlatformRequestUseTpm() is kept across commands, so a CRB or TIS transport
+  should not relinquish and request it again around each command.
+
   @param[in]  InputBuffer       Buffer for the input data.
   @param[in]  InputBufferSize   Size of the input buffer.
   @param[out] ReturnBuffer      Buffer for the output data.
@@ -454,6 +459,9 @@ Tpm2PlatformSubmitCommand (
 /**
   Requests to use TPM2.
 
+  The locality granted here stays held for the following Tpm2PlatformSubmitCommand()
+  calls.
+
   @retval EFI_SUCCESS      Get the control of TPM2 chip.
   @retval EFI_NOT_FOUND    TPM2 not found.
   @retval EFI_DEVICE_ERROR Unexpected device behavior.
@@ -1,6 +1,11 @@
 /** @file
   ACPI Timer implements one instance of Timer Library.
 
+  Once the payload has calibrated the invariant TSC, delays are served from the
+  TSC. The performance counter always reads the ACPI PM timer, so every module
+  timestamps against the same counter for the whole boot, whether it was
+  dispatched before or after the TSC frequency HOB was built.
+
   Copyright (c) 2014, Intel Corporation. All rights reserved.<BR>
   This program and the accompanying materials are
   licensed and made available under the terms and conditions of the BSD License
@@ -20,16 +25,17 @@
 #include <Library/DebugLib.h>
 
 #include <Guid/AcpiBoardInfoGuid.h>
+#include <Guid/TscFrequencyInfoGuid.h>
 #include <IndustryStandard/Acpi.h>
 
 #define ACPI_TIMER_COUNT_SIZE  BIT24
 
-UINTN mPmTimerReg = 0;
+UINTN  mPmTimerReg   = 0;
+UINT64 mTscFrequency = 0;
 
 /**
-  The constructor function enables ACPI IO space.
+  The constructor function caches the ACPI PM timer port and the TSC frequency.
 
-  If ACPI I/O space not enabled, this function will enable it.
   It will always return RETURN_SUCCESS.
 
   @retval EFI_SUCCESS   The constructor always returns RETURN_SUCCESS.
@@ -41,19 +47,32 @@ AcpiTimerLibConstructor (
   VOID
   )
 {
-	EFI_HOB_GUID_TYPE  *GuidHob;
-	ACPI_BOARD_INFO    *pAcpiBoardInfo;	
-	
-	//
-	// Find the acpi board information guid hob
-	//
-	GuidHob = GetFirstGuidHob (&gUefiAcpiBoardInfoGuid);
-	ASSERT (GuidHob != NULL);
-		
-  pAcpiBoardInfo = (ACPI_BOARD_INFO *)GET_GUID_HOB_DATA (GuidHob); 
-  
+  EFI_HOB_GUID_TYPE   *GuidHob;
+  ACPI_BOARD_INFO     *pAcpiBoardInfo;
+  TSC_FREQUENCY_INFO  *pTscFrequencyInfo;
+
+  //
+  // Find the acpi board information guid hob
+  //
+  GuidHob = GetFirstGuidHob (&gUefiAcpiBoardInfoGuid);
+  ASSERT (GuidHob != NULL);
+  if (GuidHob == NULL) {
+    return EFI_SUCCESS;
+  }
+
+  pAcpiBoardInfo = (ACPI_BOARD_INFO *)GET_GUID_HOB_DATA (GuidHob);
+
   mPmTimerReg = (UINTN)pAcpiBoardInfo->PmTimerRegBase;
-	  
+
+  //
+  // The hob only exists when the TSC is invariant and was calibrated
+  //
+  GuidHob = GetFirstGuidHob (&gUefiTscFrequencyInfoGuid);
+  if (GuidHob != NULL) {
+    pTscFrequencyInfo = (TSC_FREQUENCY_INFO *)GET_GUID_HOB_DATA (GuidHob);
+    mTscFrequency = pTscFrequencyInfo->Frequency;
+  }
+
   return EFI_SUCCESS;
 }
 
@@ -70,12 +89,70 @@ InternalAcpiGetTimerTick (
   VOID
   )
 {
-	if (mPmTimerReg == 0)
-		AcpiTimerLibConstructor ();
-		
   return IoRead32 (mPmTimerReg);
 }
 
+/**
+  Make sure the ACPI PM timer port is known before it is polled.
+
+  The acpi board information hob may be built after the constructor ran, so
+  the lookup is retried here, outside of the polling loops.
+
+**/
+VOID
+InternalAcpiTimerInit (
+  VOID
+  )
+{
+  if (mPmTimerReg == 0) {
+    AcpiTimerLibConstructor ();
+  }
+}
+
+/**
+  Convert a period of time to TSC ticks.
+
+  @param  Time      A period of time.
+  @param  Units     The number of Time units per second.
+
+  @return The number of TSC ticks.
+
+**/
+UINT64
+InternalTscTicks (
+  IN      UINT64                    Time,
+  IN      UINT32                    Units
+  )
+{
+  UINT32                            Remainder;
+  UINT64                            Ticks;
+
+  //
+  // Split Time in whole seconds and the remainder so that the products fit in 64 bits
+  //
+  Ticks = MultU64x64 (DivU64x32Remainder (Time, Units, &Remainder), mTscFrequency);
+  return Ticks + DivU64x32 (MultU64x64 (Remainder, mTscFrequency) + Units - 1, Units);
+}
+
+/**
+  Stalls the CPU for at least the given number of TSC ticks.
+
+  @param  Delay     A period of time to delay in ticks.
+
+**/
+VOID
+InternalTscDelay (
+  IN      UINT64                    Delay
+  )
+{
+  UINT64                            Start;
+
+  Start = AsmReadTsc ();
+  while (AsmReadTsc () - Start < Delay) {
+    CpuPause ();
+  }
+}
+
 /**
   Stalls the CPU for at least the given number of ticks.
 
@@ -93,6 +170,8 @@ InternalAcpiDelay (
   UINT32                            Ticks;
   UINT32                            Times;
 
+  InternalAcpiTimerInit ();
+
   Times    = Delay >> 22;
   Delay   &= BIT22 - 1;
   do {
@@ -128,6 +207,11 @@ MicroSecondDelay (
   IN      UINTN                     MicroSeconds
   )
 {
+  if (mTscFrequency != 0) {
+    InternalTscDelay (InternalTscTicks (MicroSeconds, 1000000u));
+    return MicroSeconds;
+  }
+
   InternalAcpiDelay (
     (UINT32)DivU64x32 (
               MultU64x32 (
@@ -156,6 +240,11 @@ NanoSecondDelay (
   IN      UINTN                     NanoSeconds
   )
 {
+  if (mTscFrequency != 0) {
+    InternalTscDelay (InternalTscTicks (NanoSeconds, 1000000000u));
+    return NanoSeconds;
+  }
+
   InternalAcpiDelay (
     (UINT32)DivU64x32 (
               MultU64x32 (
@@ -186,6 +275,7 @@ GetPerformanceCounter (
   VOID
   )
 {
+  InternalAcpiTimerInit ();
   return (UINT64)InternalAcpiGetTimerTick ();
 }
 
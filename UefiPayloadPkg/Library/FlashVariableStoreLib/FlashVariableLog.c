@@ -0,0 +1,924 @@
+/** @file
+  Banks and records of the log-structured flash variable store.
+
+  The region is split into banks. Records are only appended to the bank with the
+  highest sequence number, and a bank is only erased after reclaim has moved all
+  of its live records to the active bank. A new copy of a record is always
+  committed before the old copy is marked deleted, so after a power loss the
+  copy in the newer bank, or at the higher offset, is the valid one.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FlashVariableStoreInternal.h"
+
+UINT8                             *mFlashVariableScratch = NULL;
+
+/**
+  Return the offset of a bank in its log.
+
+  @param[in] Log      The log.
+  @param[in] Bank     Index of the bank.
+
+  @return Offset of the bank.
+
+**/
+STATIC
+UINT32
+BankBase (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Bank
+  )
+{
+  return Bank * Log->BankSize;
+}
+
+/**
+  Read from a log.
+
+  @param[in]  Log      The log.
+  @param[in]  Offset   Offset in the log.
+  @param[out] Buffer   Buffer receiving the data.
+  @param[in]  Size     Number of bytes to read.
+
+  @retval EFI_SUCCESS        The data was read.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogRead (
+  IN  FLASH_VARIABLE_LOG    *Log,
+  IN  UINT32                Offset,
+  OUT VOID                  *Buffer,
+  IN  UINT32                Size
+  )
+{
+  ASSERT (Offset + Size <= Log->Device->Size);
+  return Log->Device->Read (Log->Device, Offset, Buffer, Size);
+}
+
+/**
+  Program a log and account the bytes to the write amplification statistics.
+
+  @param[in] Log      The log.
+  @param[in] Offset   Offset in the log.
+  @param[in] Buffer   Data to program.
+  @param[in] Size     Number of bytes to program.
+
+  @retval EFI_SUCCESS        The data was programmed.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+STATIC
+EFI_STATUS
+LogWrite (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Offset,
+  IN CONST VOID             *Buffer,
+  IN UINT32                 Size
+  )
+{
+  ASSERT (Offset + Size <= Log->Device->Size);
+  if (Log->NonVolatile) {
+    mFlashVariableStatistics.BytesProgrammed += Size;
+  }
+  return Log->Device->Write (Log->Device, Offset, Buffer, Size);
+}
+
+/**
+  Erase a bank and prepare it as a free bank.
+
+  @param[in] Log          The log.
+  @param[in] Bank         Index of the bank.
+
+  @retval EFI_SUCCESS        The bank is free.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+STATIC
+EFI_STATUS
+LogEraseBank (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Bank
+  )
+{
+  EFI_STATUS                  Status;
+  FLASH_VARIABLE_BANK_HEADER  BankHeader;
+  FLASH_VARIABLE_BANK         *BankInfo;
+  UINT32                      Offset;
+
+  BankInfo = &Log->Banks[Bank];
+  ASSERT (Bank != Log->ActiveBank);
+  ASSERT (BankInfo->State != FLASH_VARIABLE_BANK_FREE);
+
+  for (Offset = 0; Offset < Log->BankSize; Offset += Log->Device->BlockSize) {
+    Status = Log->Device->Erase (Log->Device, BankBase (Log, Bank) + Offset);
+    if (EFI_ERROR (Status)) {
+      BankInfo->State = FLASH_VARIABLE_BANK_DIRTY;
+      return Status;
+    }
+    if (Log->NonVolatile) {
+      mFlashVariableStatistics.BlocksErased++;
+    }
+  }
+
+  if (BankInfo->State == FLASH_VARIABLE_BANK_IN_USE) {
+    ASSERT (Log->TotalLive >= BankInfo->Live);
+    Log->TotalLive -= BankInfo->Live;
+  }
+  BankInfo->State      = FLASH_VARIABLE_BANK_DIRTY;
+  BankInfo->EraseCount++;
+  BankInfo->Sequence   = MAX_UINT32;
+  BankInfo->Live       = 0;
+  BankInfo->Closed     = FALSE;
+  BankInfo->End        = sizeof (FLASH_VARIABLE_BANK_HEADER);
+
+  SetMem (&BankHeader, sizeof (BankHeader), 0xFF);
+  BankHeader.Signature  = FLASH_VARIABLE_BANK_SIGNATURE;
+  BankHeader.State      = FLASH_VARIABLE_BANK_FREE;
+  BankHeader.EraseCount = BankInfo->EraseCount;
+  BankHeader.BankSize   = Log->BankSize;
+  Status = LogWrite (Log, BankBase (Log, Bank), &BankHeader, sizeof (BankHeader));
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  BankInfo->State = FLASH_VARIABLE_BANK_FREE;
+  Log->FreeBanks++;
+  return EFI_SUCCESS;
+}
+
+/**
+  Make the least worn free bank the active bank.
+
+  @param[in] Log          The log.
+  @param[in] UseReserve   TRUE if the reserved bank may be activated.
+
+  @retval EFI_SUCCESS           A bank was activated.
+  @retval EFI_OUT_OF_RESOURCES  No free bank is available.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+STATIC
+EFI_STATUS
+LogActivateBank (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN BOOLEAN                UseReserve
+  )
+{
+  EFI_STATUS                  Status;
+  UINT32                      Bank;
+  UINT32                      Best;
+  FLASH_VARIABLE_BANK         *BankInfo;
+  UINT32                      Sequence;
+  UINT8                       State;
+
+  if ((Log->FreeBanks == 0) ||
+      (!UseReserve && (Log->FreeBanks <= FLASH_VARIABLE_RESERVED_BANKS))) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Best = FLASH_VARIABLE_INVALID_BANK;
+  for (Bank = 0; Bank < Log->BankCount; Bank++) {
+    if ((Log->Banks[Bank].State == FLASH_VARIABLE_BANK_FREE) &&
+        ((Best == FLASH_VARIABLE_INVALID_BANK) || (Log->Banks[Bank].EraseCount < Log->Banks[Best].EraseCount))) {
+      Best = Bank;
+    }
+  }
+  ASSERT (Best != FLASH_VARIABLE_INVALID_BANK);
+
+  if (Log->ActiveBank != FLASH_VARIABLE_INVALID_BANK) {
+    Log->Banks[Log->ActiveBank].Closed = TRUE;
+  }
+  Log->ActiveBank = FLASH_VARIABLE_INVALID_BANK;
+
+  BankInfo = &Log->Banks[Best];
+  Sequence = ++Log->Sequence;
+  Status = LogWrite (
+             Log,
+             BankBase (Log, Best) + OFFSET_OF (FLASH_VARIABLE_BANK_HEADER, Sequence),
+             &Sequence,
+             sizeof (Sequence)
+             );
+  if (!EFI_ERROR (Status)) {
+    State  = FLASH_VARIABLE_BANK_IN_USE;
+    Status = LogWrite (
+               Log,
+               BankBase (Log, Best) + OFFSET_OF (FLASH_VARIABLE_BANK_HEADER, State),
+               &State,
+               sizeof (State)
+               );
+  }
+  Log->FreeBanks--;
+  if (EFI_ERROR (Status)) {
+    BankInfo->State = FLASH_VARIABLE_BANK_DIRTY;
+    return Status;
+  }
+
+  BankInfo->State    = FLASH_VARIABLE_BANK_IN_USE;
+  BankInfo->Sequence = Sequence;
+  BankInfo->End      = sizeof (FLASH_VARIABLE_BANK_HEADER);
+  BankInfo->Live     = 0;
+  BankInfo->Closed   = FALSE;
+  Log->ActiveBank    = Best;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Check a record header read from a bank.
+
+  @param[in] Log          The log.
+  @param[in] Header       The record header.
+  @param[in] BankOffset   Bank relative offset of the record.
+
+  @retval TRUE     The header is complete and the record fits in the bank.
+  @retval FALSE    The header is torn or corrupted.
+
+**/
+STATIC
+BOOLEAN
+LogIsHeaderValid (
+  IN FLASH_VARIABLE_LOG           *Log,
+  IN CONST FLASH_VARIABLE_HEADER  *Header,
+  IN UINT32                       BankOffset
+  )
+{
+  FLASH_VARIABLE_HEADER           Copy;
+
+  if (Header->StartId != FLASH_VARIABLE_START_ID) {
+    return FALSE;
+  }
+  CopyMem (&Copy, Header, sizeof (Copy));
+  Copy.State = 0;
+  if (CalculateSum8 ((UINT8 *) &Copy, sizeof (Copy)) != 0) {
+    return FALSE;
+  }
+  if ((Header->NameSize < sizeof (CHAR16)) ||
+      ((Header->NameSize & 1) != 0) ||
+      (Header->NameSize > Log->BankSize) ||
+      (Header->DataSize > Log->BankSize) ||
+      (FLASH_VARIABLE_RECORD_SIZE (Header->NameSize, Header->DataSize) > Log->BankSize - BankOffset)) {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+  Check whether a record header slot is still erased.
+
+  @param[in] Header       The record header.
+
+  @retval TRUE     All bytes of the header are 0xFF.
+  @retval FALSE    Some byte of the header was programmed.
+
+**/
+STATIC
+BOOLEAN
+LogIsHeaderErased (
+  IN CONST FLASH_VARIABLE_HEADER  *Header
+  )
+{
+  CONST UINT8                     *Bytes;
+  UINTN                           Index;
+
+  Bytes = (CONST UINT8 *) Header;
+  for (Index = 0; Index < sizeof (*Header); Index++) {
+    if (Bytes[Index] != 0xFF) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+/**
+  Check whether a bank is completely erased.
+
+  @param[in]  Log       The log.
+  @param[in]  Bank      Index of the bank.
+  @param[out] Blank     TRUE if all bytes of the bank are 0xFF.
+
+  @retval EFI_SUCCESS        The bank was checked.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+STATIC
+EFI_STATUS
+LogIsBankBlank (
+  IN  FLASH_VARIABLE_LOG    *Log,
+  IN  UINT32                Bank,
+  OUT BOOLEAN               *Blank
+  )
+{
+  EFI_STATUS                Status;
+  UINT32                    Buffer[16];
+  UINT32                    Offset;
+  UINTN                     Index;
+
+  //
+  // Bank sizes are multiples of the erase block size, so of sizeof (Buffer)
+  //
+  *Blank = FALSE;
+  for (Offset = 0; Offset < Log->BankSize; Offset += sizeof (Buffer)) {
+    Status = LogRead (Log, BankBase (Log, Bank) + Offset, Buffer, sizeof (Buffer));
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    for (Index = 0; Index < sizeof (Buffer) / sizeof (Buffer[0]); Index++) {
+      if (Buffer[Index] != MAX_UINT32) {
+        return EFI_SUCCESS;
+      }
+    }
+  }
+
+  *Blank = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Set up a log over a device and bring its banks to a known state.
+
+  Banks that hold neither a valid FREE nor a valid IN_USE header are erased.
+  A non-volatile region without any bank header is only formatted if it is
+  blank, so data that is not a log is never erased.
+
+  @param[in] Log           The log.
+  @param[in] Device        The device backing the log.
+  @param[in] NonVolatile   TRUE if the log holds non-volatile variables.
+
+  @retval EFI_SUCCESS           The log is set up.
+  @retval EFI_INVALID_PARAMETER The device geometry cannot hold a log.
+  @retval EFI_VOLUME_CORRUPTED  The region holds data that is not a log.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+LogInitialize (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN FLASH_VARIABLE_DEVICE  *Device,
+  IN BOOLEAN                NonVolatile
+  )
+{
+  EFI_STATUS                  Status;
+  FLASH_VARIABLE_BANK_HEADER  BankHeader;
+  FLASH_VARIABLE_BANK         *BankInfo;
+  UINT32                      BankSize;
+  UINT32                      Bank;
+  UINT32                      MaxEraseCount;
+  UINT32                      KnownBanks;
+  BOOLEAN                     Blank;
+
+  if ((Device->BlockSize == 0) || ((Device->Size % Device->BlockSize) != 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  BankSize = MAX (Device->BlockSize, ALIGN_VALUE (FLASH_VARIABLE_BANK_SIZE, Device->BlockSize));
+  while ((Device->Size / BankSize < FLASH_VARIABLE_PREFERRED_BANKS) && (BankSize > Device->BlockSize)) {
+    BankSize = MAX (Device->BlockSize, ALIGN_VALUE (BankSize / 2, Device->BlockSize));
+  }
+  if ((Device->Size / BankSize < FLASH_VARIABLE_MIN_BANKS) ||
+      (BankSize <= sizeof (FLASH_VARIABLE_BANK_HEADER) + sizeof (FLASH_VARIABLE_HEADER))) {
+    DEBUG ((DEBUG_ERROR, "FlashVariable: region of 0x%x bytes is too small\n", Device->Size));
+    return EFI_INVALID_PARAMETER;
+  }
+
+  ZeroMem (Log, sizeof (*Log));
+  Log->Device      = Device;
+  Log->NonVolatile = NonVolatile;
+  Log->BankSize    = BankSize;
+  Log->BankCount   = Device->Size / BankSize;
+  Log->ActiveBank  = FLASH_VARIABLE_INVALID_BANK;
+  Log->ReclaimBank = FLASH_VARIABLE_INVALID_BANK;
+  Log->Banks       = AllocateZeroPool (Log->BankCount * sizeof (FLASH_VARIABLE_BANK));
+  if (Log->Banks == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  MaxEraseCount = 0;
+  KnownBanks    = 0;
+  for (Bank = 0; Bank < Log->BankCount; Bank++) {
+    BankInfo = &Log->Banks[Bank];
+    BankInfo->State      = FLASH_VARIABLE_BANK_DIRTY;
+    BankInfo->Sequence   = MAX_UINT32;
+    BankInfo->EraseCount = MAX_UINT32;
+    BankInfo->End        = sizeof (FLASH_VARIABLE_BANK_HEADER);
+
+    Status = LogRead (Log, BankBase (Log, Bank), &BankHeader, sizeof (BankHeader));
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    if ((BankHeader.Signature != FLASH_VARIABLE_BANK_SIGNATURE) || (BankHeader.BankSize != BankSize)) {
+      continue;
+    }
+
+    KnownBanks++;
+    BankInfo->EraseCount = BankHeader.EraseCount;
+    MaxEraseCount        = MAX (MaxEraseCount, BankHeader.EraseCount);
+    if ((BankHeader.State == FLASH_VARIABLE_BANK_IN_USE) && (BankHeader.Sequence != MAX_UINT32)) {
+      BankInfo->State    = FLASH_VARIABLE_BANK_IN_USE;
+      BankInfo->Sequence = BankHeader.Sequence;
+      Log->Sequence      = MAX (Log->Sequence, BankHeader.Sequence);
+    } else if ((BankHeader.State == FLASH_VARIABLE_BANK_FREE) && (BankHeader.Sequence == MAX_UINT32)) {
+      BankInfo->State = FLASH_VARIABLE_BANK_FREE;
+      Log->FreeBanks++;
+    }
+    //
+    // Anything else is an interrupted activation and is erased below
+    //
+  }
+
+  if (NonVolatile && (KnownBanks == 0)) {
+    for (Bank = 0; Bank < Log->BankCount; Bank++) {
+      Status = LogIsBankBlank (Log, Bank, &Blank);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      if (!Blank) {
+        DEBUG ((DEBUG_ERROR, "FlashVariable: region holds foreign data, not formatting it\n"));
+        FreePool (Log->Banks);
+        Log->Banks = NULL;
+        return EFI_VOLUME_CORRUPTED;
+      }
+    }
+    DEBUG ((DEBUG_INFO, "FlashVariable: formatting blank region\n"));
+  }
+
+  //
+  // Banks with an unknown erase count get the highest known one, so wear
+  // leveling does not pick them first.
+  //
+  for (Bank = 0; Bank < Log->BankCount; Bank++) {
+    BankInfo = &Log->Banks[Bank];
+    if (BankInfo->EraseCount == MAX_UINT32) {
+      BankInfo->EraseCount = MaxEraseCount;
+    }
+    if (BankInfo->State == FLASH_VARIABLE_BANK_DIRTY) {
+      Status = LogEraseBank (Log, Bank);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+  }
+
+  DEBUG ((DEBUG_INFO, "FlashVariable: %d banks of 0x%x bytes, %d free\n", Log->BankCount, Log->BankSize, Log->FreeBanks));
+  return EFI_SUCCESS;
+}
+
+/**
+  Scan the records of one bank and report the committed ones.
+
+  @param[in] Log      The log.
+  @param[in] Bank     Index of the bank.
+
+  @retval EFI_SUCCESS        The bank is scanned.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+STATIC
+EFI_STATUS
+LogScanBank (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Bank
+  )
+{
+  EFI_STATUS                Status;
+  FLASH_VARIABLE_BANK       *BankInfo;
+  FLASH_VARIABLE_HEADER     Header;
+  UINT32                    BankOffset;
+  UINT32                    Size;
+
+  BankInfo   = &Log->Banks[Bank];
+  BankOffset = sizeof (FLASH_VARIABLE_BANK_HEADER);
+  while (BankOffset + sizeof (FLASH_VARIABLE_HEADER) <= Log->BankSize) {
+    Status = LogRead (Log, BankBase (Log, Bank) + BankOffset, &Header, sizeof (Header));
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    if (LogIsHeaderErased (&Header)) {
+      break;
+    }
+    if (!LogIsHeaderValid (Log, &Header, BankOffset)) {
+      //
+      // A torn header: its size cannot be trusted, so nothing is appended after it
+      //
+      DEBUG ((DEBUG_WARN, "FlashVariable: torn record at bank %d offset 0x%x\n", Bank, BankOffset));
+      BankInfo->Closed = TRUE;
+      break;
+    }
+
+    Size = FLASH_VARIABLE_RECORD_SIZE (Header.NameSize, Header.DataSize);
+    if (Header.State == FLASH_VARIABLE_ADDED) {
+      Status = LogRead (
+                 Log,
+                 BankBase (Log, Bank) + BankOffset + sizeof (FLASH_VARIABLE_HEADER),
+                 mFlashVariableScratch,
+                 Header.NameSize
+                 );
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+      BankInfo->Live += Size;
+      Log->TotalLive += Size;
+      StoreLoadRecord (Log, BankBase (Log, Bank) + BankOffset, &Header, (CHAR16 *) mFlashVariableScratch);
+    }
+    //
+    // Records that were never committed are garbage, like deleted ones
+    //
+    BankOffset += Size;
+  }
+
+  BankInfo->End = BankOffset;
+  return EFI_SUCCESS;
+}
+
+/**
+  Scan the records of all banks in sequence order and report the committed
+  ones with StoreLoadRecord().
+
+  @param[in] Log      The log.
+
+  @retval EFI_SUCCESS        The log is loaded.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogLoad (
+  IN FLASH_VARIABLE_LOG     *Log
+  )
+{
+  EFI_STATUS                Status;
+  UINT32                    Bank;
+  UINT32                    Next;
+  UINT32                    Last;
+
+  Last = FLASH_VARIABLE_INVALID_BANK;
+  while (TRUE) {
+    Next = FLASH_VARIABLE_INVALID_BANK;
+    for (Bank = 0; Bank < Log->BankCount; Bank++) {
+      if ((Log->Banks[Bank].State != FLASH_VARIABLE_BANK_IN_USE) ||
+          ((Last != FLASH_VARIABLE_INVALID_BANK) && (Log->Banks[Bank].Sequence <= Log->Banks[Last].Sequence))) {
+        continue;
+      }
+      if ((Next == FLASH_VARIABLE_INVALID_BANK) || (Log->Banks[Bank].Sequence < Log->Banks[Next].Sequence)) {
+        Next = Bank;
+      }
+    }
+    if (Next == FLASH_VARIABLE_INVALID_BANK) {
+      break;
+    }
+
+    Status = LogScanBank (Log, Next);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    if (Last != FLASH_VARIABLE_INVALID_BANK) {
+      Log->Banks[Last].Closed = TRUE;
+    }
+    Last = Next;
+  }
+
+  //
+  // Only the newest bank is appended to
+  //
+  if ((Last != FLASH_VARIABLE_INVALID_BANK) && !Log->Banks[Last].Closed) {
+    Log->ActiveBank = Last;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Append a record to the active bank, activating a free bank if needed.
+
+  @param[in]  Log          The log.
+  @param[in]  Record       The record, header included. Its State is updated.
+  @param[in]  Size         Size of the record.
+  @param[in]  UseReserve   TRUE if the reserved bank may be activated.
+  @param[out] Offset       Offset of the record in the log.
+
+  @retval EFI_SUCCESS           The record is committed.
+  @retval EFI_OUT_OF_RESOURCES  No bank can take the record.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+LogWriteRecord (
+  IN  FLASH_VARIABLE_LOG    *Log,
+  IN  FLASH_VARIABLE_HEADER *Record,
+  IN  UINT32                Size,
+  IN  BOOLEAN               UseReserve,
+  OUT UINT32                *Offset
+  )
+{
+  EFI_STATUS                Status;
+  FLASH_VARIABLE_BANK       *BankInfo;
+  UINT8                     State;
+
+  ASSERT (Size <= LogMaxRecordSize (Log));
+  if ((Log->ActiveBank == FLASH_VARIABLE_INVALID_BANK) ||
+      (Log->Banks[Log->ActiveBank].End + Size > Log->BankSize)) {
+    Status = LogActivateBank (Log, UseReserve);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  //
+  // The space is used even if programming fails below
+  //
+  BankInfo       = &Log->Banks[Log->ActiveBank];
+  *Offset        = BankBase (Log, Log->ActiveBank) + BankInfo->End;
+  BankInfo->End += Size;
+
+  Record->State = FLASH_VARIABLE_HEADER_VALID;
+  Status = LogWrite (Log, *Offset, Record, sizeof (FLASH_VARIABLE_HEADER));
+  if (!EFI_ERROR (Status)) {
+    Status = LogWrite (Log, *Offset + sizeof (FLASH_VARIABLE_HEADER), Record + 1, Size - sizeof (FLASH_VARIABLE_HEADER));
+  }
+  if (!EFI_ERROR (Status)) {
+    State  = FLASH_VARIABLE_ADDED;
+    Status = LogWrite (Log, *Offset + OFFSET_OF (FLASH_VARIABLE_HEADER, State), &State, sizeof (State));
+  }
+  if (EFI_ERROR (Status)) {
+    BankInfo->Closed = TRUE;
+    Log->ActiveBank  = FLASH_VARIABLE_INVALID_BANK;
+    return Status;
+  }
+  Record->State = FLASH_VARIABLE_ADDED;
+
+  BankInfo->Live += Size;
+  Log->TotalLive += Size;
+  return EFI_SUCCESS;
+}
+
+/**
+  Mark a record deleted.
+
+  @param[in] Log      The log.
+  @param[in] Offset   Offset of the record in the log.
+
+  @retval EFI_SUCCESS        The record is deleted.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogDeleteRecord (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Offset
+  )
+{
+  EFI_STATUS                Status;
+  FLASH_VARIABLE_HEADER     Header;
+  FLASH_VARIABLE_BANK       *BankInfo;
+  UINT32                    Size;
+  UINT8                     State;
+
+  Status = LogRead (Log, Offset, &Header, sizeof (Header));
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  ASSERT (Header.State == FLASH_VARIABLE_ADDED);
+
+  State  = FLASH_VARIABLE_DELETED;
+  Status = LogWrite (Log, Offset + OFFSET_OF (FLASH_VARIABLE_HEADER, State), &State, sizeof (State));
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Size     = FLASH_VARIABLE_RECORD_SIZE (Header.NameSize, Header.DataSize);
+  BankInfo = &Log->Banks[Offset / Log->BankSize];
+  ASSERT (BankInfo->Live >= Size);
+  BankInfo->Live -= Size;
+  Log->TotalLive -= Size;
+  return EFI_SUCCESS;
+}
+
+/**
+  Pick the bank to reclaim next.
+
+  The bank with the most reclaimable space is picked, the less worn one on a tie.
+  In the background only banks that are at least half reclaimable are picked,
+  unless a bank lags behind in wear.
+
+  @param[in] Log          The log.
+  @param[in] Background   TRUE for background reclaim.
+
+  @return Index of the bank, or FLASH_VARIABLE_INVALID_BANK.
+
+**/
+STATIC
+UINT32
+LogSelectVictim (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN BOOLEAN                Background
+  )
+{
+  FLASH_VARIABLE_BANK       *BankInfo;
+  UINT32                    Bank;
+  UINT32                    Best;
+  UINT32                    BestGain;
+  UINT32                    Gain;
+  UINT32                    Coldest;
+  UINT32                    MaxEraseCount;
+
+  Best          = FLASH_VARIABLE_INVALID_BANK;
+  BestGain      = 0;
+  Coldest       = FLASH_VARIABLE_INVALID_BANK;
+  MaxEraseCount = 0;
+  for (Bank = 0; Bank < Log->BankCount; Bank++) {
+    BankInfo      = &Log->Banks[Bank];
+    MaxEraseCount = MAX (MaxEraseCount, BankInfo->EraseCount);
+    if ((BankInfo->State != FLASH_VARIABLE_BANK_IN_USE) || (Bank == Log->ActiveBank)) {
+      continue;
+    }
+    if ((Coldest == FLASH_VARIABLE_INVALID_BANK) || (BankInfo->EraseCount < Log->Banks[Coldest].EraseCount)) {
+      Coldest = Bank;
+    }
+    Gain = LogMaxRecordSize (Log) - BankInfo->Live;
+    if ((Gain > BestGain) ||
+        ((Gain == BestGain) && (Gain != 0) && (BankInfo->EraseCount < Log->Banks[Best].EraseCount))) {
+      Best     = Bank;
+      BestGain = Gain;
+    }
+  }
+
+  if (Background) {
+    if (Log->NonVolatile && (Coldest != FLASH_VARIABLE_INVALID_BANK) &&
+        (MaxEraseCount - Log->Banks[Coldest].EraseCount > FLASH_VARIABLE_WEAR_THRESHOLD)) {
+      return Coldest;
+    }
+    if (BestGain < LogMaxRecordSize (Log) / 2) {
+      return FLASH_VARIABLE_INVALID_BANK;
+    }
+  }
+
+  return Best;
+}
+
+/**
+  Run one bounded reclaim step.
+
+  @param[in] Log          The log.
+  @param[in] Background   TRUE to only pick banks worth reclaiming now, or banks
+                          that lag behind in wear.
+
+  @retval EFI_SUCCESS        A step was run.
+  @retval EFI_NOT_FOUND      No bank needs reclaim.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogReclaimStep (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN BOOLEAN                Background
+  )
+{
+  EFI_STATUS                Status;
+  FLASH_VARIABLE_BANK       *BankInfo;
+  FLASH_VARIABLE_HEADER     *Record;
+  UINT32                    Bank;
+  UINT32                    Offset;
+  UINT32                    NewOffset;
+  UINT32                    Size;
+  UINT32                    Moved;
+
+  if (Log->ReclaimBank == FLASH_VARIABLE_INVALID_BANK) {
+    Bank = LogSelectVictim (Log, Background);
+    if (Bank == FLASH_VARIABLE_INVALID_BANK) {
+      return EFI_NOT_FOUND;
+    }
+    Log->ReclaimBank   = Bank;
+    Log->ReclaimOffset = sizeof (FLASH_VARIABLE_BANK_HEADER);
+  }
+
+  Bank     = Log->ReclaimBank;
+  BankInfo = &Log->Banks[Bank];
+  Record   = (FLASH_VARIABLE_HEADER *) mFlashVariableScratch;
+  Moved    = 0;
+  while ((BankInfo->Live != 0) && (Log->ReclaimOffset < BankInfo->End) &&
+         (Moved < FLASH_VARIABLE_RECLAIM_STEP_SIZE)) {
+    Offset = BankBase (Log, Bank) + Log->ReclaimOffset;
+    Status = LogRead (Log, Offset, Record, sizeof (FLASH_VARIABLE_HEADER));
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    ASSERT (LogIsHeaderValid (Log, Record, Log->ReclaimOffset));
+    Size = FLASH_VARIABLE_RECORD_SIZE (Record->NameSize, Record->DataSize);
+    Log->ReclaimOffset += Size;
+    if (Record->State != FLASH_VARIABLE_ADDED) {
+      continue;
+    }
+
+    //
+    // Commit the copy before the original is deleted
+    //
+    Status = LogRead (Log, Offset, Record, Size);
+    if (!EFI_ERROR (Status)) {
+      Status = LogWriteRecord (Log, Record, Size, TRUE, &NewOffset);
+    }
+    if (EFI_ERROR (Status)) {
+      Log->ReclaimOffset -= Size;
+      return Status;
+    }
+    StoreRelocateRecord (Log, Offset, NewOffset, Record);
+    Status = LogDeleteRecord (Log, Offset);
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+    Moved += Size;
+  }
+
+  if ((BankInfo->Live == 0) || (Log->ReclaimOffset >= BankInfo->End)) {
+    ASSERT (BankInfo->Live == 0);
+    Log->ReclaimBank = FLASH_VARIABLE_INVALID_BANK;
+    return LogEraseBank (Log, Bank);
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Make sure a record of the given size can be appended without using the
+  reserved bank, reclaiming banks as needed.
+
+  @param[in] Log      The log.
+  @param[in] Size     Size of the record.
+
+  @retval EFI_SUCCESS           The record can be appended.
+  @retval EFI_OUT_OF_RESOURCES  Reclaim cannot free enough space.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+LogEnsureSpace (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Size
+  )
+{
+  EFI_STATUS                Status;
+  UINT32                    Steps;
+  UINT32                    MaxSteps;
+
+  MaxSteps = Log->BankCount * (Log->BankSize / FLASH_VARIABLE_RECLAIM_STEP_SIZE + 1);
+  for (Steps = 0; ; Steps++) {
+    if ((Log->ActiveBank != FLASH_VARIABLE_INVALID_BANK) &&
+        (Log->Banks[Log->ActiveBank].End + Size <= Log->BankSize)) {
+      return EFI_SUCCESS;
+    }
+    if (Log->FreeBanks > FLASH_VARIABLE_RESERVED_BANKS) {
+      return EFI_SUCCESS;
+    }
+    if (Steps == MaxSteps) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+
+    Status = LogReclaimStep (Log, FALSE);
+    if (Status == EFI_NOT_FOUND) {
+      return EFI_OUT_OF_RESOURCES;
+    }
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+}
+
+/**
+  Return the largest record the log can hold.
+
+  @param[in] Log      The log.
+
+  @return Maximum record size in bytes.
+
+**/
+UINT32
+LogMaxRecordSize (
+  IN FLASH_VARIABLE_LOG     *Log
+  )
+{
+  return Log->BankSize - sizeof (FLASH_VARIABLE_BANK_HEADER);
+}
+
+/**
+  Return the space available to records, the reserved bank excluded.
+
+  @param[in] Log      The log.
+
+  @return Capacity in bytes.
+
+**/
+UINT32
+LogCapacity (
+  IN FLASH_VARIABLE_LOG     *Log
+  )
+{
+  return (Log->BankCount - FLASH_VARIABLE_RESERVED_BANKS) * LogMaxRecordSize (Log);
+}
@@ -0,0 +1,1072 @@
+/** @file
+  Variable services on top of the log-structured flash variable store.
+
+  Variables are found through a hash index in RAM that caches the name of each
+  variable, and the data of small ones, so that GetVariable() and
+  GetNextVariableName() rarely touch the flash part.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "FlashVariableStoreInternal.h"
+
+#define FLASH_VARIABLE_ATTRIBUTES_MASK  (EFI_VARIABLE_NON_VOLATILE | \
+                                         EFI_VARIABLE_BOOTSERVICE_ACCESS | \
+                                         EFI_VARIABLE_RUNTIME_ACCESS | \
+                                         EFI_VARIABLE_HARDWARE_ERROR_RECORD | \
+                                         EFI_VARIABLE_APPEND_WRITE)
+
+#define FLASH_VARIABLE_AUTHENTICATED    (EFI_VARIABLE_AUTHENTICATED_WRITE_ACCESS | \
+                                         EFI_VARIABLE_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)
+
+FLASH_VARIABLE_STORE_STATISTICS   mFlashVariableStatistics;
+
+STATIC BOOLEAN                    mStoreReady = FALSE;
+STATIC BOOLEAN                    mStoreAtRuntime = FALSE;
+STATIC FLASH_VARIABLE_LOG         mNvLog;
+STATIC FLASH_VARIABLE_LOG         mVolatileLog;
+STATIC FLASH_VARIABLE_DEVICE      mVolatileDevice;
+STATIC UINT8                      *mVolatileBuffer;
+STATIC FLASH_VARIABLE_ENTRY       *mEntries;
+STATIC UINT16                     *mHashBuckets;
+STATIC UINT16                     mFreeEntry;
+STATIC UINT16                     mOrderHead;
+STATIC UINT16                     mOrderTail;
+STATIC UINT64                     mPerformanceCounterStart;
+STATIC UINT64                     mPerformanceCounterEnd;
+
+/**
+  Read from the RAM device of the volatile log.
+
+  @param[in]  Device     The RAM device.
+  @param[in]  Offset     Offset in the device.
+  @param[out] Buffer     Buffer receiving the data.
+  @param[in]  Size       Number of bytes to read.
+
+  @retval EFI_SUCCESS    The data was read.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+VolatileDeviceRead (
+  IN  FLASH_VARIABLE_DEVICE  *Device,
+  IN  UINT32                 Offset,
+  OUT VOID                   *Buffer,
+  IN  UINT32                 Size
+  )
+{
+  CopyMem (Buffer, mVolatileBuffer + Offset, Size);
+  return EFI_SUCCESS;
+}
+
+/**
+  Write to the RAM device of the volatile log.
+
+  @param[in] Device      The RAM device.
+  @param[in] Offset      Offset in the device.
+  @param[in] Buffer      Data to write.
+  @param[in] Size        Number of bytes to write.
+
+  @retval EFI_SUCCESS    The data was written.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+VolatileDeviceWrite (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset,
+  IN CONST VOID              *Buffer,
+  IN UINT32                  Size
+  )
+{
+  CopyMem (mVolatileBuffer + Offset, Buffer, Size);
+  return EFI_SUCCESS;
+}
+
+/**
+  Erase one block of the RAM device of the volatile log.
+
+  @param[in] Device      The RAM device.
+  @param[in] Offset      Block aligned offset in the device.
+
+  @retval EFI_SUCCESS    The block was erased.
+
+**/
+STATIC
+EFI_STATUS
+EFIAPI
+VolatileDeviceErase (
+  IN FLASH_VARIABLE_DEVICE   *Device,
+  IN UINT32                  Offset
+  )
+{
+  SetMem (mVolatileBuffer + Offset, Device->BlockSize, 0xFF);
+  return EFI_SUCCESS;
+}
+
+/**
+  Compute the FNV-1a hash of a variable name and vendor GUID.
+
+  @param[in] VariableName    Variable name.
+  @param[in] NameSize        Size of VariableName in bytes, including the terminator.
+  @param[in] VendorGuid      Variable vendor GUID.
+
+  @return The 32-bit hash.
+
+**/
+UINT32
+EFIAPI
+FlashVariableStoreComputeHash (
+  IN CONST CHAR16    *VariableName,
+  IN UINTN           NameSize,
+  IN CONST EFI_GUID  *VendorGuid
+  )
+{
+  CONST UINT8        *Bytes;
+  UINT32             Hash;
+  UINTN              Index;
+
+  Hash  = 0x811C9DC5;
+  Bytes = (CONST UINT8 *) VariableName;
+  for (Index = 0; Index < NameSize; Index++) {
+    Hash = (Hash ^ Bytes[Index]) * 0x01000193;
+  }
+  Bytes = (CONST UINT8 *) VendorGuid;
+  for (Index = 0; Index < sizeof (EFI_GUID); Index++) {
+    Hash = (Hash ^ Bytes[Index]) * 0x01000193;
+  }
+
+  return Hash;
+}
+
+/**
+  Find the index entry of a variable.
+
+  @param[in] VariableName    Null-terminated variable name.
+  @param[in] NameSize        Size of VariableName in bytes, including the terminator.
+  @param[in] VendorGuid      Variable vendor GUID.
+  @param[in] Hash            Hash of VariableName and VendorGuid.
+
+  @return Index of the entry, or FLASH_VARIABLE_INVALID_INDEX if the variable does not exist.
+
+**/
+STATIC
+UINT16
+FindEntry (
+  IN CONST CHAR16    *VariableName,
+  IN UINTN           NameSize,
+  IN CONST EFI_GUID  *VendorGuid,
+  IN UINT32          Hash
+  )
+{
+  UINT16                Index;
+  FLASH_VARIABLE_ENTRY  *Entry;
+
+  for (Index = mHashBuckets[Hash % FLASH_VARIABLE_HASH_BUCKETS];
+       Index != FLASH_VARIABLE_INVALID_INDEX;
+       Index = mEntries[Index].HashNext) {
+    Entry = &mEntries[Index];
+    if ((Entry->Hash == Hash) &&
+        (Entry->NameSize == NameSize) &&
+        CompareGuid (&Entry->VendorGuid, VendorGuid) &&
+        (CompareMem (Entry->Name, VariableName, NameSize) == 0)) {
+      return Index;
+    }
+  }
+
+  return FLASH_VARIABLE_INVALID_INDEX;
+}
+
+/**
+  Cache the data of a variable in its index entry if it is small.
+
+  @param[in] Entry     The index entry. DataSize must be up to date.
+  @param[in] Data      The variable data, or NULL to drop the cached data.
+
+**/
+STATIC
+VOID
+UpdateEntryData (
+  IN FLASH_VARIABLE_ENTRY  *Entry,
+  IN CONST VOID            *Data  OPTIONAL
+  )
+{
+  if ((Data == NULL) || (Entry->DataSize > FLASH_VARIABLE_CACHED_DATA_SIZE)) {
+    if (Entry->Data != NULL) {
+      FreePool (Entry->Data);
+      Entry->Data = NULL;
+    }
+    return;
+  }
+
+  //
+  // Cached buffers are all FLASH_VARIABLE_CACHED_DATA_SIZE bytes, so they are
+  // reused across updates
+  //
+  if (Entry->Data == NULL) {
+    Entry->Data = AllocatePool (FLASH_VARIABLE_CACHED_DATA_SIZE);
+    if (Entry->Data == NULL) {
+      return;
+    }
+  }
+  CopyMem (Entry->Data, Data, Entry->DataSize);
+}
+
+/**
+  Add an index entry for a record. The entry is placed last in enumeration order.
+
+  @param[in] Log       The log holding the record.
+  @param[in] Offset    Offset of the record in the log.
+  @param[in] Hash      Hash of the record name and vendor GUID.
+  @param[in] Header    Header of the record.
+  @param[in] Name      Name of the record.
+
+  @return Index of the new entry, or FLASH_VARIABLE_INVALID_INDEX if the index is
+          full or memory allocation failed.
+
+**/
+STATIC
+UINT16
+AddEntry (
+  IN FLASH_VARIABLE_LOG           *Log,
+  IN UINT32                       Offset,
+  IN UINT32                       Hash,
+  IN CONST FLASH_VARIABLE_HEADER  *Header,
+  IN CONST CHAR16                 *Name
+  )
+{
+  UINT16                     Index;
+  FLASH_VARIABLE_ENTRY       *Entry;
+  UINT16                     *Bucket;
+
+  Index = mFreeEntry;
+  if (Index == FLASH_VARIABLE_INVALID_INDEX) {
+    return FLASH_VARIABLE_INVALID_INDEX;
+  }
+  Entry = &mEntries[Index];
+  Entry->Name = AllocateCopyPool (Header->NameSize, Name);
+  if (Entry->Name == NULL) {
+    return FLASH_VARIABLE_INVALID_INDEX;
+  }
+  mFreeEntry = Entry->HashNext;
+
+  Entry->Log        = Log;
+  Entry->Offset     = Offset;
+  Entry->Hash       = Hash;
+  Entry->Attributes = Header->Attributes;
+  Entry->NameSize   = Header->NameSize;
+  Entry->DataSize   = Header->DataSize;
+  Entry->Data       = NULL;
+  CopyGuid (&Entry->VendorGuid, &Header->VendorGuid);
+
+  Bucket          = &mHashBuckets[Hash % FLASH_VARIABLE_HASH_BUCKETS];
+  Entry->HashNext = *Bucket;
+  *Bucket         = Index;
+
+  Entry->OrderNext = FLASH_VARIABLE_INVALID_INDEX;
+  Entry->OrderPrev = mOrderTail;
+  if (mOrderTail != FLASH_VARIABLE_INVALID_INDEX) {
+    mEntries[mOrderTail].OrderNext = Index;
+  } else {
+    mOrderHead = Index;
+  }
+  mOrderTail = Index;
+
+  return Index;
+}
+
+/**
+  Remove an index entry and return it to the free list.
+
+  @param[in] Index     Index of the entry to remove.
+
+**/
+STATIC
+VOID
+RemoveEntry (
+  IN UINT16          Index
+  )
+{
+  FLASH_VARIABLE_ENTRY       *Entry;
+  UINT16                     *Link;
+
+  Entry = &mEntries[Index];
+
+  Link = &mHashBuckets[Entry->Hash % FLASH_VARIABLE_HASH_BUCKETS];
+  while (*Link != Index) {
+    ASSERT (*Link != FLASH_VARIABLE_INVALID_INDEX);
+    Link = &mEntries[*Link].HashNext;
+  }
+  *Link = Entry->HashNext;
+
+  if (Entry->OrderPrev != FLASH_VARIABLE_INVALID_INDEX) {
+    mEntries[Entry->OrderPrev].OrderNext = Entry->OrderNext;
+  } else {
+    mOrderHead = Entry->OrderNext;
+  }
+  if (Entry->OrderNext != FLASH_VARIABLE_INVALID_INDEX) {
+    mEntries[Entry->OrderNext].OrderPrev = Entry->OrderPrev;
+  } else {
+    mOrderTail = Entry->OrderPrev;
+  }
+
+  FreePool (Entry->Name);
+  if (Entry->Data != NULL) {
+    FreePool (Entry->Data);
+  }
+  ZeroMem (Entry, sizeof (*Entry));
+  Entry->HashNext = mFreeEntry;
+  mFreeEntry      = Index;
+}
+
+/**
+  Add a committed record found while loading a log to the index. An older copy
+  of the same variable is marked deleted.
+
+  @param[in] Log      The log.
+  @param[in] Offset   Offset of the record in the log.
+  @param[in] Header   Header of the record.
+  @param[in] Name     Name of the record.
+
+**/
+VOID
+StoreLoadRecord (
+  IN FLASH_VARIABLE_LOG           *Log,
+  IN UINT32                       Offset,
+  IN CONST FLASH_VARIABLE_HEADER  *Header,
+  IN CONST CHAR16                 *Name
+  )
+{
+  FLASH_VARIABLE_ENTRY       *Entry;
+  UINT32                     Hash;
+  UINT16                     Index;
+  UINT8                      Data[FLASH_VARIABLE_CACHED_DATA_SIZE];
+
+  Hash  = FlashVariableStoreComputeHash (Name, Header->NameSize, &Header->VendorGuid);
+  Index = FindEntry (Name, Header->NameSize, &Header->VendorGuid, Hash);
+  if (Index != FLASH_VARIABLE_INVALID_INDEX) {
+    //
+    // Power was lost between committing a new copy and deleting the old one
+    //
+    Entry = &mEntries[Index];
+    DEBUG ((DEBUG_INFO, "FlashVariable: dropping stale copy of %s at 0x%x\n", Entry->Name, Entry->Offset));
+    LogDeleteRecord (Entry->Log, Entry->Offset);
+    Entry->Offset     = Offset;
+    Entry->Attributes = Header->Attributes;
+    Entry->DataSize   = Header->DataSize;
+  } else {
+    Index = AddEntry (Log, Offset, Hash, Header, Name);
+    if (Index == FLASH_VARIABLE_INVALID_INDEX) {
+      DEBUG ((DEBUG_ERROR, "FlashVariable: index full, %s is not reachable\n", Name));
+      return;
+    }
+    Entry = &mEntries[Index];
+  }
+
+  if ((Header->DataSize <= FLASH_VARIABLE_CACHED_DATA_SIZE) &&
+      !EFI_ERROR (LogRead (Log, Offset + sizeof (FLASH_VARIABLE_HEADER) + Header->NameSize, Data, Header->DataSize))) {
+    UpdateEntryData (Entry, Data);
+  } else {
+    UpdateEntryData (Entry, NULL);
+  }
+}
+
+/**
+  Point the index entry of a record at its new copy after reclaim moved it.
+
+  @param[in] Log         The log.
+  @param[in] OldOffset   Offset of the old copy.
+  @param[in] NewOffset   Offset of the new copy.
+  @param[in] Record      The record, header included.
+
+**/
+VOID
+StoreRelocateRecord (
+  IN FLASH_VARIABLE_LOG           *Log,
+  IN UINT32                       OldOffset,
+  IN UINT32                       NewOffset,
+  IN CONST FLASH_VARIABLE_HEADER  *Record
+  )
+{
+  CONST CHAR16               *Name;
+  UINT16                     Index;
+
+  Name  = (CONST CHAR16 *) (Record + 1);
+  Index = FindEntry (
+            Name,
+            Record->NameSize,
+            &Record->VendorGuid,
+            FlashVariableStoreComputeHash (Name, Record->NameSize, &Record->VendorGuid)
+            );
+  if ((Index == FLASH_VARIABLE_INVALID_INDEX) || (mEntries[Index].Offset != OldOffset)) {
+    ASSERT (FALSE);
+    return;
+  }
+  mEntries[Index].Offset = NewOffset;
+}
+
+/**
+  Return the time between two performance counter values in nanoseconds.
+
+  @param[in] StartTicks   Counter value at the start.
+  @param[in] EndTicks     Counter value at the end.
+
+  @return Elapsed time in nanoseconds.
+
+**/
+STATIC
+UINT64
+GetElapsedTime (
+  IN UINT64          StartTicks,
+  IN UINT64          EndTicks
+  )
+{
+  //
+  // Handle a counter that counts down or wraps
+  //
+  if (mPerformanceCounterEnd > mPerformanceCounterStart) {
+    if (EndTicks < StartTicks) {
+      EndTicks += mPerformanceCounterEnd - mPerformanceCounterStart;
+    }
+    return GetTimeInNanoSecond (EndTicks - StartTicks);
+  }
+  if (StartTicks < EndTicks) {
+    StartTicks += mPerformanceCounterStart - mPerformanceCounterEnd;
+  }
+  return GetTimeInNanoSecond (StartTicks - EndTicks);
+}
+
+/**
+  Initialize the variable store.
+
+  The non-volatile log is loaded from the device, or the region is formatted if it
+  holds no log. Records left incomplete by a power loss are discarded.
+
+  @param[in] Device     The flash device of the non-volatile store.
+
+  @retval EFI_SUCCESS           The store is ready.
+  @retval EFI_INVALID_PARAMETER The device geometry cannot hold a store.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreInitialize (
+  IN FLASH_VARIABLE_DEVICE   *Device
+  )
+{
+  EFI_STATUS                 Status;
+  UINT16                     Index;
+  UINT32                     ScratchSize;
+
+  if (mStoreReady) {
+    return EFI_SUCCESS;
+  }
+
+  //
+  // A platform may retry with another device after a failed attempt, so
+  // buffers are reused and anything a partial load indexed is dropped
+  //
+  if (mEntries == NULL) {
+    mEntries        = AllocateZeroPool (FLASH_VARIABLE_MAX_COUNT * sizeof (FLASH_VARIABLE_ENTRY));
+    mHashBuckets    = AllocatePool (FLASH_VARIABLE_HASH_BUCKETS * sizeof (UINT16));
+    mVolatileBuffer = AllocatePool (FLASH_VARIABLE_VOLATILE_SIZE);
+  }
+  if ((mEntries == NULL) || (mHashBuckets == NULL) || (mVolatileBuffer == NULL)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+  SetMem (mHashBuckets, FLASH_VARIABLE_HASH_BUCKETS * sizeof (UINT16), 0xFF);
+  for (Index = 0; Index < FLASH_VARIABLE_MAX_COUNT; Index++) {
+    if (mEntries[Index].Name != NULL) {
+      FreePool (mEntries[Index].Name);
+    }
+    if (mEntries[Index].Data != NULL) {
+      FreePool (mEntries[Index].Data);
+    }
+    ZeroMem (&mEntries[Index], sizeof (FLASH_VARIABLE_ENTRY));
+    mEntries[Index].HashNext = (UINT16) (Index + 1);
+  }
+  mEntries[FLASH_VARIABLE_MAX_COUNT - 1].HashNext = FLASH_VARIABLE_INVALID_INDEX;
+  mFreeEntry = 0;
+  mOrderHead = FLASH_VARIABLE_INVALID_INDEX;
+  mOrderTail = FLASH_VARIABLE_INVALID_INDEX;
+
+  SetMem (mVolatileBuffer, FLASH_VARIABLE_VOLATILE_SIZE, 0xFF);
+  mVolatileDevice.Size      = FLASH_VARIABLE_VOLATILE_SIZE;
+  mVolatileDevice.BlockSize = FLASH_VARIABLE_VOLATILE_BLOCK_SIZE;
+  mVolatileDevice.Read      = VolatileDeviceRead;
+  mVolatileDevice.Write     = VolatileDeviceWrite;
+  mVolatileDevice.Erase     = VolatileDeviceErase;
+  if (mVolatileLog.Banks != NULL) {
+    FreePool (mVolatileLog.Banks);
+  }
+  Status = LogInitialize (&mVolatileLog, &mVolatileDevice, FALSE);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  if (mNvLog.Banks != NULL) {
+    FreePool (mNvLog.Banks);
+  }
+  Status = LogInitialize (&mNvLog, Device, TRUE);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  ScratchSize = MAX (mNvLog.BankSize, mVolatileLog.BankSize);
+  if (mFlashVariableScratch != NULL) {
+    FreePool (mFlashVariableScratch);
+  }
+  mFlashVariableScratch = AllocatePool (ScratchSize);
+  if (mFlashVariableScratch == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Status = LogLoad (&mNvLog);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  GetPerformanceCounterProperties (&mPerformanceCounterStart, &mPerformanceCounterEnd);
+
+  //
+  // Only count the traffic caused by variable services
+  //
+  ZeroMem (&mFlashVariableStatistics, sizeof (mFlashVariableStatistics));
+  mStoreReady = TRUE;
+
+  DEBUG ((DEBUG_INFO, "FlashVariable: 0x%x of 0x%x bytes in use\n", mNvLog.TotalLive, LogCapacity (&mNvLog)));
+  return EFI_SUCCESS;
+}
+
+/**
+  Get a variable's content.
+
+  @param[in]      VariableName    Name of Variable to be found.
+  @param[in]      VendorGuid      Variable vendor GUID.
+  @param[out]     Attributes      Attribute value of the variable found.
+  @param[in, out] DataSize        Size of Data found. If size is less than the
+                                  data, this value contains the required size.
+  @param[out]     Data            Data pointer.
+
+  @return         EFI_INVALID_PARAMETER      Invalid parameter.
+  @return         EFI_SUCCESS                Find the specified variable.
+  @return         EFI_NOT_FOUND              Not found.
+  @return         EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreGetVariable (
+  IN      CHAR16            *VariableName,
+  IN      EFI_GUID          *VendorGuid,
+  OUT     UINT32            *Attributes OPTIONAL,
+  IN OUT  UINTN             *DataSize,
+  OUT     VOID              *Data
+  )
+{
+  EFI_STATUS                Status;
+  FLASH_VARIABLE_ENTRY      *Entry;
+  UINTN                     NameSize;
+  UINT16                    Index;
+  UINT64                    StartTicks;
+
+  if (!mStoreReady) {
+    return EFI_NOT_READY;
+  }
+  if ((VariableName == NULL) || (VendorGuid == NULL) || (DataSize == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (VariableName[0] == 0) {
+    return EFI_NOT_FOUND;
+  }
+
+  StartTicks = GetPerformanceCounter ();
+  NameSize   = StrSize (VariableName);
+  Index      = FindEntry (VariableName, NameSize, VendorGuid, FlashVariableStoreComputeHash (VariableName, NameSize, VendorGuid));
+  Entry      = (Index != FLASH_VARIABLE_INVALID_INDEX) ? &mEntries[Index] : NULL;
+  if ((Entry == NULL) ||
+      (mStoreAtRuntime && ((Entry->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0))) {
+    Status = EFI_NOT_FOUND;
+  } else if (*DataSize < Entry->DataSize) {
+    *DataSize = Entry->DataSize;
+    Status    = EFI_BUFFER_TOO_SMALL;
+  } else if (Data == NULL) {
+    Status = EFI_INVALID_PARAMETER;
+  } else {
+    if (Entry->Data != NULL) {
+      CopyMem (Data, Entry->Data, Entry->DataSize);
+      Status = EFI_SUCCESS;
+    } else {
+      Status = LogRead (Entry->Log, Entry->Offset + sizeof (FLASH_VARIABLE_HEADER) + Entry->NameSize, Data, Entry->DataSize);
+    }
+    if (!EFI_ERROR (Status)) {
+      *DataSize = Entry->DataSize;
+      if (Attributes != NULL) {
+        *Attributes = Entry->Attributes;
+      }
+    }
+  }
+
+  mFlashVariableStatistics.ReadCount++;
+  mFlashVariableStatistics.ReadTime += GetElapsedTime (StartTicks, GetPerformanceCounter ());
+  return Status;
+}
+
+/**
+  Set a variable's content.
+
+  @param[in] VariableName         Name of Variable to be found.
+  @param[in] VendorGuid           Variable vendor GUID.
+  @param[in] Attributes           Attribute value of the variable.
+  @param[in] DataSize             Size of Data.
+  @param[in] Data                 Data pointer.
+
+  @return    EFI_INVALID_PARAMETER            Invalid parameter.
+  @return    EFI_SUCCESS                      Set successfully.
+  @return    EFI_OUT_OF_RESOURCES             Resource not enough to set variable.
+  @return    EFI_NOT_FOUND                    Not found.
+  @return    EFI_DEVICE_ERROR                 The flash reported an error.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreSetVariable (
+  IN CHAR16                  *VariableName,
+  IN EFI_GUID                *VendorGuid,
+  IN UINT32                  Attributes,
+  IN UINTN                   DataSize,
+  IN VOID                    *Data
+  )
+{
+  EFI_STATUS                 Status;
+  FLASH_VARIABLE_LOG         *Log;
+  FLASH_VARIABLE_ENTRY       *Entry;
+  FLASH_VARIABLE_HEADER      *Record;
+  UINT8                      *RecordData;
+  BOOLEAN                    Append;
+  UINT32                     StoredAttributes;
+  UINTN                      NameSize;
+  UINT32                     Hash;
+  UINT16                     Index;
+  UINTN                      OldDataSize;
+  UINTN                      RecordSize;
+  UINT32                     Offset;
+
+  if (!mStoreReady) {
+    return EFI_NOT_READY;
+  }
+  if ((VariableName == NULL) || (VariableName[0] == 0) || (VendorGuid == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((DataSize != 0) && (Data == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((Attributes & FLASH_VARIABLE_AUTHENTICATED) != 0) {
+    return EFI_UNSUPPORTED;
+  }
+  if ((Attributes & ~FLASH_VARIABLE_ATTRIBUTES_MASK) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((Attributes & (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_BOOTSERVICE_ACCESS)) == EFI_VARIABLE_RUNTIME_ACCESS) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Append           = (BOOLEAN) ((Attributes & EFI_VARIABLE_APPEND_WRITE) != 0);
+  StoredAttributes = Attributes & ~EFI_VARIABLE_APPEND_WRITE;
+
+  //
+  // Only non-volatile runtime variables may be changed after ExitBootServices
+  //
+  if (mStoreAtRuntime && (StoredAttributes != 0) &&
+      ((StoredAttributes & (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_NON_VOLATILE)) !=
+       (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_NON_VOLATILE))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Log      = ((StoredAttributes & EFI_VARIABLE_NON_VOLATILE) != 0) ? &mNvLog : &mVolatileLog;
+  NameSize = StrSize (VariableName);
+  if ((DataSize > LogMaxRecordSize (Log)) ||
+      (FLASH_VARIABLE_RECORD_SIZE (NameSize, DataSize) > LogMaxRecordSize (Log))) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Hash  = FlashVariableStoreComputeHash (VariableName, NameSize, VendorGuid);
+  Index = FindEntry (VariableName, NameSize, VendorGuid, Hash);
+  Entry = NULL;
+  if (Index != FLASH_VARIABLE_INVALID_INDEX) {
+    Entry = &mEntries[Index];
+    if (mStoreAtRuntime &&
+        ((Entry->Attributes & (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_NON_VOLATILE)) !=
+         (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_NON_VOLATILE))) {
+      return ((Entry->Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0) ? EFI_NOT_FOUND : EFI_INVALID_PARAMETER;
+    }
+  }
+
+  //
+  // Delete the variable
+  //
+  if ((StoredAttributes == 0) || ((DataSize == 0) && !Append)) {
+    if (Entry == NULL) {
+      return EFI_NOT_FOUND;
+    }
+    Status = LogDeleteRecord (Entry->Log, Entry->Offset);
+    RemoveEntry (Index);
+    return Status;
+  }
+
+  OldDataSize = 0;
+  if (Entry != NULL) {
+    if (Entry->Attributes != StoredAttributes) {
+      return EFI_INVALID_PARAMETER;
+    }
+    if (Append) {
+      if (DataSize == 0) {
+        return EFI_SUCCESS;
+      }
+      OldDataSize = Entry->DataSize;
+    } else if (Entry->DataSize == DataSize) {
+      //
+      // Nothing changes, save the flash write
+      //
+      if (Entry->Data != NULL) {
+        if (CompareMem (Entry->Data, Data, DataSize) == 0) {
+          return EFI_SUCCESS;
+        }
+      } else {
+        Status = LogRead (Log, Entry->Offset + sizeof (FLASH_VARIABLE_HEADER) + Entry->NameSize, mFlashVariableScratch, (UINT32) DataSize);
+        if (!EFI_ERROR (Status) && (CompareMem (mFlashVariableScratch, Data, DataSize) == 0)) {
+          return EFI_SUCCESS;
+        }
+      }
+    }
+  } else if (mFreeEntry == FLASH_VARIABLE_INVALID_INDEX) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  RecordSize = FLASH_VARIABLE_RECORD_SIZE (NameSize, OldDataSize + DataSize);
+  if (RecordSize > LogMaxRecordSize (Log)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (Log->TotalLive + RecordSize > LogCapacity (Log) + ((Entry != NULL) ? FLASH_VARIABLE_RECORD_SIZE (NameSize, OldDataSize) : 0)) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  //
+  // Reclaim may move the old record, so the record is built afterwards
+  //
+  Status = LogEnsureSpace (Log, (UINT32) RecordSize);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Record = (FLASH_VARIABLE_HEADER *) mFlashVariableScratch;
+  SetMem (Record, RecordSize, 0xFF);
+  Record->StartId    = FLASH_VARIABLE_START_ID;
+  Record->Checksum   = 0;
+  Record->Attributes = StoredAttributes;
+  Record->NameSize   = (UINT32) NameSize;
+  Record->DataSize   = (UINT32) (OldDataSize + DataSize);
+  CopyGuid (&Record->VendorGuid, VendorGuid);
+  Record->State      = 0;
+  Record->Checksum   = CalculateCheckSum8 ((UINT8 *) Record, sizeof (*Record));
+  CopyMem (Record + 1, VariableName, NameSize);
+  RecordData = (UINT8 *) (Record + 1) + NameSize;
+  if (OldDataSize != 0) {
+    if (Entry->Data != NULL) {
+      CopyMem (RecordData, Entry->Data, OldDataSize);
+    } else {
+      Status = LogRead (Log, Entry->Offset + sizeof (FLASH_VARIABLE_HEADER) + Entry->NameSize, RecordData, (UINT32) OldDataSize);
+      if (EFI_ERROR (Status)) {
+        return Status;
+      }
+    }
+  }
+  CopyMem (RecordData + OldDataSize, Data, DataSize);
+
+  Status = LogWriteRecord (Log, Record, (UINT32) RecordSize, FALSE, &Offset);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+  if (Log->NonVolatile) {
+    mFlashVariableStatistics.BytesRequested += RecordSize;
+  }
+
+  if (Entry != NULL) {
+    Status = LogDeleteRecord (Log, Entry->Offset);
+    Entry->Offset   = Offset;
+    Entry->DataSize = Record->DataSize;
+  } else {
+    Index = AddEntry (Log, Offset, Hash, Record, VariableName);
+    if (Index == FLASH_VARIABLE_INVALID_INDEX) {
+      LogDeleteRecord (Log, Offset);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    Entry = &mEntries[Index];
+  }
+  UpdateEntryData (Entry, RecordData);
+
+  //
+  // Spread reclaim over the writes instead of stalling one of them later
+  //
+  if (!EFI_ERROR (Status) && (Log->FreeBanks < FLASH_VARIABLE_FREE_WATERMARK)) {
+    LogReclaimStep (Log, TRUE);
+  }
+
+  return Status;
+}
+
+/**
+  Find the next variable.
+
+  @param[in, out] VariableNameSize           Size of the variable name.
+  @param[in, out] VariableName               Pointer to variable name.
+  @param[in, out] VendorGuid                 Variable Vendor Guid.
+
+  @return         EFI_INVALID_PARAMETER      Invalid parameter.
+  @return         EFI_SUCCESS                Find the specified variable.
+  @return         EFI_NOT_FOUND              Not found.
+  @return         EFI_BUFFER_TO_SMALL        DataSize is too small for the result.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreGetNextVariableName (
+  IN OUT  UINTN             *VariableNameSize,
+  IN OUT  CHAR16            *VariableName,
+  IN OUT  EFI_GUID          *VendorGuid
+  )
+{
+  UINTN                     NameSize;
+  UINT16                    Index;
+  FLASH_VARIABLE_ENTRY      *Entry;
+
+  if (!mStoreReady) {
+    return EFI_NOT_READY;
+  }
+  if ((VariableNameSize == NULL) || (VariableName == NULL) || (VendorGuid == NULL)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  if (VariableName[0] == 0) {
+    Index = mOrderHead;
+  } else {
+    NameSize = StrSize (VariableName);
+    Index    = FindEntry (VariableName, NameSize, VendorGuid, FlashVariableStoreComputeHash (VariableName, NameSize, VendorGuid));
+    if (Index == FLASH_VARIABLE_INVALID_INDEX) {
+      return EFI_INVALID_PARAMETER;
+    }
+    Index = mEntries[Index].OrderNext;
+  }
+
+  while ((Index != FLASH_VARIABLE_INVALID_INDEX) && mStoreAtRuntime &&
+         ((mEntries[Index].Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0)) {
+    Index = mEntries[Index].OrderNext;
+  }
+  if (Index == FLASH_VARIABLE_INVALID_INDEX) {
+    return EFI_NOT_FOUND;
+  }
+
+  Entry = &mEntries[Index];
+  if (*VariableNameSize < Entry->NameSize) {
+    *VariableNameSize = Entry->NameSize;
+    return EFI_BUFFER_TOO_SMALL;
+  }
+
+  CopyMem (VariableName, Entry->Name, Entry->NameSize);
+  CopyGuid (VendorGuid, &Entry->VendorGuid);
+  *VariableNameSize = Entry->NameSize;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Return information about the variable store.
+
+  @param[in]  Attributes                    Attributes bitmask to specify the type of variables
+                                            on which to return information.
+  @param[out] MaximumVariableStorageSize    Maximum size of the storage space.
+  @param[out] RemainingVariableStorageSize  Remaining size of the storage space.
+  @param[out] MaximumVariableSize           Maximum size of an individual variable.
+
+  @return     EFI_INVALID_PARAMETER         An invalid combination of attribute bits was supplied.
+  @return     EFI_SUCCESS                   Query successfully.
+  @return     EFI_UNSUPPORTED               The attribute is not supported on this platform.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreQueryVariableInfo (
+  IN  UINT32                 Attributes,
+  OUT UINT64                 *MaximumVariableStorageSize,
+  OUT UINT64                 *RemainingVariableStorageSize,
+  OUT UINT64                 *MaximumVariableSize
+  )
+{
+  FLASH_VARIABLE_LOG         *Log;
+  UINT64                     Remaining;
+  UINT64                     MaxSize;
+
+  if (!mStoreReady) {
+    return EFI_NOT_READY;
+  }
+  if ((MaximumVariableStorageSize == NULL) || (RemainingVariableStorageSize == NULL) ||
+      (MaximumVariableSize == NULL) || (Attributes == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((Attributes & FLASH_VARIABLE_AUTHENTICATED) != 0) {
+    return EFI_UNSUPPORTED;
+  }
+  if ((Attributes & ~FLASH_VARIABLE_ATTRIBUTES_MASK) != 0) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if ((Attributes & (EFI_VARIABLE_RUNTIME_ACCESS | EFI_VARIABLE_BOOTSERVICE_ACCESS)) == EFI_VARIABLE_RUNTIME_ACCESS) {
+    return EFI_INVALID_PARAMETER;
+  }
+  if (mStoreAtRuntime && ((Attributes & EFI_VARIABLE_RUNTIME_ACCESS) == 0)) {
+    return EFI_INVALID_PARAMETER;
+  }
+
+  Log       = ((Attributes & EFI_VARIABLE_NON_VOLATILE) != 0) ? &mNvLog : &mVolatileLog;
+  Remaining = (Log->TotalLive < LogCapacity (Log)) ? LogCapacity (Log) - Log->TotalLive : 0;
+  MaxSize   = LogMaxRecordSize (Log) - sizeof (FLASH_VARIABLE_HEADER);
+  if (Remaining < sizeof (FLASH_VARIABLE_HEADER)) {
+    MaxSize = 0;
+  } else if (Remaining - sizeof (FLASH_VARIABLE_HEADER) < MaxSize) {
+    MaxSize = Remaining - sizeof (FLASH_VARIABLE_HEADER);
+  }
+
+  *MaximumVariableStorageSize   = LogCapacity (Log);
+  *RemainingVariableStorageSize = Remaining;
+  *MaximumVariableSize          = MaxSize;
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Get the size of the record header of a variable.
+
+  @return Size of variable header in bytes.
+
+**/
+UINTN
+EFIAPI
+FlashVariableStoreGetHeaderSize (
+  VOID
+  )
+{
+  return sizeof (FLASH_VARIABLE_HEADER);
+}
+
+/**
+  Get the maximum size of a non-volatile variable, including its record header.
+
+  @return Non-volatile maximum variable size.
+
+**/
+UINTN
+EFIAPI
+FlashVariableStoreGetMaxVariableSize (
+  VOID
+  )
+{
+  if (!mStoreReady) {
+    return FLASH_VARIABLE_BANK_SIZE - sizeof (FLASH_VARIABLE_BANK_HEADER);
+  }
+  return LogMaxRecordSize (&mNvLog);
+}
+
+/**
+  Run reclaim steps until enough free banks are available again.
+
+  Each step copies a bounded amount of live data, so callers can spread reclaim
+  over several calls by passing a small step count.
+
+  @param[in] MaxSteps   Maximum number of steps to run, or 0 for no limit.
+
+  @retval EFI_SUCCESS        Enough banks are free, or the step budget is used up.
+  @retval EFI_DEVICE_ERROR   The flash reported an error.
+
+**/
+EFI_STATUS
+EFIAPI
+FlashVariableStoreReclaim (
+  IN UINTN                   MaxSteps
+  )
+{
+  EFI_STATUS                 Status;
+  UINTN                      Steps;
+
+  if (!mStoreReady) {
+    return EFI_NOT_READY;
+  }
+
+  for (Steps = 0; (MaxSteps == 0) || (Steps < MaxSteps); Steps++) {
+    if ((mNvLog.FreeBanks >= FLASH_VARIABLE_FREE_WATERMARK) &&
+        (mNvLog.ReclaimBank == FLASH_VARIABLE_INVALID_BANK)) {
+      break;
+    }
+    Status = LogReclaimStep (&mNvLog, TRUE);
+    if (Status == EFI_NOT_FOUND) {
+      break;
+    }
+    if (EFI_ERROR (Status)) {
+      return Status;
+    }
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Restrict the store to runtime access rules after ExitBootServices.
+
+**/
+VOID
+EFIAPI
+FlashVariableStoreExitBootServices (
+  VOID
+  )
+{
+  mStoreAtRuntime = TRUE;
+}
+
+/**
+  Return the write amplification, wear and latency statistics of the store.
+
+  @param[out] Statistics   Receives the statistics.
+
+**/
+VOID
+EFIAPI
+FlashVariableStoreGetStatistics (
+  OUT FLASH_VARIABLE_STORE_STATISTICS  *Statistics
+  )
+{
+  UINT32                               Bank;
+
+  CopyMem (Statistics, &mFlashVariableStatistics, sizeof (*Statistics));
+  if (!mStoreReady) {
+    return;
+  }
+
+  Statistics->MinEraseCount = MAX_UINT32;
+  Statistics->MaxEraseCount = 0;
+  for (Bank = 0; Bank < mNvLog.BankCount; Bank++) {
+    Statistics->MinEraseCount = MIN (Statistics->MinEraseCount, mNvLog.Banks[Bank].EraseCount);
+    Statistics->MaxEraseCount = MAX (Statistics->MaxEraseCount, mNvLog.Banks[Bank].EraseCount);
+  }
+  Statistics->FreeBanks = mNvLog.FreeBanks;
+  Statistics->BankCount = mNvLog.BankCount;
+}
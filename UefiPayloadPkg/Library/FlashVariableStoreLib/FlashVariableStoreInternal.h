@@ -0,0 +1,341 @@
+/** @file
+  Internal definitions of the log-structured flash variable store.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __FLASH_VARIABLE_STORE_INTERNAL_H__
+#define __FLASH_VARIABLE_STORE_INTERNAL_H__
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/TimerLib.h>
+#include <Library/FlashVariableStoreLib.h>
+
+//
+// Geometry. The bank size is reduced for small regions so that there are at
+// least FLASH_VARIABLE_PREFERRED_BANKS banks.
+//
+#define FLASH_VARIABLE_BANK_SIZE            0x10000
+#define FLASH_VARIABLE_PREFERRED_BANKS      4
+#define FLASH_VARIABLE_MIN_BANKS            3
+#define FLASH_VARIABLE_VOLATILE_SIZE        0x40000
+#define FLASH_VARIABLE_VOLATILE_BLOCK_SIZE  0x1000
+
+//
+// Reclaim policy. One free bank is kept for reclaim to copy live records into.
+// Background reclaim runs while fewer than FLASH_VARIABLE_FREE_WATERMARK banks
+// are free, and only picks banks that are at least half reclaimable so that it
+// does not add much write amplification. A bank that falls behind the most worn
+// bank by more than FLASH_VARIABLE_WEAR_THRESHOLD erases is moved in the
+// background even if it holds only live data.
+//
+#define FLASH_VARIABLE_RESERVED_BANKS       1
+#define FLASH_VARIABLE_FREE_WATERMARK       2
+#define FLASH_VARIABLE_RECLAIM_STEP_SIZE    0x1000
+#define FLASH_VARIABLE_WEAR_THRESHOLD       64
+
+//
+// Index
+//
+#define FLASH_VARIABLE_MAX_COUNT            1024
+#define FLASH_VARIABLE_HASH_BUCKETS         256
+#define FLASH_VARIABLE_CACHED_DATA_SIZE     0x100
+#define FLASH_VARIABLE_INVALID_INDEX        0xFFFF
+#define FLASH_VARIABLE_INVALID_BANK         0xFFFFFFFF
+
+//
+// On-flash bank header. A bank is prepared as FREE right after it is erased.
+// Activation programs Sequence first and State last.
+//
+#define FLASH_VARIABLE_BANK_SIGNATURE       SIGNATURE_32 ('F', 'V', 'B', 'K')
+#define FLASH_VARIABLE_BANK_ERASED          0xFF
+#define FLASH_VARIABLE_BANK_FREE            0xFE
+#define FLASH_VARIABLE_BANK_IN_USE          0xFC
+#define FLASH_VARIABLE_BANK_DIRTY           0x00    // RAM only, bank needs an erase
+
+typedef struct {
+  UINT32    Signature;
+  UINT8     State;
+  UINT8     Reserved[3];
+  UINT32    Sequence;
+  UINT32    EraseCount;
+  UINT32    BankSize;
+  UINT32    Reserved2[3];
+} FLASH_VARIABLE_BANK_HEADER;
+
+//
+// On-flash record header. The header is programmed with HEADER_VALID, then the
+// name and data, then the state is changed to ADDED. Each change only clears bits.
+//
+#define FLASH_VARIABLE_START_ID             0x55AA
+#define FLASH_VARIABLE_HEADER_VALID         0x7F
+#define FLASH_VARIABLE_ADDED                0x3F
+#define FLASH_VARIABLE_DELETED              0x3D
+
+typedef struct {
+  UINT16    StartId;
+  UINT8     State;
+  UINT8     Checksum;       ///< Makes the byte sum of the header, State excluded, zero
+  UINT32    Attributes;
+  UINT32    NameSize;
+  UINT32    DataSize;
+  EFI_GUID  VendorGuid;
+} FLASH_VARIABLE_HEADER;
+
+#define FLASH_VARIABLE_RECORD_SIZE(NameSize, DataSize) \
+  ALIGN_VALUE (sizeof (FLASH_VARIABLE_HEADER) + (NameSize) + (DataSize), sizeof (UINT32))
+
+//
+// RAM state of one bank
+//
+typedef struct {
+  UINT8     State;
+  BOOLEAN   Closed;         ///< No more records are appended to this bank
+  UINT32    Sequence;
+  UINT32    EraseCount;
+  UINT32    End;            ///< Bank relative offset of the first unused byte
+  UINT32    Live;           ///< Bytes of live records
+} FLASH_VARIABLE_BANK;
+
+typedef struct {
+  FLASH_VARIABLE_DEVICE  *Device;
+  BOOLEAN                NonVolatile;
+  UINT32                 BankSize;
+  UINT32                 BankCount;
+  FLASH_VARIABLE_BANK    *Banks;
+  UINT32                 ActiveBank;
+  UINT32                 Sequence;
+  UINT32                 FreeBanks;
+  UINT32                 TotalLive;
+  UINT32                 ReclaimBank;      ///< Bank being reclaimed, or FLASH_VARIABLE_INVALID_BANK
+  UINT32                 ReclaimOffset;    ///< Bank relative offset of the next record to move
+} FLASH_VARIABLE_LOG;
+
+//
+// Index entry of a variable. The name, and the data of small variables, are
+// cached so that lookups do not touch the flash part.
+//
+typedef struct {
+  FLASH_VARIABLE_LOG     *Log;
+  UINT32                 Offset;
+  UINT32                 Hash;
+  UINT32                 Attributes;
+  UINT32                 NameSize;
+  UINT32                 DataSize;
+  EFI_GUID               VendorGuid;
+  CHAR16                 *Name;
+  UINT8                  *Data;           ///< Cached data, or NULL
+  UINT16                 HashNext;
+  UINT16                 OrderNext;
+  UINT16                 OrderPrev;
+} FLASH_VARIABLE_ENTRY;
+
+extern UINT8                             *mFlashVariableScratch;
+extern FLASH_VARIABLE_STORE_STATISTICS   mFlashVariableStatistics;
+
+/**
+  Set up a log over a device and bring its banks to a known state.
+
+  Banks that hold neither a valid FREE nor a valid IN_USE header are erased.
+
+  @param[in] Log           The log.
+  @param[in] Device        The device backing the log.
+  @param[in] NonVolatile   TRUE if the log holds non-volatile variables.
+
+  @retval EFI_SUCCESS           The log is set up.
+  @retval EFI_INVALID_PARAMETER The device geometry cannot hold a log.
+  @retval EFI_OUT_OF_RESOURCES  Memory allocation failed.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+LogInitialize (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN FLASH_VARIABLE_DEVICE  *Device,
+  IN BOOLEAN                NonVolatile
+  );
+
+/**
+  Scan the records of all banks in sequence order and report the committed
+  ones with StoreLoadRecord().
+
+  @param[in] Log      The log.
+
+  @retval EFI_SUCCESS        The log is loaded.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogLoad (
+  IN FLASH_VARIABLE_LOG     *Log
+  );
+
+/**
+  Read from a log.
+
+  @param[in]  Log      The log.
+  @param[in]  Offset   Offset in the log.
+  @param[out] Buffer   Buffer receiving the data.
+  @param[in]  Size     Number of bytes to read.
+
+  @retval EFI_SUCCESS        The data was read.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogRead (
+  IN  FLASH_VARIABLE_LOG    *Log,
+  IN  UINT32                Offset,
+  OUT VOID                  *Buffer,
+  IN  UINT32                Size
+  );
+
+/**
+  Append a record to the active bank, activating a free bank if needed.
+
+  @param[in]  Log          The log.
+  @param[in]  Record       The record, header included. Its State is updated.
+  @param[in]  Size         Size of the record.
+  @param[in]  UseReserve   TRUE if the reserved bank may be activated.
+  @param[out] Offset       Offset of the record in the log.
+
+  @retval EFI_SUCCESS           The record is committed.
+  @retval EFI_OUT_OF_RESOURCES  No bank can take the record.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+LogWriteRecord (
+  IN  FLASH_VARIABLE_LOG    *Log,
+  IN  FLASH_VARIABLE_HEADER *Record,
+  IN  UINT32                Size,
+  IN  BOOLEAN               UseReserve,
+  OUT UINT32                *Offset
+  );
+
+/**
+  Mark a record deleted.
+
+  @param[in] Log      The log.
+  @param[in] Offset   Offset of the record in the log.
+
+  @retval EFI_SUCCESS        The record is deleted.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogDeleteRecord (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Offset
+  );
+
+/**
+  Make sure a record of the given size can be appended without using the
+  reserved bank, reclaiming banks as needed.
+
+  @param[in] Log      The log.
+  @param[in] Size     Size of the record.
+
+  @retval EFI_SUCCESS           The record can be appended.
+  @retval EFI_OUT_OF_RESOURCES  Reclaim cannot free enough space.
+  @retval EFI_DEVICE_ERROR      The device reported an error.
+
+**/
+EFI_STATUS
+LogEnsureSpace (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN UINT32                 Size
+  );
+
+/**
+  Run one bounded reclaim step.
+
+  @param[in] Log          The log.
+  @param[in] Background   TRUE to only pick banks worth reclaiming now, or banks
+                          that lag behind in wear.
+
+  @retval EFI_SUCCESS        A step was run.
+  @retval EFI_NOT_FOUND      No bank needs reclaim.
+  @retval EFI_DEVICE_ERROR   The device reported an error.
+
+**/
+EFI_STATUS
+LogReclaimStep (
+  IN FLASH_VARIABLE_LOG     *Log,
+  IN BOOLEAN                Background
+  );
+
+/**
+  Return the largest record the log can hold.
+
+  @param[in] Log      The log.
+
+  @return Maximum record size in bytes.
+
+**/
+UINT32
+LogMaxRecordSize (
+  IN FLASH_VARIABLE_LOG     *Log
+  );
+
+/**
+  Return the space available to records, the reserved bank excluded.
+
+  @param[in] Log      The log.
+
+  @return Capacity in bytes.
+
+**/
+UINT32
+LogCapacity (
+  IN FLASH_VARIABLE_LOG     *Log
+  );
+
+/**
+  Add a committed record found while loading a log to the index. An older copy
+  of the same variable is marked deleted.
+
+  @param[in] Log      The log.
+  @param[in] Offset   Offset of the record in the log.
+  @param[in] Header   Header of the record.
+  @param[in] Name     Name of the record.
+
+**/
+VOID
+StoreLoadRecord (
+  IN FLASH_VARIABLE_LOG           *Log,
+  IN UINT32                       Offset,
+  IN CONST FLASH_VARIABLE_HEADER  *Header,
+  IN CONST CHAR16                 *Name
+  );
+
+/**
+  Point the index entry of a record at its new copy after reclaim moved it.
+
+  @param[in] Log         The log.
+  @param[in] OldOffset   Offset of the old copy.
+  @param[in] NewOffset   Offset of the new copy.
+  @param[in] Record      The record, header included.
+
+**/
+VOID
+StoreRelocateRecord (
+  IN FLASH_VARIABLE_LOG           *Log,
+  IN UINT32                       OldOffset,
+  IN UINT32                       NewOffset,
+  IN CONST FLASH_VARIABLE_HEADER  *Record
+  );
+
+#endif
@@ -0,0 +1,538 @@
+/** @file
+  HashLib instance that hashes every active PCR bank in one pass over the data,
+  using the SHA extensions when the processor has them.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "HashLibShaNiInternal.h"
+
+//
+// HashUpdate feeds every bank one chunk at a time, so each chunk is still in
+// the cache when the next bank reads it.
+//
+#define HASH_SHA_NI_CHUNK_SIZE    SIZE_8KB
+
+#define HASH_SHA_NI_BLOCK_SIZE    64
+#define HASH_SHA_NI_BANK_COUNT    2
+
+typedef
+VOID
+(EFIAPI *SHA_NI_BLOCKS) (
+  IN OUT UINT32             *State,
+  IN     CONST UINT8        *Data,
+  IN     UINTN              BlockCount
+  );
+
+typedef
+UINTN
+(EFIAPI *CRYPT_GET_CONTEXT_SIZE) (
+  VOID
+  );
+
+typedef
+BOOLEAN
+(EFIAPI *CRYPT_INIT) (
+  OUT VOID                  *Context
+  );
+
+typedef
+BOOLEAN
+(EFIAPI *CRYPT_UPDATE) (
+  IN OUT VOID               *Context,
+  IN     CONST VOID         *Data,
+  IN     UINTN              DataSize
+  );
+
+typedef
+BOOLEAN
+(EFIAPI *CRYPT_FINAL) (
+  IN OUT VOID               *Context,
+  OUT    UINT8              *HashValue
+  );
+
+typedef struct {
+  UINT32                    HashMask;
+  TPMI_ALG_HASH             AlgoId;
+  UINTN                     DigestSize;
+  UINTN                     StateWords;
+  CONST UINT32              *InitialState;
+  SHA_NI_BLOCKS             Blocks;
+  CRYPT_GET_CONTEXT_SIZE    GetContextSize;
+  CRYPT_INIT                Init;
+  CRYPT_UPDATE              Update;
+  CRYPT_FINAL               Final;
+} HASH_SHA_NI_BANK;
+
+typedef struct {
+  UINT32                    State[8];
+  UINT64                    Length;
+  UINT8                     Buffer[HASH_SHA_NI_BLOCK_SIZE];
+  UINTN                     BufferSize;
+} SHA_NI_CONTEXT;
+
+typedef struct {
+  UINT32                    HashMask;
+  SHA_NI_CONTEXT            ShaNi[HASH_SHA_NI_BANK_COUNT];   ///< Used with the SHA extensions
+  VOID                      *Crypt[HASH_SHA_NI_BANK_COUNT];  ///< Used otherwise
+} HASH_SHA_NI_HANDLE;
+
+STATIC CONST UINT32 mSha1InitialState[] = {
+  0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0
+};
+
+STATIC CONST UINT32 mSha256InitialState[] = {
+  0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+  0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+STATIC CONST HASH_SHA_NI_BANK mBanks[HASH_SHA_NI_BANK_COUNT] = {
+  {
+    HASH_ALG_SHA1,
+    TPM_ALG_SHA1,
+    SHA1_DIGEST_SIZE,
+    sizeof (mSha1InitialState) / sizeof (mSha1InitialState[0]),
+    mSha1InitialState,
+    InternalSha1ShaNiBlocks,
+    Sha1GetContextSize,
+    Sha1Init,
+    Sha1Update,
+    Sha1Final
+  },
+  {
+    HASH_ALG_SHA256,
+    TPM_ALG_SHA256,
+    SHA256_DIGEST_SIZE,
+    sizeof (mSha256InitialState) / sizeof (mSha256InitialState[0]),
+    mSha256InitialState,
+    InternalSha256ShaNiBlocks,
+    Sha256GetContextSize,
+    Sha256Init,
+    Sha256Update,
+    Sha256Final
+  }
+};
+
+//
+// FIPS 180-2 examples: a message of one block, a message whose padding spills
+// into a second block, and a message of two blocks
+//
+typedef struct {
+  CONST CHAR8               *Message;
+  UINT8                     Digest[HASH_SHA_NI_BANK_COUNT][SHA256_DIGEST_SIZE];  ///< In mBanks order
+} HASH_SHA_NI_KAT;
+
+STATIC CONST HASH_SHA_NI_KAT mKats[] = {
+  {
+    "abc",
+    {
+      {
+        0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+        0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d
+      },
+      {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41,
+        0x40, 0xde, 0x5d, 0xae, 0x22, 0x23, 0xb0, 0x03, 0x61, 0xa3,
+        0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00,
+        0x15, 0xad
+      }
+    }
+  },
+  {
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+    {
+      {
+        0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+        0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1
+      },
+      {
+        0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0,
+        0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39, 0xa3, 0x3c, 0xe4, 0x59,
+        0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb,
+        0x06, 0xc1
+      }
+    }
+  },
+  {
+    "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmn"
+    "hijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+    {
+      {
+        0xa4, 0x9b, 0x24, 0x46, 0xa0, 0x2c, 0x64, 0x5b, 0xf4, 0x19,
+        0xf9, 0x95, 0xb6, 0x70, 0x91, 0x25, 0x3a, 0x04, 0xa2, 0x59
+      },
+      {
+        0xcf, 0x5b, 0x16, 0xa7, 0x78, 0xaf, 0x83, 0x80, 0x03, 0x6c,
+        0xe5, 0x9e, 0x7b, 0x04, 0x92, 0x37, 0x0b, 0x24, 0x9b, 0x11,
+        0xe8, 0xf0, 0x7a, 0x51, 0xaf, 0xac, 0x45, 0x03, 0x7a, 0xfe,
+        0xe9, 0xd1
+      }
+    }
+  }
+};
+
+STATIC BOOLEAN  mShaNiSupported = FALSE;
+
+/**
+  Add data to a bank hashed with the SHA extensions.
+
+  @param[in, out] Bank         The bank.
+  @param[in, out] Context      The SHA extension context of the bank.
+  @param[in]      Data         The data.
+  @param[in]      DataSize     The size of the data.
+
+**/
+STATIC
+VOID
+ShaNiUpdate (
+  IN     CONST HASH_SHA_NI_BANK    *Bank,
+  IN OUT SHA_NI_CONTEXT            *Context,
+  IN     CONST UINT8               *Data,
+  IN     UINTN                     DataSize
+  )
+{
+  UINTN                     Size;
+
+  Context->Length += DataSize;
+
+  if (Context->BufferSize != 0) {
+    Size = MIN (DataSize, HASH_SHA_NI_BLOCK_SIZE - Context->BufferSize);
+    CopyMem (Context->Buffer + Context->BufferSize, Data, Size);
+    Context->BufferSize += Size;
+    Data     += Size;
+    DataSize -= Size;
+    if (Context->BufferSize < HASH_SHA_NI_BLOCK_SIZE) {
+      return;
+    }
+    Bank->Blocks (Context->State, Context->Buffer, 1);
+    Context->BufferSize = 0;
+  }
+
+  if (DataSize >= HASH_SHA_NI_BLOCK_SIZE) {
+    Bank->Blocks (Context->State, Data, DataSize / HASH_SHA_NI_BLOCK_SIZE);
+    Size      = DataSize & ~(UINTN) (HASH_SHA_NI_BLOCK_SIZE - 1);
+    Data     += Size;
+    DataSize -= Size;
+  }
+
+  CopyMem (Context->Buffer, Data, DataSize);
+  Context->BufferSize = DataSize;
+}
+
+/**
+  Pad the data of a bank hashed with the SHA extensions and return the digest.
+
+  @param[in]      Bank         The bank.
+  @param[in, out] Context      The SHA extension context of the bank.
+  @param[out]     Digest       The digest, DigestSize bytes of the bank.
+
+**/
+STATIC
+VOID
+ShaNiFinal (
+  IN     CONST HASH_SHA_NI_BANK    *Bank,
+  IN OUT SHA_NI_CONTEXT            *Context,
+  OUT    UINT8                     *Digest
+  )
+{
+  UINT64                    BitLength;
+  UINTN                     Index;
+
+  BitLength = MultU64x32 (Context->Length, 8);
+
+  Context->Buffer[Context->BufferSize++] = 0x80;
+  if (Context->BufferSize > HASH_SHA_NI_BLOCK_SIZE - sizeof (UINT64)) {
+    ZeroMem (Context->Buffer + Context->BufferSize, HASH_SHA_NI_BLOCK_SIZE - Context->BufferSize);
+    Bank->Blocks (Context->State, Context->Buffer, 1);
+    Context->BufferSize = 0;
+  }
+  ZeroMem (Context->Buffer + Context->BufferSize, HASH_SHA_NI_BLOCK_SIZE - sizeof (UINT64) - Context->BufferSize);
+  WriteUnaligned64 (
+    (UINT64 *) (Context->Buffer + HASH_SHA_NI_BLOCK_SIZE - sizeof (UINT64)),
+    SwapBytes64 (BitLength)
+    );
+  Bank->Blocks (Context->State, Context->Buffer, 1);
+
+  for (Index = 0; Index < Bank->StateWords; Index++) {
+    WriteUnaligned32 ((UINT32 *) Digest + Index, SwapBytes32 (Context->State[Index]));
+  }
+}
+
+/**
+  Check the banks hashed with the SHA extensions against known answers.
+
+  @retval TRUE     Every digest matches.
+  @retval FALSE    A digest does not match.
+
+**/
+STATIC
+BOOLEAN
+ShaNiSelfTest (
+  VOID
+  )
+{
+  SHA_NI_CONTEXT            Context;
+  UINT8                     Digest[SHA256_DIGEST_SIZE];
+  CONST UINT8               *Message;
+  UINTN                     MessageSize;
+  UINTN                     KatIndex;
+  UINTN                     Index;
+
+  for (KatIndex = 0; KatIndex < sizeof (mKats) / sizeof (mKats[0]); KatIndex++) {
+    Message     = (CONST UINT8 *) mKats[KatIndex].Message;
+    MessageSize = AsciiStrLen (mKats[KatIndex].Message);
+    for (Index = 0; Index < HASH_SHA_NI_BANK_COUNT; Index++) {
+      ZeroMem (&Context, sizeof (Context));
+      CopyMem (Context.State, mBanks[Index].InitialState, mBanks[Index].StateWords * sizeof (UINT32));
+      //
+      // Split the message so that the partial block path is taken as well
+      //
+      ShaNiUpdate (&mBanks[Index], &Context, Message, 1);
+      ShaNiUpdate (&mBanks[Index], &Context, Message + 1, MessageSize - 1);
+      ShaNiFinal (&mBanks[Index], &Context, Digest);
+      if (CompareMem (Digest, mKats[KatIndex].Digest[Index], mBanks[Index].DigestSize) != 0) {
+        DEBUG ((DEBUG_ERROR, "HashLibShaNi: known answer test %d of algorithm 0x%x failed\n", KatIndex, mBanks[Index].AlgoId));
+        return FALSE;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+/**
+  Start hash sequence.
+
+  @param HashHandle Hash handle.
+
+  @retval EFI_SUCCESS          Hash sequence start and HandleHandle returned.
+  @retval EFI_OUT_OF_RESOURCES No enough resource to start hash.
+**/
+EFI_STATUS
+EFIAPI
+HashStart (
+  OUT HASH_HANDLE    *HashHandle
+  )
+{
+  HASH_SHA_NI_HANDLE        *Handle;
+  UINTN                     Index;
+
+  Handle = AllocateZeroPool (sizeof (*Handle));
+  if (Handle == NULL) {
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  Handle->HashMask = PcdGet32 (PcdTpm2HashMask);
+  for (Index = 0; Index < HASH_SHA_NI_BANK_COUNT; Index++) {
+    if ((Handle->HashMask & mBanks[Index].HashMask) == 0) {
+      continue;
+    }
+    if (mShaNiSupported) {
+      CopyMem (
+        Handle->ShaNi[Index].State,
+        mBanks[Index].InitialState,
+        mBanks[Index].StateWords * sizeof (UINT32)
+        );
+      continue;
+    }
+    Handle->Crypt[Index] = AllocatePool (mBanks[Index].GetContextSize ());
+    if (Handle->Crypt[Index] == NULL) {
+      while (Index-- > 0) {
+        if (Handle->Crypt[Index] != NULL) {
+          FreePool (Handle->Crypt[Index]);
+        }
+      }
+      FreePool (Handle);
+      return EFI_OUT_OF_RESOURCES;
+    }
+    mBanks[Index].Init (Handle->Crypt[Index]);
+  }
+
+  *HashHandle = (HASH_HANDLE) Handle;
+  return EFI_SUCCESS;
+}
+
+/**
+  Update hash sequence data.
+
+  @param HashHandle    Hash handle.
+  @param DataToHash    Data to be hashed.
+  @param DataToHashLen Data size.
+
+  @retval EFI_SUCCESS     Hash sequence updated.
+**/
+EFI_STATUS
+EFIAPI
+HashUpdate (
+  IN HASH_HANDLE    HashHandle,
+  IN VOID           *DataToHash,
+  IN UINTN          DataToHashLen
+  )
+{
+  HASH_SHA_NI_HANDLE        *Handle;
+  CONST UINT8               *Data;
+  UINTN                     Size;
+  UINTN                     Index;
+
+  Handle = (HASH_SHA_NI_HANDLE *) HashHandle;
+  Data   = DataToHash;
+
+  while (DataToHashLen != 0) {
+    Size = MIN (DataToHashLen, HASH_SHA_NI_CHUNK_SIZE);
+    for (Index = 0; Index < HASH_SHA_NI_BANK_COUNT; Index++) {
+      if ((Handle->HashMask & mBanks[Index].HashMask) == 0) {
+        continue;
+      }
+      if (mShaNiSupported) {
+        ShaNiUpdate (&mBanks[Index], &Handle->ShaNi[Index], Data, Size);
+      } else {
+        mBanks[Index].Update (Handle->Crypt[Index], Data, Size);
+      }
+    }
+    Data          += Size;
+    DataToHashLen -= Size;
+  }
+
+  return EFI_SUCCESS;
+}
+
+/**
+  Hash sequence complete and extend to PCR.
+
+  @param HashHandle    Hash handle.
+  @param PcrIndex      PCR to be extended.
+  @param DataToHash    Data to be hashed.
+  @param DataToHashLen Data size.
+  @param DigestList    Digest list.
+
+  @retval EFI_SUCCESS     Hash sequence complete and DigestList is returned.
+**/
+EFI_STATUS
+EFIAPI
+HashCompleteAndExtend (
+  IN HASH_HANDLE         HashHandle,
+  IN TPMI_DH_PCR         PcrIndex,
+  IN VOID                *DataToHash,
+  IN UINTN               DataToHashLen,
+  OUT TPML_DIGEST_VALUES *DigestList
+  )
+{
+  HASH_SHA_NI_HANDLE        *Handle;
+  TPMT_HA                   *Digest;
+  UINTN                     Index;
+
+  HashUpdate (HashHandle, DataToHash, DataToHashLen);
+
+  Handle = (HASH_SHA_NI_HANDLE *) HashHandle;
+  ZeroMem (DigestList, sizeof (*DigestList));
+
+  for (Index = 0; Index < HASH_SHA_NI_BANK_COUNT; Index++) {
+    if ((Handle->HashMask & mBanks[Index].HashMask) == 0) {
+      continue;
+    }
+    Digest          = &DigestList->digests[DigestList->count++];
+    Digest->hashAlg = mBanks[Index].AlgoId;
+    if (mShaNiSupported) {
+      ShaNiFinal (&mBanks[Index], &Handle->ShaNi[Index], (UINT8 *) &Digest->digest);
+    } else {
+      mBanks[Index].Final (Handle->Crypt[Index], (UINT8 *) &Digest->digest);
+      FreePool (Handle->Crypt[Index]);
+    }
+  }
+  FreePool (Handle);
+
+  return Tpm2PcrExtend (PcrIndex, DigestList);
+}
+
+/**
+  Hash data and extend to PCR.
+
+  @param PcrIndex      PCR to be extended.
+  @param DataToHash    Data to be hashed.
+  @param DataToHashLen Data size.
+  @param DigestList    Digest list.
+
+  @retval EFI_SUCCESS     Hash data and DigestList is returned.
+**/
+EFI_STATUS
+EFIAPI
+HashAndExtend (
+  IN TPMI_DH_PCR                    PcrIndex,
+  IN VOID                           *DataToHash,
+  IN UINTN                          DataToHashLen,
+  OUT TPML_DIGEST_VALUES            *DigestList
+  )
+{
+  HASH_HANDLE               HashHandle;
+  EFI_STATUS                Status;
+
+  Status = HashStart (&HashHandle);
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  return HashCompleteAndExtend (HashHandle, PcrIndex, DataToHash, DataToHashLen, DigestList);
+}
+
+/**
+  This service registers a new hash interface.
+
+  The banks of this instance are built in, so no interface can be added.
+
+  @param HashInterface  Hash interface
+
+  @retval EFI_UNSUPPORTED  Registering a hash interface is not supported.
+**/
+EFI_STATUS
+EFIAPI
+RegisterHashInterfaceLib (
+  IN HASH_INTERFACE   *HashInterface
+  )
+{
+  return EFI_UNSUPPORTED;
+}
+
+/**
+  Detect the SHA extensions and report the supported hash algorithms.
+
+  @param  ImageHandle   The firmware allocated handle for the EFI image.
+  @param  SystemTable   A pointer to the EFI System Table.
+
+  The SHA extensions are only used if they pass the known answer tests;
+  otherwise every bank is hashed with BaseCryptLib.
+
+  @retval EFI_SUCCESS   The constructor always returns EFI_SUCCESS.
+
+**/
+EFI_STATUS
+EFIAPI
+HashLibShaNiConstructor (
+  IN EFI_HANDLE        ImageHandle,
+  IN EFI_SYSTEM_TABLE  *SystemTable
+  )
+{
+  EFI_STATUS                Status;
+
+  mShaNiSupported = InternalIsShaNiSupported ();
+  if (mShaNiSupported && !ShaNiSelfTest ()) {
+    //
+    // Never extend a PCR with a wrong digest
+    //
+    mShaNiSupported = FALSE;
+    DEBUG ((DEBUG_ERROR, "HashLibShaNi: SHA extensions failed the known answer tests, not used\n"));
+  }
+  DEBUG ((DEBUG_INFO, "HashLibShaNi: SHA extensions %a\n", mShaNiSupported ? "used" : "not supported"));
+
+  Status = PcdSet32S (PcdTcg2HashAlgorithmBitmap, HASH_ALG_SHA1 | HASH_ALG_SHA256);
+  ASSERT_EFI_ERROR (Status);
+
+  return EFI_SUCCESS;
+}
@@ -0,0 +1,73 @@
+/** @file
+  Internal definitions of the HashLib instance using the SHA extensions.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __HASH_LIB_SHA_NI_INTERNAL_H__
+#define __HASH_LIB_SHA_NI_INTERNAL_H__
+
+#include <Uefi.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/BaseCryptLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HashLib.h>
+#include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
+#include <Library/Tpm2CommandLib.h>
+
+/**
+  Hash whole 64-byte blocks into a SHA-1 state with the SHA extensions.
+
+  @param[in, out] State        The state words A..E.
+  @param[in]      Data         The blocks.
+  @param[in]      BlockCount   The number of blocks.
+
+**/
+VOID
+EFIAPI
+InternalSha1ShaNiBlocks (
+  IN OUT UINT32             *State,
+  IN     CONST UINT8        *Data,
+  IN     UINTN              BlockCount
+  );
+
+/**
+  Hash whole 64-byte blocks into a SHA-256 state with the SHA extensions.
+
+  @param[in, out] State        The state words A..H.
+  @param[in]      Data         The blocks.
+  @param[in]      BlockCount   The number of blocks.
+
+**/
+VOID
+EFIAPI
+InternalSha256ShaNiBlocks (
+  IN OUT UINT32             *State,
+  IN     CONST UINT8        *Data,
+  IN     UINTN              BlockCount
+  );
+
+/**
+  Check whether the processor supports the SHA extensions and the SSE
+  instructions that the block functions use with them.
+
+  @retval TRUE     The block functions can be used.
+  @retval FALSE    The block functions cannot be used.
+
+**/
+BOOLEAN
+InternalIsShaNiSupported (
+  VOID
+  );
+
+#endif
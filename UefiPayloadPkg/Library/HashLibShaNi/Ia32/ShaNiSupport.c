@@ -0,0 +1,68 @@
+/** @file
+  The SHA extension block functions are only built for X64.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "../HashLibShaNiInternal.h"
+
+/**
+  Check whether the processor supports the SHA extensions and the SSE
+  instructions that the block functions use with them.
+
+  @retval FALSE    The block functions are not available on IA32.
+
+**/
+BOOLEAN
+InternalIsShaNiSupported (
+  VOID
+  )
+{
+  return FALSE;
+}
+
+/**
+  Hash whole 64-byte blocks into a SHA-1 state with the SHA extensions.
+
+  @param[in, out] State        The state words A..E.
+  @param[in]      Data         The blocks.
+  @param[in]      BlockCount   The number of blocks.
+
+**/
+VOID
+EFIAPI
+InternalSha1ShaNiBlocks (
+  IN OUT UINT32             *State,
+  IN     CONST UINT8        *Data,
+  IN     UINTN              BlockCount
+  )
+{
+  ASSERT (FALSE);
+}
+
+/**
+  Hash whole 64-byte blocks into a SHA-256 state with the SHA extensions.
+
+  @param[in, out] State        The state words A..H.
+  @param[in]      Data         The blocks.
+  @param[in]      BlockCount   The number of blocks.
+
+**/
+VOID
+EFIAPI
+InternalSha256ShaNiBlocks (
+  IN OUT UINT32             *State,
+  IN     CONST UINT8        *Data,
+  IN     UINTN              BlockCount
+  )
+{
+  ASSERT (FALSE);
+}
@@ -0,0 +1,49 @@
+/** @file
+  Detect the SHA extensions on X64.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "../HashLibShaNiInternal.h"
+
+/**
+  Check whether the processor supports the SHA extensions and the SSE
+  instructions that the block functions use with them.
+
+  @retval TRUE     The block functions can be used.
+  @retval FALSE    The block functions cannot be used.
+
+**/
+BOOLEAN
+InternalIsShaNiSupported (
+  VOID
+  )
+{
+  UINT32                    MaxLeaf;
+  UINT32                    RegEbx;
+  UINT32                    RegEcx;
+
+  AsmCpuid (0, &MaxLeaf, NULL, NULL, NULL);
+  if (MaxLeaf < 7) {
+    return FALSE;
+  }
+
+  //
+  // CPUID.01H:ECX.SSSE3[bit 9] and SSE4_1[bit 19] for the byte shuffles,
+  // CPUID.(EAX=07H,ECX=0):EBX.SHA[bit 29] for the SHA instructions.
+  //
+  AsmCpuid (1, NULL, NULL, &RegEcx, NULL);
+  AsmCpuidEx (7, 0, NULL, &RegEbx, NULL, NULL);
+
+  return (BOOLEAN) (((RegEbx & BIT29) != 0) &&
+                    ((RegEcx & BIT9) != 0) &&
+                    ((RegEcx & BIT19) != 0));
+}
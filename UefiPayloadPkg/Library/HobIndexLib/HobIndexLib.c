@@ -0,0 +1,265 @@
+/** @file
+  HOB list functions and GUID index shared by the PEI and DXE instances.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include "HobIndexLibInternal.h"
+
+/**
+  Return the hash slot of a GUID before probing.
+
+  @param[in] Guid       The GUID.
+
+  @return The hash of the GUID.
+
+**/
+STATIC
+UINT32
+HobIndexHash (
+  IN CONST EFI_GUID         *Guid
+  )
+{
+  UINT32                    Hash;
+
+  Hash = ReadUnaligned32 ((CONST UINT32 *) Guid) ^
+         ReadUnaligned32 ((CONST UINT32 *) Guid + 1) ^
+         ReadUnaligned32 ((CONST UINT32 *) Guid + 2) ^
+         ReadUnaligned32 ((CONST UINT32 *) Guid + 3);
+  return Hash ^ (Hash >> 16);
+}
+
+/**
+  Build an index of the first GUID HOB of each GUID in a HOB list.
+
+  @param[in] HobList    The HOB list.
+
+  @return The index, or NULL if it cannot be allocated.
+
+**/
+HOB_INDEX *
+HobIndexBuild (
+  IN VOID                   *HobList
+  )
+{
+  EFI_PEI_HOB_POINTERS      Hob;
+  HOB_INDEX                 *Index;
+  UINT32                    Count;
+  UINT32                    SlotCount;
+  UINT32                    Slot;
+
+  Count = 0;
+  for (Hob.Raw = HobList; !END_OF_HOB_LIST (Hob); Hob.Raw = GET_NEXT_HOB (Hob)) {
+    if (GET_HOB_TYPE (Hob) == EFI_HOB_TYPE_GUID_EXTENSION) {
+      Count++;
+    }
+  }
+
+  //
+  // Keep the table at most half full so that probing stays short
+  //
+  SlotCount = 8;
+  while (SlotCount < Count * 2) {
+    SlotCount <<= 1;
+  }
+
+  Index = AllocateZeroPool (sizeof (HOB_INDEX) + (SlotCount - 1) * sizeof (HOB_INDEX_ENTRY));
+  if (Index == NULL) {
+    return NULL;
+  }
+  Index->Signature = HOB_INDEX_SIGNATURE;
+  Index->SlotCount = SlotCount;
+  Index->HobList   = HobList;
+
+  //
+  // In PEI the allocation above adds a pool HOB, so walk up to the new end
+  //
+  for (Hob.Raw = HobList; !END_OF_HOB_LIST (Hob); Hob.Raw = GET_NEXT_HOB (Hob)) {
+    if (GET_HOB_TYPE (Hob) != EFI_HOB_TYPE_GUID_EXTENSION) {
+      continue;
+    }
+    Slot = HobIndexHash (&Hob.Guid->Name) & (SlotCount - 1);
+    while (Index->Entries[Slot].Hob != NULL) {
+      if (CompareGuid (&Index->Entries[Slot].Name, &Hob.Guid->Name)) {
+        break;
+      }
+      Slot = (Slot + 1) & (SlotCount - 1);
+    }
+    if (Index->Entries[Slot].Hob == NULL) {
+      CopyGuid (&Index->Entries[Slot].Name, &Hob.Guid->Name);
+      Index->Entries[Slot].Hob = Hob.Guid;
+    }
+  }
+  Index->IndexedEnd = Hob.Header;
+
+  DEBUG ((DEBUG_VERBOSE, "HobIndexBuild: %d GUID HOBs in %d slots\n", Count, SlotCount));
+  return Index;
+}
+
+/**
+  Look up the first GUID HOB of a GUID among the HOBs that were indexed.
+
+  @param[in] Index      The index.
+  @param[in] Guid       The GUID to look up.
+
+  @return The GUID HOB, or NULL if no indexed HOB has this GUID.
+
+**/
+VOID *
+HobIndexLookup (
+  IN CONST HOB_INDEX        *Index,
+  IN CONST EFI_GUID         *Guid
+  )
+{
+  UINT32                    Slot;
+
+  Slot = HobIndexHash (Guid) & (Index->SlotCount - 1);
+  while (Index->Entries[Slot].Hob != NULL) {
+    if (CompareGuid (&Index->Entries[Slot].Name, Guid)) {
+      return Index->Entries[Slot].Hob;
+    }
+    Slot = (Slot + 1) & (Index->SlotCount - 1);
+  }
+  return NULL;
+}
+
+/**
+  Returns the next instance of a HOB type from the starting HOB.
+
+  This function searches the first instance of a HOB type from the starting HOB pointer.
+  If there does not exist such HOB type from the starting HOB pointer, it will return NULL.
+  In contrast with macro GET_NEXT_HOB(), this function does not skip the starting HOB pointer
+  unconditionally: it returns HobStart back if HobStart itself meets the requirement;
+  caller is required to use GET_NEXT_HOB() if it wishes to skip current HobStart.
+
+  If HobStart is NULL, then ASSERT().
+
+  @param  Type          The HOB type to return.
+  @param  HobStart      The starting HOB pointer to search from.
+
+  @return The next instance of a HOB type from the starting HOB.
+
+**/
+VOID *
+EFIAPI
+GetNextHob (
+  IN UINT16                 Type,
+  IN CONST VOID             *HobStart
+  )
+{
+  EFI_PEI_HOB_POINTERS      Hob;
+
+  ASSERT (HobStart != NULL);
+
+  Hob.Raw = (UINT8 *) HobStart;
+  //
+  // Parse the HOB list until end of list or matching type is found.
+  //
+  while (!END_OF_HOB_LIST (Hob)) {
+    if (Hob.Header->HobType == Type) {
+      return Hob.Raw;
+    }
+    Hob.Raw = GET_NEXT_HOB (Hob);
+  }
+  return NULL;
+}
+
+/**
+  Returns the first instance of a HOB type among the whole HOB list.
+
+  This function searches the first instance of a HOB type among the whole HOB list.
+  If there does not exist such HOB type in the HOB list, it will return NULL.
+
+  If the pointer to the HOB list is NULL, then ASSERT().
+
+  @param  Type          The HOB type to return.
+
+  @return The next instance of a HOB type from the starting HOB.
+
+**/
+VOID *
+EFIAPI
+GetFirstHob (
+  IN UINT16                 Type
+  )
+{
+  VOID                      *HobList;
+
+  HobList = GetHobList ();
+  return GetNextHob (Type, HobList);
+}
+
+/**
+  Returns the next instance of the matched GUID HOB from the starting HOB.
+
+  This function searches the first instance of a HOB from the starting HOB pointer.
+  Such HOB should satisfy two conditions:
+  its HOB type is EFI_HOB_TYPE_GUID_EXTENSION, and its GUID Name equals to the input Guid.
+  If such a HOB from the starting HOB pointer does not exist, it will return NULL.
+  Caller is required to apply GET_GUID_HOB_DATA () and GET_GUID_HOB_DATA_SIZE ()
+  to extract the data section and its size information, respectively.
+  In contrast with macro GET_NEXT_HOB(), this function does not skip the starting HOB pointer
+  unconditionally: it returns HobStart back if HobStart itself meets the requirement;
+  caller is required to use GET_NEXT_HOB() if it wishes to skip current HobStart.
+
+  If Guid is NULL, then ASSERT().
+  If HobStart is NULL, then ASSERT().
+
+  @param  Guid          The GUID to match with in the HOB list.
+  @param  HobStart      A pointer to a Guid.
+
+  @return The next instance of the matched GUID HOB from the starting HOB.
+
+**/
+VOID *
+EFIAPI
+GetNextGuidHob (
+  IN CONST EFI_GUID         *Guid,
+  IN CONST VOID             *HobStart
+  )
+{
+  EFI_PEI_HOB_POINTERS      GuidHob;
+
+  GuidHob.Raw = (UINT8 *) HobStart;
+  while ((GuidHob.Raw = GetNextHob (EFI_HOB_TYPE_GUID_EXTENSION, GuidHob.Raw)) != NULL) {
+    if (CompareGuid (Guid, &GuidHob.Guid->Name)) {
+      break;
+    }
+    GuidHob.Raw = GET_NEXT_HOB (GuidHob);
+  }
+  return GuidHob.Raw;
+}
+
+/**
+  Get the system boot mode from the HOB list.
+
+  This function returns the system boot mode information from the
+  PHIT HOB in HOB list.
+
+  If the pointer to the HOB list is NULL, then ASSERT().
+
+  @param  VOID.
+
+  @return The Boot Mode.
+
+**/
+EFI_BOOT_MODE
+EFIAPI
+GetBootModeHob (
+  VOID
+  )
+{
+  EFI_HOB_HANDOFF_INFO_TABLE    *HandOffHob;
+
+  HandOffHob = (EFI_HOB_HANDOFF_INFO_TABLE *) GetHobList ();
+
+  return HandOffHob->BootMode;
+}
@@ -0,0 +1,79 @@
+/** @file
+  Internal definitions of the HOB list library instances with a GUID index.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+  This program and the accompanying materials
+  are licensed and made available under the terms and conditions of the BSD License
+  which accompanies this distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS,
+  WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#ifndef __HOB_INDEX_LIB_INTERNAL_H__
+#define __HOB_INDEX_LIB_INTERNAL_H__
+
+#include <PiPei.h>
+#include <Library/BaseLib.h>
+#include <Library/BaseMemoryLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/MemoryAllocationLib.h>
+
+//
+// The index is shared by all modules of a phase: it is published as a PPI in
+// PEI and as a configuration table in DXE, both under gUefiHobIndexGuid.
+//
+#define HOB_INDEX_SIGNATURE    SIGNATURE_32 ('H', 'I', 'D', 'X')
+
+//
+// First GUID HOB of a GUID. Hob is NULL for an empty slot.
+//
+typedef struct {
+  EFI_GUID                  Name;
+  EFI_HOB_GUID_TYPE         *Hob;
+} HOB_INDEX_ENTRY;
+
+typedef struct {
+  UINT32                    Signature;
+  UINT32                    SlotCount;      ///< Power of two
+  VOID                      *HobList;
+  ///
+  /// The end of list HOB when the index was built. HOBs created later start here.
+  ///
+  EFI_HOB_GENERIC_HEADER    *IndexedEnd;
+  EFI_PEI_PPI_DESCRIPTOR    PpiDescriptor;  ///< Used in PEI only
+  HOB_INDEX_ENTRY           Entries[1];
+} HOB_INDEX;
+
+/**
+  Build an index of the first GUID HOB of each GUID in a HOB list.
+
+  @param[in] HobList    The HOB list.
+
+  @return The index, or NULL if it cannot be allocated.
+
+**/
+HOB_INDEX *
+HobIndexBuild (
+  IN VOID                   *HobList
+  );
+
+/**
+  Look up the first GUID HOB of a GUID among the HOBs that were indexed.
+
+  @param[in] Index      The index.
+  @param[in] Guid       The GUID to look up.
+
+  @return The GUID HOB, or NULL if no indexed HOB has this GUID.
+
+**/
+VOID *
+HobIndexLookup (
+  IN CONST HOB_INDEX        *Index,
+  IN CONST EFI_GUID         *Guid
+  );
+
+#endif
@@ -0,0 +1,304 @@
+/** @file
+  PCI configuration space access used while scanning for root bridges.
+
+  The scan runs before the PCI bus driver and touches every candidate device, so
+  it goes through the memory mapped ECAM window when one is known and falls back
+  to PciLib (normally port CF8/CFC) otherwise. Every access is counted so that the
+  cost of the scan can be seen in the debug log.
+
+  Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+
+  This program and the accompanying materials are licensed and made available
+  under the terms and conditions of the BSD License which accompanies this
+  distribution.  The full text of the license may be found at
+  http://opensource.org/licenses/bsd-license.php.
+
+  THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN "AS IS" BASIS, WITHOUT
+  WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+
+**/
+
+#include <PiDxe.h>
+#include <IndustryStandard/Acpi.h>
+#include <IndustryStandard/MemoryMappedConfigurationSpaceAccessTable.h>
+#include <IndustryStandard/Pci.h>
+#include <Protocol/PciHostBridgeResourceAllocation.h>
+#include <Protocol/PciRootBridgeIo.h>
+#include <Guid/SystemTableInfoGuid.h>
+#include <Library/BaseLib.h>
+#include <Library/DebugLib.h>
+#include <Library/HobLib.h>
+#include <Library/IoLib.h>
+#include <Library/PcdLib.h>
+#include <Library/PciHostBridgeLib.h>
+#include <Library/PciLib.h>
+#include <Library/SynchronizationLib.h>
+#include "PciHostBridge.h"
+
+#define PCI_ECAM_ADDRESS(Bus, Device, Function, Offset) \
+  (((Bus) << 20) | ((Device) << 15) | ((Function) << 12) | (Offset))
+
+volatile UINT32  mPciConfigCycles;
+
+STATIC UINTN   mPciEcamBase;
+STATIC UINTN   mPciEcamStartBus;
+STATIC UINTN   mPciEcamEndBus;
+
+/**
+  Find the ECAM window of PCI segment 0 in the ACPI MCFG table.
+
+  @param[out] Base       ECAM base address of bus 0.
+  @param[out] StartBus   First bus decoded by the window.
+  @param[out] EndBus     Last bus decoded by the window.
+
+  @retval EFI_SUCCESS     The window was found.
+  @retval EFI_NOT_FOUND   There is no ACPI table, no MCFG or no segment 0 entry.
+**/
+STATIC
+EFI_STATUS
+FindMcfgWindow (
+  OUT UINT64     *Base,
+  OUT UINTN      *StartBus,
+  OUT UINTN      *EndBus
+  )
+{
+  EFI_HOB_GUID_TYPE                             *GuidHob;
+  SYSTEM_TABLE_INFO                             *SystemTableInfo;
+  EFI_ACPI_3_0_ROOT_SYSTEM_DESCRIPTION_POINTER  *Rsdp;
+  EFI_ACPI_DESCRIPTION_HEADER                   *Rsdt;
+  EFI_ACPI_DESCRIPTION_HEADER                   *Xsdt;
+  EFI_ACPI_DESCRIPTION_HEADER                   *Mcfg;
+  UINT32                                        *Entry32;
+  UINT64                                        *Entry64;
+  UINTN                                         EntryNum;
+  UINTN                                         Idx;
+  EFI_ACPI_MEMORY_MAPPED_ENHANCED_CONFIGURATION_SPACE_BASE_ADDRESS_ALLOCATION_STRUCTURE  *Allocation;
+  UINTN                                         AllocationNum;
+
+  GuidHob = GetFirstGuidHob (&gUefiSystemTableInfoGuid);
+  if (GuidHob == NULL) {
+    return EFI_NOT_FOUND;
+  }
+  SystemTableInfo = (SYSTEM_TABLE_INFO *) GET_GUID_HOB_DATA (GuidHob);
+  Rsdp = (EFI_ACPI_3_0_ROOT_SYSTEM_DESCRIPTION_POINTER *)(UINTN) SystemTableInfo->AcpiTableBase;
+  if (Rsdp == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  //
+  // Search Xsdt first since it is the table the OS uses when both exist
+  //
+  Mcfg = NULL;
+  Xsdt = NULL;
+  if (Rsdp->Revision >= EFI_ACPI_3_0_ROOT_SYSTEM_DESCRIPTION_POINTER_REVISION) {
+    Xsdt = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN) Rsdp->XsdtAddress;
+  }
+  if (Xsdt != NULL) {
+    Entry64  = (UINT64 *)(Xsdt + 1);
+    EntryNum = (Xsdt->Length - sizeof (EFI_ACPI_DESCRIPTION_HEADER)) >> 3;
+    for (Idx = 0; Idx < EntryNum; Idx++) {
+      if (*(UINT32 *)(UINTN) ReadUnaligned64 (&Entry64[Idx]) ==
+          EFI_ACPI_3_0_PCI_EXPRESS_MEMORY_MAPPED_CONFIGURATION_SPACE_BASE_ADDRESS_DESCRIPTION_TABLE_SIGNATURE) {
+        Mcfg = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN) ReadUnaligned64 (&Entry64[Idx]);
+        break;
+      }
+    }
+  }
+
+  Rsdt = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN) Rsdp->RsdtAddress;
+  if (Mcfg == NULL && Rsdt != NULL) {
+    Entry32  = (UINT32 *)(Rsdt + 1);
+    EntryNum = (Rsdt->Length - sizeof (EFI_ACPI_DESCRIPTION_HEADER)) >> 2;
+    for (Idx = 0; Idx < EntryNum; Idx++) {
+      if (*(UINT32 *)(UINTN) Entry32[Idx] ==
+          EFI_ACPI_3_0_PCI_EXPRESS_MEMORY_MAPPED_CONFIGURATION_SPACE_BASE_ADDRESS_DESCRIPTION_TABLE_SIGNATURE) {
+        Mcfg = (EFI_ACPI_DESCRIPTION_HEADER *)(UINTN) Entry32[Idx];
+        break;
+      }
+    }
+  }
+
+  if (Mcfg == NULL) {
+    return EFI_NOT_FOUND;
+  }
+
+  Allocation    = (EFI_ACPI_MEMORY_MAPPED_ENHANCED_CONFIGURATION_SPACE_BASE_ADDRESS_ALLOCATION_STRUCTURE *)
+                  ((EFI_ACPI_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_HEADER *) Mcfg + 1);
+  AllocationNum = (Mcfg->Length - sizeof (EFI_ACPI_MEMORY_MAPPED_CONFIGURATION_BASE_ADDRESS_TABLE_HEADER)) /
+                  sizeof (*Allocation);
+  for (Idx = 0; Idx < AllocationNum; Idx++) {
+    if (Allocation[Idx].PciSegmentGroupNumber == 0 &&
+        Allocation[Idx].StartBusNumber <= Allocation[Idx].EndBusNumber) {
+      *Base     = Allocation[Idx].BaseAddress;
+      *StartBus = Allocation[Idx].StartBusNumber;
+      *EndBus   = Allocation[Idx].EndBusNumber;
+      return EFI_SUCCESS;
+    }
+  }
+
+  return EFI_NOT_FOUND;
+}
+
+/**
+  Select the configuration access method for the root bridge scan.
+
+  The ECAM window is taken from PcdPciExpressBaseAddress when the platform sets
+  it, otherwise from the MCFG table passed up by the bootloader.
+
+  @return The last bus number worth probing for root bridges.
+**/
+UINTN
+PciConfigAccessInitialize (
+  VOID
+  )
+{
+  EFI_STATUS     Status;
+  UINT64         Base;
+  UINTN          StartBus;
+  UINTN          EndBus;
+
+  mPciConfigCycles = 0;
+  mPciEcamBase     = 0;
+  mPciEcamStartBus = 0;
+  mPciEcamEndBus   = PCI_MAX_BUS;
+
+  Base = PcdGet64 (PcdPciExpressBaseAddress);
+  if (Base != 0) {
+    StartBus = 0;
+    EndBus   = PCI_MAX_BUS;
+  } else {
+    Status = FindMcfgWindow (&Base, &StartBus, &EndBus);
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "PCI scan uses CF8/CFC, no ECAM window found\n"));
+      return PCI_MAX_BUS;
+    }
+  }
+
+  //
+  // The window has to be reachable with a UINTN address
+  //
+  if (Base + LShiftU64 (EndBus + 1, 20) - 1 > MAX_ADDRESS) {
+    DEBUG ((DEBUG_WARN, "PCI ECAM window 0x%lx is not addressable, use CF8/CFC\n", Base));
+    return PCI_MAX_BUS;
+  }
+
+  mPciEcamBase     = (UINTN) Base;
+  mPciEcamStartBus = StartBus;
+  mPciEcamEndBus   = EndBus;
+  DEBUG ((DEBUG_INFO, "PCI scan uses ECAM at 0x%lx, bus 0x%x - 0x%x\n", Base, (UINT32) StartBus, (UINT32) EndBus));
+
+  //
+  // A bus beyond the window is not decoded by the host bridge either
+  //
+  return EndBus;
+}
+
+/**
+  Return TRUE if the root bridge scan accesses configuration space through ECAM.
+**/
+BOOLEAN
+PciConfigAccessIsEcam (
+  VOID
+  )
+{
+  return (BOOLEAN) (mPciEcamBase != 0);
+}
+
+/**
+  Return TRUE if the configuration space of a bus can be accessed from several
+  processors at once.
+
+  ECAM accesses are single MMIO cycles. CF8/CFC needs an address and a data
+  access that another processor must not interleave.
+
+  @param[in]  Bus        PCI bus number.
+**/
+BOOLEAN
+PciConfigAccessIsMpSafe (
+  IN UINTN       Bus
+  )
+{
+  return (BOOLEAN) (mPciEcamBase != 0 && Bus >= mPciEcamStartBus && Bus <= mPciEcamEndBus);
+}
+
+/**
+  Read a dword from PCI configuration space.
+
+  @param[in]  Bus        PCI bus number.
+  @param[in]  Device     PCI device number.
+  @param[in]  Function   PCI function number.
+  @param[in]  Offset     Dword aligned register offset.
+
+  @return The register value.
+**/
+UINT32
+PciConfigRead32 (
+  IN UINTN       Bus,
+  IN UINTN       Device,
+  IN UINTN       Function,
+  IN UINTN       Offset
+  )
+{
+  InterlockedIncrement (&mPciConfigCycles);
+
+  if (mPciEcamBase != 0 && Bus >= mPciEcamStartBus && Bus <= mPciEcamEndBus) {
+    return MmioRead32 (mPciEcamBase + PCI_ECAM_ADDRESS (Bus, Device, Function, Offset));
+  }
+  return PciRead32 (PCI_LIB_ADDRESS (Bus, Device, Function, Offset));
+}
+
+/**
+  Write a dword to PCI configuration space.
+
+  @param[in]  Bus        PCI bus number.
+  @param[in]  Device     PCI device number.
+  @param[in]  Function   PCI function number.
+  @param[in]  Offset     Dword aligned register offset.
+  @param[in]  Value      The value to write.
+**/
+VOID
+PciConfigWrite32 (
+  IN UINTN       Bus,
+  IN UINTN       Device,
+  IN UINTN       Function,
+  IN UINTN       Offset,
+  IN UINT32      Value
+  )
+{
+  InterlockedIncrement (&mPciConfigCycles);
+
+  if (mPciEcamBase != 0 && Bus >= mPciEcamStartBus && Bus <= mPciEcamEndBus) {
+    MmioWrite32 (mPciEcamBase + PCI_ECAM_ADDRESS (Bus, Device, Function, Offset), Value);
+    return;
+  }
+  PciWrite32 (PCI_LIB_ADDRESS (Bus, Device, Function, Offset), Value);
+}
+
+/**
+  Read the type 0/1 configuration header of a function as dwords.
+
+  @param[in]  Bus        PCI bus number.
+  @param[in]  Device     PCI device number.
+  @param[in]  Function   PCI function number.
+  @param[in]  FirstDword The first dword of the header, already read by the
+                         caller to check the vendor ID.
+  @param[out] Pci        Receives the header.
+**/
+VOID
+PciConfigReadHeader (
+  IN  UINTN      Bus,
+  IN  UINTN      Device,
+  IN  UINTN      Function,
+  IN  UINT32     FirstDword,
+  OUT PCI_TYPE01 *Pci
+  )
+{
+  UINT32         *Buffer;
+  UINTN          Offset;
+
+  Buffer    = (UINT32 *) Pci;
+  Buffer[0] = FirstDword;
+  for (Offset = sizeof (UINT32); Offset < sizeof (PCI_TYPE01); Offset += sizeof (UINT32)) {
+    Buffer[Offset / sizeof (UINT32)] = PciConfigRead32 (Bus, Device, Function, Offset);
+  }
+}
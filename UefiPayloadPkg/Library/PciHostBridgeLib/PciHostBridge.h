@@ -22,11 +22,139 @@ typedef struct {
   EFI_DEVICE_PATH_PROTOCOL EndDevicePath;
 } CB_PCI_ROOT_BRIDGE_DEVICE_PATH;
 
+//
+// Maximum number of root bridges the scan keeps on the stack
+//
+#define PCI_MAX_ROOT_BRIDGES  64
+
+typedef struct {
+  PCI_ROOT_BRIDGE_APERTURE Io;
+  PCI_ROOT_BRIDGE_APERTURE Mem;
+  PCI_ROOT_BRIDGE_APERTURE MemAbove4G;
+  PCI_ROOT_BRIDGE_APERTURE PMem;
+  PCI_ROOT_BRIDGE_APERTURE PMemAbove4G;
+} PCI_ROOT_BRIDGE_RESOURCE;
+
+//
+// A root bridge found by the scan
+//
+typedef struct {
+  UINT8                    RootBus;
+  UINT8                    SubBus;
+  UINT64                   Attributes;
+  PCI_ROOT_BRIDGE_RESOURCE Resource;
+  PCI_ROOT_BRIDGE_RESOURCE SizedResource;  // Sized BARs, to verify Resource in DEBUG builds
+} PCI_ROOT_BRIDGE_SCAN;
+
+//
+// Root bridges shared by the processors collecting their resources
+//
+typedef struct {
+  PCI_ROOT_BRIDGE_SCAN     *Table;
+  UINT32                   Count;
+  volatile UINT32          Next;           // Next root bridge to take
+} PCI_ROOT_BRIDGE_SCAN_CONTEXT;
+
 PCI_ROOT_BRIDGE *
 ScanForRootBridges (
   UINTN      *NumberOfRootBridges
 );
 
+//
+// Number of configuration space accesses done by the root bridge scan
+//
+extern volatile UINT32 mPciConfigCycles;
+
+/**
+  Select the configuration access method for the root bridge scan.
+
+  The ECAM window is taken from PcdPciExpressBaseAddress when the platform sets
+  it, otherwise from the MCFG table passed up by the bootloader.
+
+  @return The last bus number worth probing for root bridges.
+**/
+UINTN
+PciConfigAccessInitialize (
+  VOID
+);
+
+/**
+  Return TRUE if the root bridge scan accesses configuration space through ECAM.
+**/
+BOOLEAN
+PciConfigAccessIsEcam (
+  VOID
+);
+
+/**
+  Return TRUE if the configuration space of a bus can be accessed from several
+  processors at once.
+
+  ECAM accesses are single MMIO cycles. CF8/CFC needs an address and a data
+  access that another processor must not interleave.
+
+  @param[in]  Bus        PCI bus number.
+**/
+BOOLEAN
+PciConfigAccessIsMpSafe (
+  IN UINTN       Bus
+);
+
+/**
+  Read a dword from PCI configuration space.
+
+  @param[in]  Bus        PCI bus number.
+  @param[in]  Device     PCI device number.
+  @param[in]  Function   PCI function number.
+  @param[in]  Offset     Dword aligned register offset.
+
+  @return The register value.
+**/
+UINT32
+PciConfigRead32 (
+  IN UINTN       Bus,
+  IN UINTN       Device,
+  IN UINTN       Function,
+  IN UINTN       Offset
+);
+
+/**
+  Write a dword to PCI configuration space.
+
+  @param[in]  Bus        PCI bus number.
+  @param[in]  Device     PCI device number.
+  @param[in]  Function   PCI function number.
+  @param[in]  Offset     Dword aligned register offset.
+  @param[in]  Value      The value to write.
+**/
+VOID
+PciConfigWrite32 (
+  IN UINTN       Bus,
+  IN UINTN       Device,
+  IN UINTN       Function,
+  IN UINTN       Offset,
+  IN UINT32      Value
+);
+
+/**
+  Read the type 0/1 configuration header of a function as dwords.
+
+  @param[in]  Bus        PCI bus number.
+  @param[in]  Device     PCI device number.
+  @param[in]  Function   PCI function number.
+  @param[in]  FirstDword The first dword of the header, already read by the
+                         caller to check the vendor ID.
+  @param[out] Pci        Receives the header.
+**/
+VOID
+PciConfigReadHeader (
+  IN  UINTN      Bus,
+  IN  UINTN      Device,
+  IN  UINTN      Function,
+  IN  UINT32     FirstDword,
+  OUT PCI_TYPE01 *Pci
+);
+
 /**
   Initialize a PCI_ROOT_BRIDGE structure.
 
@@ -17,13 +17,24 @@
 #include <IndustryStandard/Pci.h>
 #include <Protocol/PciHostBridgeResourceAllocation.h>
 #include <Protocol/PciRootBridgeIo.h>
+#include <Protocol/MpService.h>
+#include <Guid/PciResourceInfoGuid.h>
 #include <Library/BaseMemoryLib.h>
 #include <Library/DebugLib.h>
+#include <Library/HobLib.h>
 #include <Library/MemoryAllocationLib.h>
+#include <Library/PcdLib.h>
 #include <Library/PciHostBridgeLib.h>
 #include <Library/PciLib.h>
+#include <Library/SynchronizationLib.h>
+#include <Library/UefiBootServicesTableLib.h>
 #include "PciHostBridge.h"
 
+//
+// PCI resources assigned by the bootloader, NULL if it did not pass them
+//
+STATIC PCI_RESOURCE_INFO  *mPciResourceInfo;
+
 /**
   Adjust the collected PCI resource.
 
@@ -109,40 +120,201 @@ AdjustRootBridgeResource (
 /**
   Probe a bar is existed or not.
 
-  @param[in]    Address           PCI address for the BAR.
+  @param[in]    Bus               PCI bus number.
+  @param[in]    Device            PCI device number.
+  @param[in]    Function          PCI function number.
+  @param[in]    Offset            Offset of the BAR.
   @param[out]   OriginalValue     The original bar value returned.
   @param[out]   Value             The probed bar value returned.
 **/
 STATIC
 VOID
 PcatPciRootBridgeBarExisted (
-  IN  UINT64                         Address,
+  IN  UINTN                          Bus,
+  IN  UINTN                          Device,
+  IN  UINTN                          Function,
+  IN  UINTN                          Offset,
   OUT UINT32                         *OriginalValue,
   OUT UINT32                         *Value
 )
 {
-  UINTN   PciAddress;
-
-  PciAddress = (UINTN)Address;
+  BOOLEAN  InterruptState;
 
   //
   // Preserve the original value
   //
-  *OriginalValue = PciRead32 (PciAddress);
+  *OriginalValue = PciConfigRead32 (Bus, Device, Function, Offset);
 
   //
   // Disable timer interrupt while the BAR is probed
   //
-  DisableInterrupts ();
+  InterruptState = SaveAndDisableInterrupts ();
 
-  PciWrite32 (PciAddress, 0xFFFFFFFF);
-  *Value = PciRead32 (PciAddress);
-  PciWrite32 (PciAddress, *OriginalValue);
+  PciConfigWrite32 (Bus, Device, Function, Offset, 0xFFFFFFFF);
+  *Value = PciConfigRead32 (Bus, Device, Function, Offset);
+  PciConfigWrite32 (Bus, Device, Function, Offset, *OriginalValue);
 
   //
-  // Enable interrupt
+  // Restore interrupt, it stays disabled on an AP
   //
-  EnableInterrupts ();
+  SetInterruptState (InterruptState);
+}
+
+/**
+  Extend an aperture to cover a range.
+
+  @param[in]  Aperture         The aperture.
+
+  @param[in]  Base             Base of the range.
+
+  @param[in]  Limit            Limit of the range.
+**/
+STATIC
+VOID
+PcatPciRootBridgeAddRange (
+  IN PCI_ROOT_BRIDGE_APERTURE       *Aperture,
+  IN UINT64                         Base,
+  IN UINT64                         Limit
+)
+{
+  if ((Base > 0) && (Base < Limit)) {
+    if (Aperture->Base > Base) {
+      Aperture->Base = Base;
+    }
+    if (Aperture->Limit < Limit) {
+      Aperture->Limit = Limit;
+    }
+  }
+}
+
+/**
+  Collect the resources of a PCI function without sizing its BARs.
+
+  The bootloader already assigned the resources, so they are taken from its PCI
+  resource HOB. A function the HOB does not describe, including a bridge whose
+  own BARs are outside the windows read by the caller, has its BARs sized.
+
+  @param[in]  Command          Supported attributes.
+
+  @param[in]  Bus              PCI bus number.
+
+  @param[in]  Device           PCI device number.
+
+  @param[in]  Function         PCI function number.
+
+  @param[in]  Io               IO aperture.
+
+  @param[in]  Mem              MMIO aperture.
+
+  @param[in]  MemAbove4G       MMIO aperture above 4G.
+
+  @param[in]  PMem             Prefetchable MMIO aperture.
+
+  @param[in]  PMemAbove4G      Prefetchable MMIO aperture above 4G.
+
+  @retval TRUE                 The resources of the function were collected.
+  @retval FALSE                The BARs of the function have to be sized.
+**/
+STATIC
+BOOLEAN
+PcatPciRootBridgeCollectTrustedBars (
+  IN UINT16                         Command,
+  IN UINTN                          Bus,
+  IN UINTN                          Device,
+  IN UINTN                          Function,
+  IN PCI_ROOT_BRIDGE_APERTURE       *Io,
+  IN PCI_ROOT_BRIDGE_APERTURE       *Mem,
+  IN PCI_ROOT_BRIDGE_APERTURE       *MemAbove4G,
+  IN PCI_ROOT_BRIDGE_APERTURE       *PMem,
+  IN PCI_ROOT_BRIDGE_APERTURE       *PMemAbove4G
+)
+{
+  PCI_RESOURCE_DESCRIPTOR           *Descriptor;
+  PCI_ROOT_BRIDGE_APERTURE          *Aperture;
+  UINTN                             Index;
+  BOOLEAN                           Found;
+
+  if (mPciResourceInfo == NULL) {
+    return FALSE;
+  }
+
+  Found      = FALSE;
+  Descriptor = (PCI_RESOURCE_DESCRIPTOR *) (mPciResourceInfo + 1);
+  for (Index = 0; Index < mPciResourceInfo->Count; Index++, Descriptor++) {
+    if ((Descriptor->Bus != Bus) || (Descriptor->Device != Device) ||
+        (Descriptor->Function != Function) || (Descriptor->Length == 0)) {
+      continue;
+    }
+    Found = TRUE;
+
+    switch (Descriptor->Type) {
+    case PCI_RESOURCE_TYPE_IO:
+      Aperture = ((Command & EFI_PCI_COMMAND_IO_SPACE) != 0) ? Io : NULL;
+      break;
+    case PCI_RESOURCE_TYPE_MEM32:
+      Aperture = Mem;
+      break;
+    case PCI_RESOURCE_TYPE_PMEM32:
+      Aperture = PMem;
+      break;
+    case PCI_RESOURCE_TYPE_MEM64:
+      Aperture = MemAbove4G;
+      break;
+    case PCI_RESOURCE_TYPE_PMEM64:
+      Aperture = PMemAbove4G;
+      break;
+    default:
+      Aperture = NULL;
+      break;
+    }
+    if ((Descriptor->Type != PCI_RESOURCE_TYPE_IO) &&
+        ((Command & EFI_PCI_COMMAND_MEMORY_SPACE) == 0)) {
+      Aperture = NULL;
+    }
+
+    if (Aperture != NULL) {
+      PcatPciRootBridgeAddRange (
+        Aperture,
+        Descriptor->Base,
+        Descriptor->Base + Descriptor->Length - 1
+      );
+    }
+  }
+
+  return Found;
+}
+
+/**
+  Check that an aperture built from the bootloader resources covers the range
+  found by sizing the BARs.
+
+  @param[in]  Name             Name of the aperture.
+
+  @param[in]  RootBus          The root bus number.
+
+  @param[in]  Trusted          The aperture built without sizing BARs.
+
+  @param[in]  Sized            The aperture built by sizing BARs.
+**/
+STATIC
+VOID
+PcatPciRootBridgeVerifyAperture (
+  IN CHAR8                          *Name,
+  IN UINTN                          RootBus,
+  IN PCI_ROOT_BRIDGE_APERTURE       *Trusted,
+  IN PCI_ROOT_BRIDGE_APERTURE       *Sized
+)
+{
+  if (Sized->Base == MAX_UINT64) {
+    return;
+  }
+
+  if ((Trusted->Base > Sized->Base) || (Trusted->Limit < Sized->Limit)) {
+    DEBUG ((
+      DEBUG_WARN, "PCI root bus 0x%x %a aperture [0x%lx, 0x%lx] misses sized BARs [0x%lx, 0x%lx]\n",
+      (UINT32) RootBus, Name, Trusted->Base, Trusted->Limit, Sized->Base, Sized->Limit
+      ));
+  }
 }
 
 /**
@@ -201,7 +373,7 @@ PcatPciRootBridgeParseBars (
 
   for (Offset = BarOffsetBase; Offset < BarOffsetEnd; Offset += sizeof (UINT32)) {
     PcatPciRootBridgeBarExisted (
-      PCI_LIB_ADDRESS (Bus, Device, Function, Offset),
+      Bus, Device, Function, Offset,
       &OriginalValue, &Value
     );
     if (Value == 0) {
@@ -256,7 +428,7 @@ PcatPciRootBridgeParseBars (
           //
           Offset += 4;
           PcatPciRootBridgeBarExisted (
-            PCI_LIB_ADDRESS (Bus, Device, Function, Offset),
+            Bus, Device, Function, Offset,
             &OriginalUpperValue,
             &UpperValue
           );
@@ -290,207 +462,243 @@ PcatPciRootBridgeParseBars (
 }
 
 /**
-  Scan for all root bridges in platform.
+  Find the bus range of the PCI root bridge on a primary bus.
 
-  @param[out] NumberOfRootBridges  Number of root bridges detected
+  Only the registers needed to find the devices and the bus numbers of the
+  bridges are read.
 
-  @retval     Pointer to the allocated PCI_ROOT_BRIDGE structure array.
+  @param[in]  PrimaryBus       The primary bus to probe.
+
+  @param[in]  MaxBus           The last bus the host bridge decodes.
+
+  @param[out] SubBus           The last bus behind the root bridge.
+
+  @retval TRUE                 A PCI root bridge exists on the primary bus.
+  @retval FALSE                No PCI device was found on the primary bus.
 **/
-PCI_ROOT_BRIDGE *
-ScanForRootBridges (
-  OUT UINTN      *NumberOfRootBridges
+STATIC
+BOOLEAN
+FindRootBridgeBusRange (
+  IN  UINTN      PrimaryBus,
+  IN  UINTN      MaxBus,
+  OUT UINTN      *SubBus
 )
 {
-  UINTN      PrimaryBus;
-  UINTN      SubBus;
   UINT8      Device;
   UINT8      Function;
   UINTN      NumberOfDevices;
-  UINTN      Address;
   PCI_TYPE01 Pci;
-  UINT64     Attributes;
+  UINT32     *Buffer;
+
+  *SubBus = PrimaryBus;
+  Buffer  = (UINT32 *) &Pci;
+
+  for (Device = 0, NumberOfDevices = 0; Device <= PCI_MAX_DEVICE; Device++) {
+
+    for (Function = 0; Function <= PCI_MAX_FUNC; Function++) {
+
+      Buffer[0] = PciConfigRead32 (PrimaryBus, Device, Function, 0);
+      if (Pci.Hdr.VendorId == MAX_UINT16) {
+        if (Function == 0) {
+          break;
+        } else {
+          continue;
+        }
+      }
+
+      NumberOfDevices++;
+
+      //
+      // Class code and header type
+      //
+      Buffer[2] = PciConfigRead32 (PrimaryBus, Device, Function, 8);
+      Buffer[3] = PciConfigRead32 (PrimaryBus, Device, Function, 12);
+
+      if (IS_PCI_BRIDGE (&Pci)) {
+        //
+        // Primary, secondary and subordinate bus numbers
+        //
+        Buffer[6] = PciConfigRead32 (PrimaryBus, Device, Function, OFFSET_OF (PCI_TYPE01, Bridge.PrimaryBus));
+        if (Pci.Bridge.SubordinateBus > *SubBus &&
+            Pci.Bridge.SubordinateBus <= MaxBus) {
+          //
+          // If the suborinate bus number of the PCI-PCI bridge is greater
+          // than the PCI root bridge's current subordinate bus number,
+          // then update the PCI root bridge's subordinate bus number
+          //
+          *SubBus = Pci.Bridge.SubordinateBus;
+        }
+      }
+
+      if (Function == 0 && !IS_PCI_MULTI_FUNC (&Pci)) {
+        break;
+      }
+    }
+  }
+
+  return (BOOLEAN) (NumberOfDevices > 0);
+}
+
+/**
+  Collect the attributes and the resources of a PCI root bridge from the
+  devices on its primary bus.
+
+  The function may run on an AP, so it does not print and only uses the
+  configuration access functions, which are MP safe on ECAM.
+
+  @param[in, out] Scan         The root bridge, with its bus range filled in.
+**/
+STATIC
+VOID
+ScanRootBridgeResource (
+  IN OUT PCI_ROOT_BRIDGE_SCAN  *Scan
+)
+{
+  UINTN      PrimaryBus;
+  UINT8      Device;
+  UINT8      Function;
+  UINT32     Id;
+  PCI_TYPE01 Pci;
   UINT64     Base;
   UINT64     Limit;
   UINT64     Value;
-  PCI_ROOT_BRIDGE_APERTURE Io, Mem, MemAbove4G, PMem, PMemAbove4G, *MemAperture;
-  PCI_ROOT_BRIDGE *RootBridges;
+  PCI_ROOT_BRIDGE_RESOURCE *Resource;
+  PCI_ROOT_BRIDGE_RESOURCE *SizedResource;
+  PCI_ROOT_BRIDGE_APERTURE *MemAperture;
   UINTN      BarOffsetEnd;
+  BOOLEAN    Trusted;
 
-
-  *NumberOfRootBridges = 0;
-  RootBridges = NULL;
+  PrimaryBus    = Scan->RootBus;
+  Resource      = &Scan->Resource;
+  SizedResource = &Scan->SizedResource;
 
   //
-  // After scanning all the PCI devices on the PCI root bridge's primary bus,
-  // update the Primary Bus Number for the next PCI root bridge to be this PCI
-  // root bridge's subordinate bus number + 1.
+  // Scan all the PCI devices on the primary bus of the PCI root bridge
   //
-  for (PrimaryBus = 0; PrimaryBus <= PCI_MAX_BUS; PrimaryBus = SubBus + 1) {
-    SubBus = PrimaryBus;
-    Attributes = 0;
-
-    ZeroMem (&Io, sizeof (Io));
-    ZeroMem (&Mem, sizeof (Mem));
-    ZeroMem (&MemAbove4G, sizeof (MemAbove4G));
-    ZeroMem (&PMem, sizeof (PMem));
-    ZeroMem (&PMemAbove4G, sizeof (PMemAbove4G));
-    Io.Base = Mem.Base = MemAbove4G.Base = PMem.Base = PMemAbove4G.Base = MAX_UINT64;
-    //
-    // Scan all the PCI devices on the primary bus of the PCI root bridge
-    //
-    for (Device = 0, NumberOfDevices = 0; Device <= PCI_MAX_DEVICE; Device++) {
+  for (Device = 0; Device <= PCI_MAX_DEVICE; Device++) {
 
-      for (Function = 0; Function <= PCI_MAX_FUNC; Function++) {
+    for (Function = 0; Function <= PCI_MAX_FUNC; Function++) {
 
-        //
-        // Compute the PCI configuration address of the PCI device to probe
-        //
-        Address = PCI_LIB_ADDRESS (PrimaryBus, Device, Function, 0);
+      //
+      // Read the Vendor ID and Device ID from the PCI Configuration Header
+      //
+      Id = PciConfigRead32 (PrimaryBus, Device, Function, 0);
+      if ((UINT16) Id == MAX_UINT16) {
+        if (Function == 0) {
+          //
+          // If the PCI Configuration Read fails, or a PCI device does not
+          // exist, then skip this entire PCI device
+          //
+          break;
+        } else {
+          //
+          // If PCI function != 0, VendorId == 0xFFFF, we continue to search
+          // PCI function.
+          //
+          continue;
+        }
+      }
 
+      //
+      // Read the rest of the PCI Configuration Header
+      //
+      PciConfigReadHeader (PrimaryBus, Device, Function, Id, &Pci);
+
+      //
+      // Look for devices with the VGA Palette Snoop enabled in the COMMAND
+      // register of the PCI Config Header
+      //
+      if ((Pci.Hdr.Command & EFI_PCI_COMMAND_VGA_PALETTE_SNOOP) != 0) {
+        Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO;
+        Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO_16;
+      }
+
+      BarOffsetEnd = 0;
+
+      //
+      // PCI-PCI Bridge
+      //
+      if (IS_PCI_BRIDGE (&Pci)) {
         //
-        // Read the Vendor ID from the PCI Configuration Header
+        // Get the I/O range that the PPB is decoding
         //
-        if (PciRead16 (Address) == MAX_UINT16) {
-          if (Function == 0) {
-            //
-            // If the PCI Configuration Read fails, or a PCI device does not
-            // exist, then skip this entire PCI device
-            //
-            break;
-          } else {
-            //
-            // If PCI function != 0, VendorId == 0xFFFF, we continue to search
-            // PCI function.
-            //
-            continue;
-          }
+        Value = Pci.Bridge.IoBase & 0x0f;
+        Base = ((UINT32) Pci.Bridge.IoBase & 0xf0) << 8;
+        Limit = (((UINT32) Pci.Bridge.IoLimit & 0xf0) << 8) | 0x0fff;
+        if (Value == BIT0) {
+          Base |= (UINT64)((UINT32) Pci.Bridge.IoBaseUpper16 << 16);
+          Limit |= (UINT64)((UINT32) Pci.Bridge.IoLimitUpper16 << 16);
         }
+        PcatPciRootBridgeAddRange (&Resource->Io, Base, Limit);
 
         //
-        // Read the entire PCI Configuration Header
+        // Get the Memory range that the PPB is decoding
         //
-        PciReadBuffer (Address, sizeof (Pci), &Pci);
+        Base = ((UINT32) Pci.Bridge.MemoryBase & 0xfff0) << 16;
+        Limit = (((UINT32) Pci.Bridge.MemoryLimit & 0xfff0) << 16) | 0xfffff;
+        PcatPciRootBridgeAddRange (&Resource->Mem, Base, Limit);
 
         //
-        // Increment the number of PCI device found on the primary bus of the
-        // PCI root bridge
+        // Get the Prefetchable Memory range that the PPB is decoding
         //
-        NumberOfDevices++;
+        Value = Pci.Bridge.PrefetchableMemoryBase & 0x0f;
+        Base = ((UINT32) Pci.Bridge.PrefetchableMemoryBase & 0xfff0) << 16;
+        Limit = (((UINT32) Pci.Bridge.PrefetchableMemoryLimit & 0xfff0)
+                 << 16) | 0xfffff;
+        MemAperture = &Resource->PMem;
+        if (Value == BIT0) {
+          Base |= LShiftU64 (Pci.Bridge.PrefetchableBaseUpper32, 32);
+          Limit |= LShiftU64 (Pci.Bridge.PrefetchableLimitUpper32, 32);
+          MemAperture = &Resource->PMemAbove4G;
+        }
+        PcatPciRootBridgeAddRange (MemAperture, Base, Limit);
 
         //
-        // Look for devices with the VGA Palette Snoop enabled in the COMMAND
-        // register of the PCI Config Header
+        // Look at the PPB Configuration for legacy decoding attributes
         //
-        if ((Pci.Hdr.Command & EFI_PCI_COMMAND_VGA_PALETTE_SNOOP) != 0) {
-          Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO;
-          Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO_16;
+        if ((Pci.Bridge.BridgeControl & EFI_PCI_BRIDGE_CONTROL_ISA)
+            == EFI_PCI_BRIDGE_CONTROL_ISA) {
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO;
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO_16;
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_ISA_MOTHERBOARD_IO;
+        }
+        if ((Pci.Bridge.BridgeControl & EFI_PCI_BRIDGE_CONTROL_VGA)
+            == EFI_PCI_BRIDGE_CONTROL_VGA) {
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO;
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_MEMORY;
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO;
+          if ((Pci.Bridge.BridgeControl & EFI_PCI_BRIDGE_CONTROL_VGA_16)
+              != 0) {
+            Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO_16;
+            Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO_16;
+          }
         }
 
-        BarOffsetEnd = 0;
-
+        BarOffsetEnd = OFFSET_OF (PCI_TYPE01, Bridge.Bar[2]);
+      } else {
         //
-        // PCI-PCI Bridge
+        // Parse the BARs of the PCI device to get what I/O Ranges, Memory
+        // Ranges, and Prefetchable Memory Ranges the device is decoding
         //
-        if (IS_PCI_BRIDGE (&Pci)) {
-          //
-          // Get the Bus range that the PPB is decoding
-          //
-          if (Pci.Bridge.SubordinateBus > SubBus) {
-            //
-            // If the suborinate bus number of the PCI-PCI bridge is greater
-            // than the PCI root bridge's current subordinate bus number,
-            // then update the PCI root bridge's subordinate bus number
-            //
-            SubBus = Pci.Bridge.SubordinateBus;
-          }
-
-          //
-          // Get the I/O range that the PPB is decoding
-          //
-          Value = Pci.Bridge.IoBase & 0x0f;
-          Base = ((UINT32) Pci.Bridge.IoBase & 0xf0) << 8;
-          Limit = (((UINT32) Pci.Bridge.IoLimit & 0xf0) << 8) | 0x0fff;
-          if (Value == BIT0) {
-            Base |= (UINT64)((UINT32) Pci.Bridge.IoBaseUpper16 << 16);
-            Limit |= (UINT64)((UINT32) Pci.Bridge.IoLimitUpper16 << 16);
-          }
-          if ((Base > 0) && (Base < Limit)) {
-            if (Io.Base > Base) {
-              Io.Base = Base;
-            }
-            if (Io.Limit < Limit) {
-              Io.Limit = Limit;
-            }
-          }
-
-          //
-          // Get the Memory range that the PPB is decoding
-          //
-          Base = ((UINT32) Pci.Bridge.MemoryBase & 0xfff0) << 16;
-          Limit = (((UINT32) Pci.Bridge.MemoryLimit & 0xfff0) << 16) | 0xfffff;
-          if ((Base > 0) && (Base < Limit)) {
-            if (Mem.Base > Base) {
-              Mem.Base = Base;
-            }
-            if (Mem.Limit < Limit) {
-              Mem.Limit = Limit;
-            }
-          }
-
-          //
-          // Get the Prefetchable Memory range that the PPB is decoding
-          //
-          Value = Pci.Bridge.PrefetchableMemoryBase & 0x0f;
-          Base = ((UINT32) Pci.Bridge.PrefetchableMemoryBase & 0xfff0) << 16;
-          Limit = (((UINT32) Pci.Bridge.PrefetchableMemoryLimit & 0xfff0)
-                   << 16) | 0xfffff;
-          MemAperture = &PMem;
-          if (Value == BIT0) {
-            Base |= LShiftU64 (Pci.Bridge.PrefetchableBaseUpper32, 32);
-            Limit |= LShiftU64 (Pci.Bridge.PrefetchableLimitUpper32, 32);
-            MemAperture = &PMemAbove4G;
-          }
-          if ((Base > 0) && (Base < Limit)) {
-            if (MemAperture->Base > Base) {
-              MemAperture->Base = Base;
-            }
-            if (MemAperture->Limit < Limit) {
-              MemAperture->Limit = Limit;
-            }
-          }
-
-          //
-          // Look at the PPB Configuration for legacy decoding attributes
-          //
-          if ((Pci.Bridge.BridgeControl & EFI_PCI_BRIDGE_CONTROL_ISA)
-              == EFI_PCI_BRIDGE_CONTROL_ISA) {
-            Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO;
-            Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO_16;
-            Attributes |= EFI_PCI_ATTRIBUTE_ISA_MOTHERBOARD_IO;
-          }
-          if ((Pci.Bridge.BridgeControl & EFI_PCI_BRIDGE_CONTROL_VGA)
-              == EFI_PCI_BRIDGE_CONTROL_VGA) {
-            Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO;
-            Attributes |= EFI_PCI_ATTRIBUTE_VGA_MEMORY;
-            Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO;
-            if ((Pci.Bridge.BridgeControl & EFI_PCI_BRIDGE_CONTROL_VGA_16)
-                != 0) {
-              Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO_16;
-              Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO_16;
-            }
-          }
-
-          BarOffsetEnd = OFFSET_OF (PCI_TYPE01, Bridge.Bar[2]);
-        } else {
-          //
-          // Parse the BARs of the PCI device to get what I/O Ranges, Memory
-          // Ranges, and Prefetchable Memory Ranges the device is decoding
-          //
-          if ((Pci.Hdr.HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_DEVICE) {
-            BarOffsetEnd = OFFSET_OF (PCI_TYPE00, Device.Bar[6]);
-          }
+        if ((Pci.Hdr.HeaderType & HEADER_LAYOUT_CODE) == HEADER_TYPE_DEVICE) {
+          BarOffsetEnd = OFFSET_OF (PCI_TYPE00, Device.Bar[6]);
         }
+      }
+
+      Trusted = FALSE;
+      if (FeaturePcdGet (PcdPciTrustBootloaderResources)) {
+        Trusted = PcatPciRootBridgeCollectTrustedBars (
+                    Pci.Hdr.Command,
+                    PrimaryBus,
+                    Device,
+                    Function,
+                    &Resource->Io,
+                    &Resource->Mem, &Resource->MemAbove4G,
+                    &Resource->PMem, &Resource->PMemAbove4G
+                  );
+      }
 
+      if (!Trusted) {
         PcatPciRootBridgeParseBars (
           Pci.Hdr.Command,
           PrimaryBus,
@@ -498,93 +706,283 @@ ScanForRootBridges (
           Function,
           OFFSET_OF (PCI_TYPE00, Device.Bar),
           BarOffsetEnd,
-          &Io,
-          &Mem, &MemAbove4G,
-          &PMem, &PMemAbove4G
+          &Resource->Io,
+          &Resource->Mem, &Resource->MemAbove4G,
+          &Resource->PMem, &Resource->PMemAbove4G
         );
-
+      } else {
         //
-        // See if the PCI device is an IDE controller
+        // Size the BARs anyway in DEBUG builds to verify the apertures
         //
-        if (IS_CLASS2 (&Pci, PCI_CLASS_MASS_STORAGE,
-                       PCI_CLASS_MASS_STORAGE_IDE)) {
-          if (Pci.Hdr.ClassCode[0] & 0x80) {
-            Attributes |= EFI_PCI_ATTRIBUTE_IDE_PRIMARY_IO;
-            Attributes |= EFI_PCI_ATTRIBUTE_IDE_SECONDARY_IO;
-          }
-          if (Pci.Hdr.ClassCode[0] & 0x01) {
-            Attributes |= EFI_PCI_ATTRIBUTE_IDE_PRIMARY_IO;
-          }
-          if (Pci.Hdr.ClassCode[0] & 0x04) {
-            Attributes |= EFI_PCI_ATTRIBUTE_IDE_SECONDARY_IO;
-          }
-        }
+        DEBUG_CODE_BEGIN ();
+        PcatPciRootBridgeParseBars (
+          Pci.Hdr.Command,
+          PrimaryBus,
+          Device,
+          Function,
+          OFFSET_OF (PCI_TYPE00, Device.Bar),
+          BarOffsetEnd,
+          &SizedResource->Io,
+          &SizedResource->Mem, &SizedResource->MemAbove4G,
+          &SizedResource->PMem, &SizedResource->PMemAbove4G
+        );
+        DEBUG_CODE_END ();
+      }
 
-        //
-        // See if the PCI device is a legacy VGA controller or
-        // a standard VGA controller
-        //
-        if (IS_CLASS2 (&Pci, PCI_CLASS_OLD, PCI_CLASS_OLD_VGA) ||
-            IS_CLASS2 (&Pci, PCI_CLASS_DISPLAY, PCI_CLASS_DISPLAY_VGA)
-           ) {
-          Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO;
-          Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO_16;
-          Attributes |= EFI_PCI_ATTRIBUTE_VGA_MEMORY;
-          Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO;
-          Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO_16;
+      //
+      // See if the PCI device is an IDE controller
+      //
+      if (IS_CLASS2 (&Pci, PCI_CLASS_MASS_STORAGE,
+                     PCI_CLASS_MASS_STORAGE_IDE)) {
+        if (Pci.Hdr.ClassCode[0] & 0x80) {
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_IDE_PRIMARY_IO;
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_IDE_SECONDARY_IO;
         }
-
-        //
-        // See if the PCI Device is a PCI - ISA or PCI - EISA
-        // or ISA_POSITIVIE_DECODE Bridge device
-        //
-        if (Pci.Hdr.ClassCode[2] == PCI_CLASS_BRIDGE) {
-          if (Pci.Hdr.ClassCode[1] == PCI_CLASS_BRIDGE_ISA ||
-              Pci.Hdr.ClassCode[1] == PCI_CLASS_BRIDGE_EISA ||
-              Pci.Hdr.ClassCode[1] == PCI_CLASS_BRIDGE_ISA_PDECODE) {
-            Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO;
-            Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO_16;
-            Attributes |= EFI_PCI_ATTRIBUTE_ISA_MOTHERBOARD_IO;
-          }
+        if (Pci.Hdr.ClassCode[0] & 0x01) {
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_IDE_PRIMARY_IO;
+        }
+        if (Pci.Hdr.ClassCode[0] & 0x04) {
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_IDE_SECONDARY_IO;
         }
+      }
 
-        //
-        // If this device is not a multi function device, then skip the rest
-        // of this PCI device
-        //
-        if (Function == 0 && !IS_PCI_MULTI_FUNC (&Pci)) {
-          break;
+      //
+      // See if the PCI device is a legacy VGA controller or
+      // a standard VGA controller
+      //
+      if (IS_CLASS2 (&Pci, PCI_CLASS_OLD, PCI_CLASS_OLD_VGA) ||
+          IS_CLASS2 (&Pci, PCI_CLASS_DISPLAY, PCI_CLASS_DISPLAY_VGA)
+         ) {
+        Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO;
+        Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_PALETTE_IO_16;
+        Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_MEMORY;
+        Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO;
+        Scan->Attributes |= EFI_PCI_ATTRIBUTE_VGA_IO_16;
+      }
+
+      //
+      // See if the PCI Device is a PCI - ISA or PCI - EISA
+      // or ISA_POSITIVIE_DECODE Bridge device
+      //
+      if (Pci.Hdr.ClassCode[2] == PCI_CLASS_BRIDGE) {
+        if (Pci.Hdr.ClassCode[1] == PCI_CLASS_BRIDGE_ISA ||
+            Pci.Hdr.ClassCode[1] == PCI_CLASS_BRIDGE_EISA ||
+            Pci.Hdr.ClassCode[1] == PCI_CLASS_BRIDGE_ISA_PDECODE) {
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO;
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_ISA_IO_16;
+          Scan->Attributes |= EFI_PCI_ATTRIBUTE_ISA_MOTHERBOARD_IO;
         }
       }
+
+      //
+      // If this device is not a multi function device, then skip the rest
+      // of this PCI device
+      //
+      if (Function == 0 && !IS_PCI_MULTI_FUNC (&Pci)) {
+        break;
+      }
     }
+  }
+}
+
+/**
+  Collect the resources of the root bridges in a scan table until none is left.
+
+  Called on the APs and then on the BSP, which picks up what the APs did not do.
+
+  @param[in]  Buffer           The PCI_ROOT_BRIDGE_SCAN_CONTEXT.
+**/
+STATIC
+VOID
+EFIAPI
+ScanRootBridgeResourceWorker (
+  IN VOID        *Buffer
+)
+{
+  PCI_ROOT_BRIDGE_SCAN_CONTEXT   *Context;
+  UINT32                         Index;
+
+  Context = (PCI_ROOT_BRIDGE_SCAN_CONTEXT *) Buffer;
+  for (;;) {
+    Index = InterlockedIncrement (&Context->Next) - 1;
+    if (Index >= Context->Count) {
+      break;
+    }
+    ScanRootBridgeResource (&Context->Table[Index]);
+  }
+}
+
+/**
+  Scan for all root bridges in platform.
+
+  The root bridges and their bus ranges are found first and kept in a table on
+  the stack. Their resources are then collected, one root bridge per AP when
+  there are several and the configuration space can be accessed from several
+  processors at once, and a single PCI_ROOT_BRIDGE array is allocated at the end.
+
+  @param[out] NumberOfRootBridges  Number of root bridges detected
+
+  @retval     Pointer to the allocated PCI_ROOT_BRIDGE structure array.
+**/
+PCI_ROOT_BRIDGE *
+ScanForRootBridges (
+  OUT UINTN      *NumberOfRootBridges
+)
+{
+  EFI_STATUS                    Status;
+  UINTN                         PrimaryBus;
+  UINTN                         SubBus;
+  UINTN                         MaxBus;
+  UINTN                         Index;
+  PCI_ROOT_BRIDGE_SCAN          Table[PCI_MAX_ROOT_BRIDGES];
+  PCI_ROOT_BRIDGE_SCAN          *Scan;
+  PCI_ROOT_BRIDGE_SCAN_CONTEXT  Context;
+  PCI_ROOT_BRIDGE               *RootBridges;
+  EFI_MP_SERVICES_PROTOCOL      *MpService;
+  BOOLEAN                       UseAps;
+  EFI_HOB_GUID_TYPE             *GuidHob;
+
+
+  *NumberOfRootBridges = 0;
+
+  //
+  // Use ECAM when it is available, and do not probe buses the host bridge
+  // does not decode
+  //
+  MaxBus = PciConfigAccessInitialize ();
+
+  //
+  // The bootloader enumerated the bus, so its resource assignment can be used
+  // instead of sizing the BARs again
+  //
+  mPciResourceInfo = NULL;
+  if (FeaturePcdGet (PcdPciTrustBootloaderResources)) {
+    GuidHob = GetFirstGuidHob (&gUefiPciResourceInfoGuid);
+    if (GuidHob != NULL) {
+      mPciResourceInfo = (PCI_RESOURCE_INFO *) GET_GUID_HOB_DATA (GuidHob);
+    }
+    DEBUG ((DEBUG_INFO, "PCI scan trusts bootloader resources, resource HOB %a\n", (mPciResourceInfo != NULL) ? "found" : "not found"));
+  }
+
+  //
+  // Phase one: find the root bridges and their bus ranges.
+  //
+  // After scanning all the PCI devices on the PCI root bridge's primary bus,
+  // update the Primary Bus Number for the next PCI root bridge to be this PCI
+  // root bridge's subordinate bus number + 1. The buses behind the bridges of
+  // a root bridge are never probed for another root bridge.
+  //
+  Context.Table = Table;
+  Context.Count = 0;
+  Context.Next  = 0;
+  UseAps        = TRUE;
+  for (PrimaryBus = 0; PrimaryBus <= MaxBus; PrimaryBus = SubBus + 1) {
+    if (!FindRootBridgeBusRange (PrimaryBus, MaxBus, &SubBus)) {
+      continue;
+    }
+
+    if (Context.Count == PCI_MAX_ROOT_BRIDGES) {
+      DEBUG ((DEBUG_ERROR, "PCI root bridge table is full, bus 0x%x and above are ignored\n", (UINT32) PrimaryBus));
+      ASSERT (FALSE);
+      break;
+    }
+
+    Scan = &Table[Context.Count];
+    ZeroMem (Scan, sizeof (*Scan));
+    Scan->RootBus = (UINT8) PrimaryBus;
+    Scan->SubBus  = (UINT8) SubBus;
+    Scan->Resource.Io.Base          = MAX_UINT64;
+    Scan->Resource.Mem.Base         = MAX_UINT64;
+    Scan->Resource.MemAbove4G.Base  = MAX_UINT64;
+    Scan->Resource.PMem.Base        = MAX_UINT64;
+    Scan->Resource.PMemAbove4G.Base = MAX_UINT64;
+    CopyMem (&Scan->SizedResource, &Scan->Resource, sizeof (Scan->SizedResource));
+    Context.Count++;
 
     //
-    // If at least one PCI device was found on the primary bus of this PCI
-    // root bridge, then the PCI root bridge exists.
+    // CF8/CFC takes two accesses per cycle and cannot be shared by processors
     //
-    if (NumberOfDevices > 0) {
-      RootBridges = ReallocatePool (
-                      (*NumberOfRootBridges) * sizeof (PCI_ROOT_BRIDGE),
-                      (*NumberOfRootBridges + 1) * sizeof (PCI_ROOT_BRIDGE),
-                      RootBridges
-                    );
-      ASSERT (RootBridges != NULL);
-
-      AdjustRootBridgeResource (&Io, &Mem, &MemAbove4G, &PMem, &PMemAbove4G);
-
-      InitRootBridge (
-        Attributes, Attributes, 0,
-        (UINT8) PrimaryBus, (UINT8) SubBus,
-        &Io, &Mem, &MemAbove4G, &PMem, &PMemAbove4G,
-        &RootBridges[*NumberOfRootBridges]
+    if (!PciConfigAccessIsMpSafe (PrimaryBus)) {
+      UseAps = FALSE;
+    }
+  }
+
+  if (Context.Count == 0) {
+    DEBUG ((DEBUG_INFO, "PCI scan found no root bridge with %d config cycles\n", mPciConfigCycles));
+    return NULL;
+  }
+
+  //
+  // Collect the resources of the root bridges
+  //
+  if (UseAps && Context.Count > 1) {
+    Status = gBS->LocateProtocol (&gEfiMpServiceProtocolGuid, NULL, (VOID **) &MpService);
+    if (!EFI_ERROR (Status)) {
+      Status = MpService->StartupAllAPs (
+                            MpService,
+                            ScanRootBridgeResourceWorker,
+                            FALSE,
+                            NULL,
+                            0,
+                            &Context,
+                            NULL
+                            );
+    }
+    if (EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "PCI root bridges are scanned on the BSP: %r\n", Status));
+    }
+  }
+  ScanRootBridgeResourceWorker (&Context);
+
+  //
+  // Phase two: build the PCI_ROOT_BRIDGE array in a single allocation
+  //
+  RootBridges = AllocateZeroPool (Context.Count * sizeof (PCI_ROOT_BRIDGE));
+  ASSERT (RootBridges != NULL);
+  if (RootBridges == NULL) {
+    return NULL;
+  }
+
+  for (Index = 0; Index < Context.Count; Index++) {
+    Scan = &Table[Index];
+
+    AdjustRootBridgeResource (
+      &Scan->Resource.Io,
+      &Scan->Resource.Mem, &Scan->Resource.MemAbove4G,
+      &Scan->Resource.PMem, &Scan->Resource.PMemAbove4G
+    );
+
+    DEBUG_CODE_BEGIN ();
+    if (FeaturePcdGet (PcdPciTrustBootloaderResources)) {
+      AdjustRootBridgeResource (
+        &Scan->SizedResource.Io,
+        &Scan->SizedResource.Mem, &Scan->SizedResource.MemAbove4G,
+        &Scan->SizedResource.PMem, &Scan->SizedResource.PMemAbove4G
       );
-      RootBridges[*NumberOfRootBridges].ResourceAssigned = TRUE;
-      //
-      // Increment the index for the next PCI Root Bridge
-      //
-      (*NumberOfRootBridges)++;
+      PcatPciRootBridgeVerifyAperture ("Io", Scan->RootBus, &Scan->Resource.Io, &Scan->SizedResource.Io);
+      PcatPciRootBridgeVerifyAperture ("Mem", Scan->RootBus, &Scan->Resource.Mem, &Scan->SizedResource.Mem);
+      PcatPciRootBridgeVerifyAperture ("MemAbove4G", Scan->RootBus, &Scan->Resource.MemAbove4G, &Scan->SizedResource.MemAbove4G);
+      PcatPciRootBridgeVerifyAperture ("PMem", Scan->RootBus, &Scan->Resource.PMem, &Scan->SizedResource.PMem);
+      PcatPciRootBridgeVerifyAperture ("PMemAbove4G", Scan->RootBus, &Scan->Resource.PMemAbove4G, &Scan->SizedResource.PMemAbove4G);
     }
+    DEBUG_CODE_END ();
+
+    InitRootBridge (
+      Scan->Attributes, Scan->Attributes, 0,
+      Scan->RootBus, Scan->SubBus,
+      &Scan->Resource.Io,
+      &Scan->Resource.Mem, &Scan->Resource.MemAbove4G,
+      &Scan->Resource.PMem, &Scan->Resource.PMemAbove4G,
+      &RootBridges[Index]
+    );
+    RootBridges[Index].ResourceAssigned = TRUE;
   }
+  *NumberOfRootBridges = Context.Count;
+
+  DEBUG ((
+    DEBUG_INFO, "PCI scan found %d root bridges with %d config cycles (%a)\n",
+    (UINT32) *NumberOfRootBridges, mPciConfigCycles, PciConfigAccessIsEcam () ? "ECAM" : "CF8"
+    ));
 
   return RootBridges;
 }
@@ -16,6 +16,19 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include "PlatformBootManager.h"
 #include "PlatformConsole.h"
 
+//
+// TRUE while only the consoles and the last boot device are connected
+//
+STATIC BOOLEAN    mFastBootConnected = FALSE;
+
+//
+// Key notifications of the Boot Manager Menu hotkeys, and whether one was pressed
+//
+STATIC EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL  *mFastBootTextInEx = NULL;
+STATIC volatile BOOLEAN                   mFastBootMenuRequested = FALSE;
+STATIC VOID                               *mFastBootF2NotifyHandle = NULL;
+STATIC VOID                               *mFastBootDownNotifyHandle = NULL;
+
 VOID
 InstallReadyToLock (
   VOID
@@ -145,6 +158,281 @@ PlatformRegisterFvBootOption (
   }
 }
 
+/**
+  Return TRUE if a load option launches an application built into a firmware
+  volume, such as the Shell or the Boot Manager Menu.
+
+  @param FilePath  The device path of the load option.
+**/
+BOOLEAN
+PlatformIsFvFilePath (
+  IN EFI_DEVICE_PATH_PROTOCOL      *FilePath
+)
+{
+  EFI_DEVICE_PATH_PROTOCOL          *Node;
+
+  for (Node = FilePath; !IsDevicePathEnd (Node); Node = NextDevicePathNode (Node)) {
+    if ((DevicePathType (Node) == MEDIA_DEVICE_PATH) &&
+        (DevicePathSubType (Node) == MEDIA_PIWG_FW_FILE_DP)) {
+      return TRUE;
+    }
+  }
+  return FALSE;
+}
+
+/**
+  Connect all devices and refresh the boot options if the fast boot path left
+  them unconnected.
+**/
+VOID
+PlatformFastBootConnectAll (
+  VOID
+)
+{
+  if (!mFastBootConnected) {
+    return;
+  }
+  mFastBootConnected = FALSE;
+
+  DEBUG ((DEBUG_INFO, "[FastBoot] Connect all devices\n"));
+  EfiBootManagerConnectAll ();
+  EfiBootManagerRefreshAllBootOption ();
+}
+
+/**
+  Remove the key notifications of the Boot Manager Menu hotkeys.
+**/
+VOID
+PlatformFastBootUnregisterHotkeys (
+  VOID
+)
+{
+  if (mFastBootTextInEx == NULL) {
+    return;
+  }
+
+  if (mFastBootF2NotifyHandle != NULL) {
+    mFastBootTextInEx->UnregisterKeyNotify (mFastBootTextInEx, mFastBootF2NotifyHandle);
+    mFastBootF2NotifyHandle = NULL;
+  }
+  if (mFastBootDownNotifyHandle != NULL) {
+    mFastBootTextInEx->UnregisterKeyNotify (mFastBootTextInEx, mFastBootDownNotifyHandle);
+    mFastBootDownNotifyHandle = NULL;
+  }
+  mFastBootTextInEx = NULL;
+}
+
+/**
+  Key notification of the Boot Manager Menu hotkeys. It may run at a raised TPL
+  in the middle of any BDS work, so it only records the request.
+
+  @param KeyData  The key that was pressed.
+**/
+EFI_STATUS
+EFIAPI
+PlatformFastBootOnHotkey (
+  IN EFI_KEY_DATA                  *KeyData
+)
+{
+  mFastBootMenuRequested = TRUE;
+  return EFI_SUCCESS;
+}
+
+/**
+  Connect all devices once a Boot Manager Menu hotkey was pressed, so that the
+  menu lists every boot device. Called from the BDS flow.
+**/
+VOID
+PlatformFastBootCheckHotkeys (
+  VOID
+)
+{
+  if (!mFastBootMenuRequested) {
+    return;
+  }
+
+  PlatformFastBootUnregisterHotkeys ();
+  PlatformFastBootConnectAll ();
+}
+
+/**
+  Remember the OS boot option being launched so that the next boot connects
+  only its device, and stop watching the Boot Manager Menu hotkeys.
+
+  The event is closed once an OS boot option has been remembered. Firmware
+  volume applications launched before it keep it open.
+
+  @param Event    The event.
+  @param Context  Not used.
+**/
+VOID
+EFIAPI
+PlatformFastBootOnReadyToBoot (
+  IN EFI_EVENT                     Event,
+  IN VOID                          *Context
+)
+{
+  EFI_STATUS                        Status;
+  UINT16                            *BootCurrent;
+  UINT16                            *FastBootOption;
+  UINTN                             Size;
+  CHAR16                            OptionName[sizeof ("Boot####")];
+  EFI_BOOT_MANAGER_LOAD_OPTION      Option;
+
+  PlatformFastBootUnregisterHotkeys ();
+
+  Status = GetEfiGlobalVariable2 (L"BootCurrent", (VOID **) &BootCurrent, NULL);
+  if (EFI_ERROR (Status) || BootCurrent == NULL) {
+    return;
+  }
+
+  UnicodeSPrint (OptionName, sizeof (OptionName), L"Boot%04x", *BootCurrent);
+  Status = EfiBootManagerVariableToLoadOption (OptionName, &Option);
+  if (!EFI_ERROR (Status)) {
+    //
+    // Firmware volume applications run before the OS option, skip them
+    //
+    if (!PlatformIsFvFilePath (Option.FilePath)) {
+      FastBootOption = NULL;
+      Size           = 0;
+      GetVariable2 (FAST_BOOT_OPTION_VARIABLE_NAME, &gUefiPayloadBootManagerGuid, (VOID **) &FastBootOption, &Size);
+      if (FastBootOption == NULL || Size != sizeof (UINT16) || *FastBootOption != *BootCurrent) {
+        gRT->SetVariable (
+               FAST_BOOT_OPTION_VARIABLE_NAME,
+               &gUefiPayloadBootManagerGuid,
+               EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+               sizeof (UINT16),
+               BootCurrent
+               );
+      }
+      if (FastBootOption != NULL) {
+        FreePool (FastBootOption);
+      }
+      gBS->CloseEvent (Event);
+    }
+    EfiBootManagerFreeLoadOption (&Option);
+  }
+
+  FreePool (BootCurrent);
+}
+
+/**
+  Connect only the device of the last OS boot option.
+
+  The consoles are already connected by BDS. Devices of the other boot options
+  are connected by BDS when it attempts them.
+
+  @retval TRUE   The last boot device is connected.
+  @retval FALSE  There is no last boot option, or its device cannot be
+                 connected without connecting everything.
+**/
+BOOLEAN
+PlatformFastBootConnect (
+  VOID
+)
+{
+  EFI_STATUS                        Status;
+  UINT16                            *FastBootOption;
+  UINTN                             Size;
+  CHAR16                            OptionName[sizeof ("Boot####")];
+  EFI_BOOT_MANAGER_LOAD_OPTION      Option;
+
+  Status = GetVariable2 (FAST_BOOT_OPTION_VARIABLE_NAME, &gUefiPayloadBootManagerGuid, (VOID **) &FastBootOption, &Size);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+  if (Size != sizeof (UINT16)) {
+    FreePool (FastBootOption);
+    return FALSE;
+  }
+
+  UnicodeSPrint (OptionName, sizeof (OptionName), L"Boot%04x", *FastBootOption);
+  FreePool (FastBootOption);
+
+  Status = EfiBootManagerVariableToLoadOption (OptionName, &Option);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  if ((Option.Attributes & LOAD_OPTION_ACTIVE) != 0) {
+    //
+    // A short-form device path, such as HD() or USB WWID, fails here and
+    // falls back to connecting everything
+    //
+    Status = EfiBootManagerConnectDevicePath (Option.FilePath, NULL);
+  } else {
+    Status = EFI_NOT_FOUND;
+  }
+  DEBUG ((DEBUG_INFO, "[FastBoot] Connect %s: %r\n", OptionName, Status));
+  EfiBootManagerFreeLoadOption (&Option);
+
+  return (BOOLEAN) !EFI_ERROR (Status);
+}
+
+/**
+  Catch the Boot Manager Menu hotkeys so that all devices are connected before
+  the menu lists the boot options.
+**/
+VOID
+PlatformFastBootRegisterHotkeys (
+  VOID
+)
+{
+  EFI_STATUS                        Status;
+  EFI_SIMPLE_TEXT_INPUT_EX_PROTOCOL *TextInEx;
+  EFI_KEY_DATA                      KeyData;
+
+  Status = gBS->HandleProtocol (gST->ConsoleInHandle, &gEfiSimpleTextInputExProtocolGuid, (VOID **) &TextInEx);
+  if (EFI_ERROR (Status)) {
+    return;
+  }
+
+  mFastBootTextInEx = TextInEx;
+  ZeroMem (&KeyData, sizeof (KeyData));
+  KeyData.Key.ScanCode = SCAN_F2;
+  Status = TextInEx->RegisterKeyNotify (TextInEx, &KeyData, PlatformFastBootOnHotkey, &mFastBootF2NotifyHandle);
+  if (EFI_ERROR (Status)) {
+    mFastBootF2NotifyHandle = NULL;
+  }
+  KeyData.Key.ScanCode = SCAN_DOWN;
+  Status = TextInEx->RegisterKeyNotify (TextInEx, &KeyData, PlatformFastBootOnHotkey, &mFastBootDownNotifyHandle);
+  if (EFI_ERROR (Status)) {
+    mFastBootDownNotifyHandle = NULL;
+  }
+}
+
+/**
+  Poll ConIn for PcdHotkeyPollWindow milliseconds so that the boot hotkeys can
+  be pressed while the boot timeout is 0.
+
+  The hotkeys registered with UefiBootManagerLib are caught by the console
+  drivers as the keys arrive, and BDS launches them after
+  PlatformBootManagerAfterConsole returns. The poll only gives the keys time
+  to arrive, and stops at the first key.
+**/
+VOID
+PlatformPollHotkeys (
+  VOID
+)
+{
+  EFI_STATUS                        Status;
+  EFI_INPUT_KEY                     Key;
+  UINT32                            Elapsed;
+
+  if (gST->ConIn == NULL) {
+    return;
+  }
+
+  for (Elapsed = 0; Elapsed < PcdGet32 (PcdHotkeyPollWindow); Elapsed += HOTKEY_POLL_INTERVAL) {
+    Status = gST->ConIn->ReadKeyStroke (gST->ConIn, &Key);
+    if (!EFI_ERROR (Status)) {
+      DEBUG ((DEBUG_INFO, "Key %x/%x pressed after %dms\n", Key.ScanCode, Key.UnicodeChar, Elapsed));
+      break;
+    }
+    gBS->Stall (HOTKEY_POLL_INTERVAL * 1000);
+  }
+}
+
 /**
   Do the platform specific action before the console is connected.
 
@@ -216,12 +504,28 @@ PlatformBootManagerAfterConsole (
 {
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL  Black;
   EFI_GRAPHICS_OUTPUT_BLT_PIXEL  White;
+  EFI_EVENT                      Event;
 
   Black.Blue = Black.Green = Black.Red = Black.Reserved = 0;
   White.Blue = White.Green = White.Red = White.Reserved = 0xFF;
 
-  EfiBootManagerConnectAll ();
-  EfiBootManagerRefreshAllBootOption ();
+  if (FeaturePcdGet (PcdFastBootEnable)) {
+    EfiCreateEventReadyToBootEx (TPL_CALLBACK, PlatformFastBootOnReadyToBoot, NULL, &Event);
+
+    //
+    // Boot without waiting for every controller. Everything is connected
+    // when the boot fails or the Boot Manager Menu is requested.
+    //
+    mFastBootConnected = PlatformFastBootConnect ();
+    if (mFastBootConnected) {
+      PlatformFastBootRegisterHotkeys ();
+    }
+  }
+
+  if (!mFastBootConnected) {
+    EfiBootManagerConnectAll ();
+    EfiBootManagerRefreshAllBootOption ();
+  }
 
   //
   // Register UEFI Shell
@@ -240,6 +544,14 @@ PlatformBootManagerAfterConsole (
     L"\n"
   );
 
+  //
+  // BDS does not wait for the hotkeys when the timeout is 0
+  //
+  if (PcdGet16 (PcdPlatformBootTimeOut) == 0) {
+    PlatformPollHotkeys ();
+  }
+
+  PlatformFastBootCheckHotkeys ();
 }
 
 /**
@@ -253,7 +565,7 @@ PlatformBootManagerWaitCallback (
   UINT16          TimeoutRemain
 )
 {
-  return;
+  PlatformFastBootCheckHotkeys ();
 }
 
 /**
@@ -269,5 +581,30 @@ PlatformBootManagerUnableToBoot (
   VOID
   )
 {
-  return;
+  EFI_BOOT_MANAGER_LOAD_OPTION   *BootOptions;
+  UINTN                          BootOptionCount;
+  UINTN                          Index;
+
+  if (!mFastBootConnected) {
+    return;
+  }
+
+  //
+  // The fast boot device failed, forget it and retry with every device connected
+  //
+  gRT->SetVariable (FAST_BOOT_OPTION_VARIABLE_NAME, &gUefiPayloadBootManagerGuid, 0, 0, NULL);
+  PlatformFastBootConnectAll ();
+
+  BootOptions = EfiBootManagerGetLoadOptions (&BootOptionCount, LoadOptionTypeBoot);
+  for (Index = 0; Index < BootOptionCount; Index++) {
+    if ((BootOptions[Index].Attributes & LOAD_OPTION_ACTIVE) == 0 ||
+        (BootOptions[Index].Attributes & LOAD_OPTION_CATEGORY) != LOAD_OPTION_CATEGORY_BOOT) {
+      continue;
+    }
+    EfiBootManagerBoot (&BootOptions[Index]);
+    if (BootOptions[Index].Status == EFI_SUCCESS) {
+      break;
+    }
+  }
+  EfiBootManagerFreeLoadOptions (BootOptions, BootOptionCount);
 }
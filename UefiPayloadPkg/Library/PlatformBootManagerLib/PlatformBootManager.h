@@ -33,6 +33,18 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #include <Library/DxeServicesLib.h>
 #include <Library/BootLogoLib.h>
 #include <Protocol/SmmAccess2.h>
+#include <Protocol/SimpleTextInEx.h>
+
+//
+// Option number of the last OS boot option, connected first on a fast boot.
+// Stored under gUefiPayloadBootManagerGuid.
+//
+#define FAST_BOOT_OPTION_VARIABLE_NAME  L"FastBootOption"
+
+//
+// Interval of the ConIn poll for the boot hotkeys, in milliseconds
+//
+#define HOTKEY_POLL_INTERVAL            10
 
 typedef struct {
   EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
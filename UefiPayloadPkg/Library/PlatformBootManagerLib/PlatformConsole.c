@@ -152,6 +152,57 @@ EFI_DEVICE_PATH_PROTOCOL          *gPlatformRootBridges[] = {
 
 BOOLEAN       mDetectVgaOnly;
 
+//
+// Console cache being recorded by the PCI walk, NULL when not recording
+//
+STATIC UINT8  *mConsoleCache = NULL;
+STATIC UINTN  mConsoleCacheSize;
+
+/**
+  Add a device path to the console variables, and to the console cache when it
+  is being recorded.
+
+  @param[in]  DevicePath  - Device path of the console.
+  @param[in]  ConsoleMask - CONSOLE_CACHE_* bits of the console variables to update.
+
+**/
+VOID
+PlatformAddConsole (
+  IN EFI_DEVICE_PATH_PROTOCOL  *DevicePath,
+  IN UINT8                     ConsoleMask
+)
+{
+  UINTN                     PathSize;
+
+  if (DevicePath == NULL) {
+    return;
+  }
+
+  if ((ConsoleMask & CONSOLE_CACHE_CONOUT) != 0) {
+    EfiBootManagerUpdateConsoleVariable (ConOut, DevicePath, NULL);
+  }
+  if ((ConsoleMask & CONSOLE_CACHE_CONIN) != 0) {
+    EfiBootManagerUpdateConsoleVariable (ConIn, DevicePath, NULL);
+  }
+  if ((ConsoleMask & CONSOLE_CACHE_ERROUT) != 0) {
+    EfiBootManagerUpdateConsoleVariable (ErrOut, DevicePath, NULL);
+  }
+
+  if (mConsoleCache == NULL) {
+    return;
+  }
+
+  PathSize = GetDevicePathSize (DevicePath);
+  mConsoleCache = ReallocatePool (mConsoleCacheSize, mConsoleCacheSize + 1 + PathSize, mConsoleCache);
+  if (mConsoleCache == NULL) {
+    mConsoleCacheSize = 0;
+    return;
+  }
+  mConsoleCache[mConsoleCacheSize] = ConsoleMask;
+  CopyMem (&mConsoleCache[mConsoleCacheSize + 1], DevicePath, PathSize);
+  mConsoleCacheSize += 1 + PathSize;
+}
+
 /**
   Add UART to ConOut, ConIn, ErrOut.
 
@@ -185,7 +236,7 @@ PrepareLpcBridgeDevicePath (
   //
   DevicePath = AppendDevicePathNode (DevicePath, (EFI_DEVICE_PATH_PROTOCOL *)&gPnpPs2KeyboardDeviceNode);
 
-  EfiBootManagerUpdateConsoleVariable (ConIn, DevicePath, NULL);
+  PlatformAddConsole (DevicePath, CONSOLE_CACHE_CONIN);
   
   //
   // Register COM1
@@ -194,9 +245,7 @@ PrepareLpcBridgeDevicePath (
   DevicePath = AppendDevicePathNode (DevicePath, (EFI_DEVICE_PATH_PROTOCOL *)&gUartDeviceNode);
   DevicePath = AppendDevicePathNode (DevicePath, (EFI_DEVICE_PATH_PROTOCOL *)&gTerminalTypeDeviceNode);
 
-  EfiBootManagerUpdateConsoleVariable (ConOut, DevicePath, NULL);
-  EfiBootManagerUpdateConsoleVariable (ConIn, DevicePath, NULL);
-  EfiBootManagerUpdateConsoleVariable (ErrOut, DevicePath, NULL);
+  PlatformAddConsole (DevicePath, CONSOLE_CACHE_CONOUT | CONSOLE_CACHE_CONIN | CONSOLE_CACHE_ERROUT);
 
   return EFI_SUCCESS;
 }
@@ -340,7 +389,7 @@ PreparePciVgaDevicePath (
   GetGopDevicePath (DevicePath, &GopDevicePath);
   DevicePath = GopDevicePath;
 
-  EfiBootManagerUpdateConsoleVariable (ConOut, DevicePath, NULL);
+  PlatformAddConsole (DevicePath, CONSOLE_CACHE_CONOUT);
 
   return EFI_SUCCESS;
 }
@@ -375,9 +424,7 @@ PreparePciSerialDevicePath (
   DevicePath = AppendDevicePathNode (DevicePath, (EFI_DEVICE_PATH_PROTOCOL *)&gUartDeviceNode);
   DevicePath = AppendDevicePathNode (DevicePath, (EFI_DEVICE_PATH_PROTOCOL *)&gTerminalTypeDeviceNode);
 
-  EfiBootManagerUpdateConsoleVariable (ConOut, DevicePath, NULL);
-  EfiBootManagerUpdateConsoleVariable (ConIn,  DevicePath, NULL);
-  EfiBootManagerUpdateConsoleVariable (ErrOut, DevicePath, NULL);
+  PlatformAddConsole (DevicePath, CONSOLE_CACHE_CONOUT | CONSOLE_CACHE_CONIN | CONSOLE_CACHE_ERROUT);
 
   return EFI_SUCCESS;
 }
@@ -587,9 +634,139 @@ DetectAndPreparePlatformPciDevicePath (
 }
 
 
+/**
+  Compute a hash of the PCI topology from the device path, the IDs and the class
+  code of every PCI device. Only two dwords of the header are read per device.
+
+  @param[out] TopologyHash - Hash of the PCI topology.
+
+  @retval EFI_SUCCESS - The hash is computed.
+  @retval EFI_STATUS  - The PCI devices cannot be listed.
+
+**/
+EFI_STATUS
+GetPciTopologyHash (
+  OUT UINT32                   *TopologyHash
+)
+{
+  EFI_STATUS                Status;
+  UINTN                     HandleCount;
+  EFI_HANDLE                *HandleBuffer;
+  UINTN                     Index;
+  UINT32                    *Records;
+  EFI_PCI_IO_PROTOCOL       *PciIo;
+  EFI_DEVICE_PATH_PROTOCOL  *DevicePath;
+
+  Status = gBS->LocateHandleBuffer (
+             ByProtocol,
+             &gEfiPciIoProtocolGuid,
+             NULL,
+             &HandleCount,
+             &HandleBuffer
+           );
+  if (EFI_ERROR (Status)) {
+    return Status;
+  }
+
+  Records = AllocateZeroPool (HandleCount * 3 * sizeof (UINT32));
+  if (Records == NULL) {
+    gBS->FreePool (HandleBuffer);
+    return EFI_OUT_OF_RESOURCES;
+  }
+
+  for (Index = 0; Index < HandleCount; Index++) {
+    Status = gBS->HandleProtocol (HandleBuffer[Index], &gEfiDevicePathProtocolGuid, (VOID **) &DevicePath);
+    if (!EFI_ERROR (Status)) {
+      gBS->CalculateCrc32 (DevicePath, GetDevicePathSize (DevicePath), &Records[Index * 3]);
+    }
+    Status = gBS->HandleProtocol (HandleBuffer[Index], &gEfiPciIoProtocolGuid, (VOID **) &PciIo);
+    if (!EFI_ERROR (Status)) {
+      PciIo->Pci.Read (PciIo, EfiPciIoWidthUint32, PCI_VENDOR_ID_OFFSET, 1, &Records[Index * 3 + 1]);
+      PciIo->Pci.Read (PciIo, EfiPciIoWidthUint32, PCI_REVISION_ID_OFFSET, 1, &Records[Index * 3 + 2]);
+    }
+  }
+
+  Status = gBS->CalculateCrc32 (Records, HandleCount * 3 * sizeof (UINT32), TopologyHash);
+
+  FreePool (Records);
+  gBS->FreePool (HandleBuffer);
+  return Status;
+}
+
+
+/**
+  Add the console device paths of the console cache to the console variables,
+  if the cache was recorded on the same PCI topology.
+
+  @param[in]  TopologyHash - Hash of the current PCI topology.
+
+  @retval TRUE  - The console variables are updated from the cache.
+  @retval FALSE - There is no valid cache for this topology.
+
+**/
+BOOLEAN
+PlatformRestoreConsoleCache (
+  IN UINT32                    TopologyHash
+)
+{
+  EFI_STATUS                Status;
+  UINT8                     *Cache;
+  UINTN                     CacheSize;
+  UINTN                     Offset;
+  CONSOLE_CACHE_HEADER      *Header;
+  BOOLEAN                   Valid;
+
+  Status = GetVariable2 (CONSOLE_CACHE_VARIABLE_NAME, &gUefiPayloadBootManagerGuid, (VOID **) &Cache, &CacheSize);
+  if (EFI_ERROR (Status)) {
+    return FALSE;
+  }
+
+  Valid  = FALSE;
+  Header = (CONSOLE_CACHE_HEADER *) Cache;
+  if ((CacheSize >= sizeof (CONSOLE_CACHE_HEADER)) &&
+      (Header->Revision == CONSOLE_CACHE_REVISION) &&
+      (Header->TopologyHash == TopologyHash)) {
+    //
+    // Check every record before any console variable is touched. A record is
+    // the console type byte followed by at least an end node.
+    //
+    Valid = TRUE;
+    for (Offset = sizeof (CONSOLE_CACHE_HEADER); Offset < CacheSize; ) {
+      if ((Offset + 1 + END_DEVICE_PATH_LENGTH > CacheSize) ||
+          !IsDevicePathValid ((EFI_DEVICE_PATH_PROTOCOL *) &Cache[Offset + 1], CacheSize - Offset - 1)) {
+        Valid = FALSE;
+        break;
+      }
+      Offset += 1 + GetDevicePathSize ((EFI_DEVICE_PATH_PROTOCOL *) &Cache[Offset + 1]);
+    }
+
+    if (!Valid) {
+      //
+      // Throw the whole cache away, the PCI walk records it again
+      //
+      DEBUG ((EFI_D_ERROR, "Console cache is corrupted, discarded\n"));
+      gRT->SetVariable (CONSOLE_CACHE_VARIABLE_NAME, &gUefiPayloadBootManagerGuid, 0, 0, NULL);
+    }
+  }
+
+  if (Valid) {
+    for (Offset = sizeof (CONSOLE_CACHE_HEADER); Offset < CacheSize; ) {
+      PlatformAddConsole ((EFI_DEVICE_PATH_PROTOCOL *) &Cache[Offset + 1], Cache[Offset]);
+      Offset += 1 + GetDevicePathSize ((EFI_DEVICE_PATH_PROTOCOL *) &Cache[Offset + 1]);
+    }
+  }
+
+  FreePool (Cache);
+  return Valid;
+}
+
+
 /**
   Do platform specific PCI Device check and add them to ConOut, ConIn, ErrOut
 
+  The console device paths found are cached, and the PCI walk is skipped on
+  later boots while the PCI topology is unchanged.
+
   @param[in]  DetectVgaOnly - Only detect VGA device if it's TRUE.
 
   @retval EFI_SUCCESS - PCI Device check and Console variable update successfully.
@@ -601,8 +778,46 @@ DetectAndPreparePlatformPciDevicePaths (
   BOOLEAN DetectVgaOnly
 )
 {
+  EFI_STATUS                Status;
+  UINT32                    TopologyHash;
+  CONSOLE_CACHE_HEADER      *Header;
+
   mDetectVgaOnly = DetectVgaOnly;
-  return VisitAllPciInstances (DetectAndPreparePlatformPciDevicePath);
+  if (DetectVgaOnly) {
+    return VisitAllPciInstances (DetectAndPreparePlatformPciDevicePath);
+  }
+
+  Status = GetPciTopologyHash (&TopologyHash);
+  if (!EFI_ERROR (Status)) {
+    if (PlatformRestoreConsoleCache (TopologyHash)) {
+      DEBUG ((EFI_D_INFO, "PCI topology %08x unchanged, console device paths restored\n", TopologyHash));
+      return EFI_SUCCESS;
+    }
+
+    mConsoleCacheSize = sizeof (CONSOLE_CACHE_HEADER);
+    mConsoleCache     = AllocateZeroPool (mConsoleCacheSize);
+    if (mConsoleCache != NULL) {
+      Header               = (CONSOLE_CACHE_HEADER *) mConsoleCache;
+      Header->Revision     = CONSOLE_CACHE_REVISION;
+      Header->TopologyHash = TopologyHash;
+    }
+  }
+
+  Status = VisitAllPciInstances (DetectAndPreparePlatformPciDevicePath);
+
+  if (mConsoleCache != NULL) {
+    gRT->SetVariable (
+           CONSOLE_CACHE_VARIABLE_NAME,
+           &gUefiPayloadBootManagerGuid,
+           EFI_VARIABLE_NON_VOLATILE | EFI_VARIABLE_BOOTSERVICE_ACCESS,
+           mConsoleCacheSize,
+           mConsoleCache
+           );
+    FreePool (mConsoleCache);
+    mConsoleCache = NULL;
+  }
+
+  return Status;
 }
 
 
@@ -29,6 +29,18 @@ WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
 #define IS_PCI_ISA_PDECODE(_p)        IS_CLASS3 (_p, PCI_CLASS_BRIDGE, PCI_CLASS_BRIDGE_ISA_PDECODE, 0)
 #define IS_PCI_16550SERIAL(_p)        IS_CLASS3 (_p, PCI_CLASS_SCC, PCI_SUBCLASS_SERIAL, PCI_IF_16550)
 
+//
+// Console device paths found by the last PCI walk, stored under
+// gUefiPayloadBootManagerGuid. The walk is skipped while the PCI topology
+// hash is unchanged.
+//
+#define CONSOLE_CACHE_VARIABLE_NAME   L"ConsoleCache"
+#define CONSOLE_CACHE_REVISION        1
+
+#define CONSOLE_CACHE_CONIN           BIT0
+#define CONSOLE_CACHE_CONOUT          BIT1
+#define CONSOLE_CACHE_ERROUT          BIT2
+
 //
 // Type definitions
 //
@@ -41,6 +53,15 @@ typedef struct {
   EFI_DEVICE_PATH_PROTOCOL  End;
 } PLATFORM_ROOT_BRIDGE_DEVICE_PATH;
 
+//
+// Header of the console cache variable. It is followed by records of a UINT8
+// mask of CONSOLE_CACHE_* bits and a device path.
+//
+typedef struct {
+  UINT32                    Revision;
+  UINT32                    TopologyHash;
+} CONSOLE_CACHE_HEADER;
+
 typedef
 EFI_STATUS
 (EFIAPI *PROTOCOL_INSTANCE_CALLBACK)(
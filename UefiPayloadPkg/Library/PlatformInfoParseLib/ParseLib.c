@@ -129,28 +129,39 @@ CbCheckSum16 (
 }
 
 
+//
+// coreboot forwards once, from the low memory table to the high one
+//
+#define CB_FORWARD_MAX_DEPTH    1
+
 /**
   Find coreboot record with given Tag from the memory Start in 4096
-  bytes range.
+  bytes range, following at most Depth forwarding entries.
+
+  Records are only read while they lie within the table_bytes of the
+  header, so a corrupted table cannot make the walk leave the table.
 
   @param  Start              The start memory to be searched in
   @param  Tag                The tag id to be found
+  @param  Depth              The number of forwarding entries that may still be followed
 
   @retval NULL              The Tag is not found.
   @retval Others            The poiter to the record found.
 
 **/
+STATIC
 VOID *
-EFIAPI
-FindCbTag (
+FindCbTagInDepth (
   IN  VOID     *Start,
-  IN  UINT32   Tag
+  IN  UINT32   Tag,
+  IN  UINTN    Depth
   )
 {
   struct cb_header   *Header;
   struct cb_record   *Record;
   UINT8              *TmpPtr;
   UINT8              *TagPtr;
+  UINT8              *TableEnd;
   UINTN              Idx;
   UINT16             CheckSum;
 
@@ -167,7 +178,7 @@ FindCbTag (
     return NULL;
   }
 
-  if ((Header == NULL) || (Header->table_bytes == 0)) {
+  if ((Header == NULL) || (Header->table_bytes == 0) || (Header->header_bytes < sizeof (*Header))) {
     return NULL;
   }
 
@@ -186,16 +197,29 @@ FindCbTag (
     return NULL;
   }
 
-  TagPtr = NULL;
-  TmpPtr += Header->header_bytes;
+  TagPtr   = NULL;
+  TmpPtr  += Header->header_bytes;
+  TableEnd = TmpPtr + Header->table_bytes;
   for (Idx = 0; Idx < Header->table_entries; Idx++) {
     Record = (struct cb_record *)TmpPtr;
+    if (((UINTN)(TableEnd - TmpPtr) < sizeof (*Record)) ||
+        (Record->size < sizeof (*Record)) ||
+        (Record->size > (UINTN)(TableEnd - TmpPtr))) {
+      DEBUG ((EFI_D_ERROR, "Invalid coreboot table record %d\n", Idx));
+      return NULL;
+    }
     if (Record->tag == CB_TAG_FORWARD) {
+      if (Record->size < sizeof (struct cb_forward)) {
+        return NULL;
+      }
       TmpPtr = (VOID *)(UINTN)((struct cb_forward *)(UINTN)Record)->forward;
       if (Tag == CB_TAG_FORWARD) {
         return TmpPtr;
+      } else if (Depth == 0) {
+        DEBUG ((EFI_D_ERROR, "Too many coreboot table forwarding entries\n"));
+        return NULL;
       } else {
-        return FindCbTag (TmpPtr, Tag);
+        return FindCbTagInDepth (TmpPtr, Tag, Depth - 1);
       }
     }
     if (Record->tag == Tag) {
@@ -208,6 +232,27 @@ FindCbTag (
   return TagPtr;
 }
 
+/**
+  Find coreboot record with given Tag from the memory Start in 4096
+  bytes range.
+
+  @param  Start              The start memory to be searched in
+  @param  Tag                The tag id to be found
+
+  @retval NULL              The Tag is not found.
+  @retval Others            The poiter to the record found.
+
+**/
+VOID *
+EFIAPI
+FindCbTag (
+  IN  VOID     *Start,
+  IN  UINT32   Tag
+  )
+{
+  return FindCbTagInDepth (Start, Tag, CB_FORWARD_MAX_DEPTH);
+}
+
 
 /**
   Find the given table with TableId from the given coreboot memory Root.
@@ -1049,6 +1094,163 @@ ParseFrameBufferInfoByHob (
 }
 
 
+/**
+  Find the flash variable region information from Slim Bootloader
+
+  @param  pFlashVarInfo      Pointer to the FLASH_VARIABLE_INFO structure
+
+  @retval RETURN_SUCCESS     Successfully find the flash variable region information.
+  @retval RETURN_NOT_FOUND   Failed to find the flash variable region information.
+
+**/
+RETURN_STATUS
+EFIAPI
+ParseFlashVariableInfoByHob (
+  OUT FLASH_VARIABLE_INFO   *pFlashVarInfo
+  )
+{
+  EFI_HOB_GUID_TYPE     *GuidHob;
+  FLASH_VARIABLE_INFO   *FlashVarInfo;
+
+  GuidHob = GetNextGuidHob (&gUefiFlashVariableInfoGuid, GetPayloadHobList());
+  if (GuidHob == NULL) {
+    return RETURN_NOT_FOUND;
+  }
+
+  FlashVarInfo = (FLASH_VARIABLE_INFO *)GET_GUID_HOB_DATA(GuidHob);
+  if ((FlashVarInfo->Size == 0) || (FlashVarInfo->BlockSize == 0)) {
+    return RETURN_NOT_FOUND;
+  }
+
+  if (pFlashVarInfo) {
+    *pFlashVarInfo = *FlashVarInfo;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+
+/**
+  Find the PCI resources assigned by Slim Bootloader
+
+  @param  pPciResInfo        Pointer to receive the PCI_RESOURCE_INFO structure in the
+                             Slim Bootloader hob list
+  @param  pSize              Pointer to receive the size of the structure, descriptors included
+
+  @retval RETURN_SUCCESS     Successfully find the PCI resource information.
+  @retval RETURN_NOT_FOUND   Failed to find the PCI resource information.
+
+**/
+RETURN_STATUS
+EFIAPI
+ParsePciResourceInfoByHob (
+  OUT PCI_RESOURCE_INFO     **pPciResInfo,
+  OUT UINTN                 *pSize
+  )
+{
+  EFI_HOB_GUID_TYPE     *GuidHob;
+  PCI_RESOURCE_INFO     *PciResInfo;
+  UINTN                 Size;
+
+  GuidHob = GetNextGuidHob (&gUefiPciResourceInfoGuid, GetPayloadHobList());
+  if (GuidHob == NULL) {
+    return RETURN_NOT_FOUND;
+  }
+
+  PciResInfo = (PCI_RESOURCE_INFO *)GET_GUID_HOB_DATA(GuidHob);
+  Size       = sizeof (PCI_RESOURCE_INFO) + PciResInfo->Count * sizeof (PCI_RESOURCE_DESCRIPTOR);
+  if (Size > GET_GUID_HOB_DATA_SIZE(GuidHob)) {
+    return RETURN_NOT_FOUND;
+  }
+
+  *pPciResInfo = PciResInfo;
+  *pSize       = Size;
+
+  return RETURN_SUCCESS;
+}
+
+
+/**
+  Find the flash variable region from the SMMSTORE area of the coreboot flash map
+
+  The boot media is memory mapped right below 4GB, but only its top 16MB.
+
+  @param  pFlashVarInfo      Pointer to the FLASH_VARIABLE_INFO structure
+
+  @retval RETURN_SUCCESS     Successfully find the flash variable region information.
+  @retval RETURN_NOT_FOUND   Failed to find the flash variable region information.
+
+**/
+RETURN_STATUS
+EFIAPI
+ParseFlashVariableInfoByCb (
+  OUT FLASH_VARIABLE_INFO   *pFlashVarInfo
+  )
+{
+  struct cb_boot_media_params  *CbMediaRec;
+  struct fmap                  *Fmap;
+  struct fmap_area             *Area;
+  UINT64                       MediaSize;
+  UINT64                       MappedStart;
+  UINT64                       FmapOffset;
+  UINTN                        Index;
+
+  CbMediaRec = FindCbTag (0, CB_TAG_BOOT_MEDIA_PARAMS);
+  if (CbMediaRec == NULL) {
+    CbMediaRec = FindCbTag ((VOID *)(UINTN)PcdGet32 (PcdCbHeaderPointer), CB_TAG_BOOT_MEDIA_PARAMS);
+  }
+
+  if ((CbMediaRec == NULL) || (CbMediaRec->size < sizeof (*CbMediaRec))) {
+    return RETURN_NOT_FOUND;
+  }
+
+  MediaSize   = CbMediaRec->boot_media_size;
+  FmapOffset  = CbMediaRec->fmap_offset;
+  if ((MediaSize == 0) || (MediaSize > SIZE_4GB)) {
+    return RETURN_NOT_FOUND;
+  }
+  MappedStart = (MediaSize > SIZE_16MB) ? MediaSize - SIZE_16MB : 0;
+  if ((FmapOffset < MappedStart) || (FmapOffset > MediaSize - sizeof (struct fmap))) {
+    return RETURN_NOT_FOUND;
+  }
+
+  Fmap = (struct fmap *)(UINTN)(SIZE_4GB - MediaSize + FmapOffset);
+  if (CompareMem (Fmap->signature, FMAP_SIGNATURE, sizeof (Fmap->signature)) != 0) {
+    return RETURN_NOT_FOUND;
+  }
+  if (Fmap->nareas > (MediaSize - FmapOffset - sizeof (struct fmap)) / sizeof (struct fmap_area)) {
+    return RETURN_NOT_FOUND;
+  }
+
+  for (Index = 0; Index < Fmap->nareas; Index++) {
+    Area = &Fmap->areas[Index];
+    if (CompareMem (Area->name, "SMMSTORE", sizeof ("SMMSTORE")) != 0) {
+      continue;
+    }
+    if ((Area->size == 0) || (Area->offset < MappedStart) ||
+        ((UINT64)Area->offset + Area->size > MediaSize)) {
+      return RETURN_NOT_FOUND;
+    }
+
+    DEBUG ((EFI_D_INFO, "Found coreboot SMMSTORE region at 0x%x size 0x%x\n", Area->offset, Area->size));
+    if (pFlashVarInfo) {
+      ZeroMem (pFlashVarInfo, sizeof (FLASH_VARIABLE_INFO));
+      pFlashVarInfo->FlashOffset = Area->offset;
+      pFlashVarInfo->MmioBase    = SIZE_4GB - MediaSize + Area->offset;
+      pFlashVarInfo->Size        = Area->size;
+      //
+      // coreboot does not report the erase size, 4KB sectors are used by SPI
+      // flash parts and by the Qemu pflash device alike
+      //
+      pFlashVarInfo->BlockSize   = SIZE_4KB;
+    }
+    return RETURN_SUCCESS;
+  }
+
+  return RETURN_NOT_FOUND;
+}
+
+
 /**
   Find the serial port information from Coreboot
 
@@ -17,27 +17,82 @@
 #include <Library/DebugLib.h>
 #include <Library/IoLib.h>
 #include <Library/HobLib.h>
+#include <Library/BaseMemoryLib.h>
 
 #include <Guid/AcpiBoardInfoGuid.h>
 
+//
+// The reset control register of the PC/AT compatible chipsets
+//
+#define RESET_CONTROL_REGISTER     0xCF9
+#define RESET_CONTROL_COLD_RESET   (BIT3 | BIT2 | BIT1)  // Full reset with power cycle
+#define RESET_CONTROL_WARM_RESET   (BIT2 | BIT1)         // Hard reset without power cycle
+
+//
+// A copy of the acpi board information, since the HOB list is gone at runtime
+//
+STATIC ACPI_BOARD_INFO  mAcpiBoardInfo;
+STATIC BOOLEAN          mAcpiBoardInfoValid = FALSE;
+
+/**
+  The constructor function caches the acpi board information.
+
+  It will always return RETURN_SUCCESS.
+
+  @retval RETURN_SUCCESS   The constructor always returns RETURN_SUCCESS.
+
+**/
+RETURN_STATUS
+EFIAPI
+ResetSystemLibConstructor (
+  VOID
+  )
+{
+  EFI_HOB_GUID_TYPE  *GuidHob;
+
+  //
+  // Find the acpi board information guid hob
+  //
+  GuidHob = GetFirstGuidHob (&gUefiAcpiBoardInfoGuid);
+  if (GuidHob != NULL) {
+    CopyMem (&mAcpiBoardInfo, GET_GUID_HOB_DATA (GuidHob), sizeof (ACPI_BOARD_INFO));
+    mAcpiBoardInfoValid = TRUE;
+  }
+
+  return RETURN_SUCCESS;
+}
+
+/**
+  Return the cached acpi board information.
+
+  The acpi board information hob may be built after the constructor ran, so
+  the lookup is retried here. This only happens before the HOB list is gone.
+
+  @return The acpi board information.
+
+**/
+ACPI_BOARD_INFO *
+GetAcpiBoardInfo (
+  VOID
+  )
+{
+  if (!mAcpiBoardInfoValid) {
+    ResetSystemLibConstructor ();
+  }
+  ASSERT (mAcpiBoardInfoValid);
+  return &mAcpiBoardInfo;
+}
+
 VOID
 AcpiPmControl (
   UINTN SuspendType
   )
 {
-	EFI_HOB_GUID_TYPE  *GuidHob;
-	ACPI_BOARD_INFO    *pAcpiBoardInfo;	
-	UINTN PmCtrlReg = 0;
-	
-  ASSERT (SuspendType <= 7);  
-  //
-	// Find the acpi board information guid hob
-	//
-	GuidHob = GetFirstGuidHob (&gUefiAcpiBoardInfoGuid);
-	ASSERT (GuidHob != NULL);
-  pAcpiBoardInfo = (ACPI_BOARD_INFO *)GET_GUID_HOB_DATA (GuidHob); 
-  
-  PmCtrlReg = (UINTN)pAcpiBoardInfo->PmCtrlRegBase; 
+  UINTN PmCtrlReg;
+
+  ASSERT (SuspendType <= 7);
+
+  PmCtrlReg = (UINTN)GetAcpiBoardInfo ()->PmCtrlRegBase;
   IoAndThenOr16 (PmCtrlReg, (UINT16) ~0x3c00, (UINT16) (SuspendType << 10));
   IoOr16 (PmCtrlReg, BIT13);
   CpuDeadLoop ();
@@ -58,17 +113,14 @@ ResetCold (
   VOID
   )
 {
-  EFI_HOB_GUID_TYPE  *GuidHob;
-	ACPI_BOARD_INFO    *pAcpiBoardInfo;	
-		
-	//
-	// Find the acpi board information guid hob
-	//
-	GuidHob = GetFirstGuidHob (&gUefiAcpiBoardInfoGuid);
-	ASSERT (GuidHob != NULL);
-  pAcpiBoardInfo = (ACPI_BOARD_INFO *)GET_GUID_HOB_DATA (GuidHob); 
-	
-  IoWrite8 ((UINTN)pAcpiBoardInfo->ResetRegAddress, pAcpiBoardInfo->ResetValue);
+  ACPI_BOARD_INFO    *pAcpiBoardInfo;
+
+  pAcpiBoardInfo = GetAcpiBoardInfo ();
+  if (pAcpiBoardInfo->ResetRegAddress == RESET_CONTROL_REGISTER) {
+    IoWrite8 (RESET_CONTROL_REGISTER, RESET_CONTROL_COLD_RESET);
+  } else {
+    IoWrite8 ((UINTN)pAcpiBoardInfo->ResetRegAddress, pAcpiBoardInfo->ResetValue);
+  }
   CpuDeadLoop ();
 }
 
@@ -76,6 +128,10 @@ ResetCold (
   Calling this function causes a system-wide initialization. The processors
   are set to their initial state, and pending cycles are not corrupted.
 
+  When the reset register is the PC/AT reset control register, the platform is
+  reset without a power cycle, so memory does not have to be trained again.
+  Otherwise only the FADT reset value is known, which performs a full reset.
+
   System reset should not return, if it returns, it means the system does
   not support warm reset.
 **/
@@ -85,17 +141,14 @@ ResetWarm (
   VOID
   )
 {
-	EFI_HOB_GUID_TYPE  *GuidHob;
-	ACPI_BOARD_INFO    *pAcpiBoardInfo;	
-		
-	//
-	// Find the acpi board information guid hob
-	//
-	GuidHob = GetFirstGuidHob (&gUefiAcpiBoardInfoGuid);
-	ASSERT (GuidHob != NULL);
-  pAcpiBoardInfo = (ACPI_BOARD_INFO *)GET_GUID_HOB_DATA (GuidHob); 
-	
-  IoWrite8 ((UINTN)pAcpiBoardInfo->ResetRegAddress, pAcpiBoardInfo->ResetValue);
+  ACPI_BOARD_INFO    *pAcpiBoardInfo;
+
+  pAcpiBoardInfo = GetAcpiBoardInfo ();
+  if (pAcpiBoardInfo->ResetRegAddress == RESET_CONTROL_REGISTER) {
+    IoWrite8 (RESET_CONTROL_REGISTER, RESET_CONTROL_WARM_RESET);
+  } else {
+    IoWrite8 ((UINTN)pAcpiBoardInfo->ResetRegAddress, pAcpiBoardInfo->ResetValue);
+  }
   CpuDeadLoop ();
 }
 
@@ -112,17 +165,11 @@ ResetShutdown (
   VOID
   )
 {
-  EFI_HOB_GUID_TYPE  *GuidHob;
   ACPI_BOARD_INFO    *pAcpiBoardInfo;
   UINTN              PmCtrlReg;
 
-  //
-  // Find the acpi board information guid hob
-  //
-  GuidHob = GetFirstGuidHob (&gUefiAcpiBoardInfoGuid);
-  ASSERT (GuidHob != NULL);
-  pAcpiBoardInfo = (ACPI_BOARD_INFO *)GET_GUID_HOB_DATA (GuidHob); 
-  
+  pAcpiBoardInfo = GetAcpiBoardInfo ();
+
   //
   // GPE0_EN should be disabled to avoid any GPI waking up the system from S5
   //
@@ -0,0 +1,199 @@
+## @file
+#
+# Copyright (c) 2018, Intel Corporation. All rights reserved.<BR>
+#
+# This program and the accompanying materials are licensed and made available
+# under the terms and conditions of the BSD License which accompanies this
+# distribution. The full text of the license may be found at
+# http://opensource.org/licenses/bsd-license.php
+#
+# THE PROGRAM IS DISTRIBUTED UNDER THE BSD LICENSE ON AN 'AS IS' BASIS,
+# WITHOUT WARRANTIES OR REPRESENTATIONS OF ANY KIND, EITHER EXPRESS OR IMPLIED.
+#
+import os, sys, argparse, subprocess, threading, tempfile, shutil, time, json, re
+try:
+  import Queue as queue
+except ImportError:
+  import queue
+
+#
+# Boots a DEBUG payload under QEMU q35 with TCG and a fixed -icount, and times
+# the boot phases from the serial log. Each phase ends where the next marker
+# shows up; "sec" runs from power on to the payload PEIM, so it includes the
+# bootloader. With sleep=off the guest clock skips idle time, so fixed waits
+# such as the boot timeout are not counted.
+#
+MARKERS = [
+  ('pei', re.compile(r'Coreboot (does NOT )?exist')),
+  ('dxe', re.compile(r'DXE IPL Entry')),
+  ('bds', re.compile(r'\[Bds\] ?Entry')),
+  ('end', re.compile(r'\[Bds\] ?Booting |UEFI Interactive Shell')),
+]
+PHASES = ['sec', 'pei', 'dxe', 'bds']
+
+def disks(workdir, prefix, count):
+  images = []
+  for index in range(count):
+    image = os.path.join(workdir, '%s%d.img' % (prefix, index))
+    with open(image, 'wb') as f:
+      f.truncate(64 * 1024 * 1024)
+    images.append(image)
+  return images
+
+def matrix_args(matrix, workdir):
+  args = []
+  if matrix == 'virtio-blk':
+    for index, image in enumerate(disks(workdir, 'vd', 16)):
+      args += ['-drive', 'file=%s,if=none,id=vd%d,format=raw' % (image, index),
+               '-device', 'virtio-blk-pci,drive=vd%d' % index]
+  elif matrix == 'ahci':
+    #
+    # The ICH9 AHCI controller of q35 has six ports, ide.0 to ide.5
+    #
+    for index, image in enumerate(disks(workdir, 'sata', 6)):
+      args += ['-drive', 'file=%s,if=none,id=sata%d,format=raw' % (image, index),
+               '-device', 'ide-hd,drive=sata%d,bus=ide.%d' % (index, index)]
+  elif matrix == 'usb':
+    image = disks(workdir, 'usb', 1)[0]
+    args += ['-device', 'qemu-xhci,id=xhci',
+             '-drive', 'file=%s,if=none,id=usbdisk,format=raw' % image,
+             '-device', 'usb-storage,bus=xhci.0,drive=usbdisk']
+  elif matrix == 'fb4k':
+    #
+    # The bootloader sets the mode; this only offers 3840x2160 in the EDID
+    # and enough video memory to hold it
+    #
+    args += ['-vga', 'none', '-device', 'VGA,vgamem_mb=64,xres=3840,yres=2160']
+  return args
+
+def reader(stream, lines):
+  for line in iter(stream.readline, b''):
+    lines.put((time.time(), line.decode('ascii', 'replace')))
+  lines.put((time.time(), None))
+
+def boot(args, matrix):
+  workdir = tempfile.mkdtemp(prefix='QemuBootTime')
+  cmd = [args.q, '-machine', 'q35,accel=tcg', '-m', str(args.m), '-smp', str(args.s),
+         '-icount', 'shift=%d,align=off,sleep=off' % args.i,
+         '-display', 'none', '-serial', 'stdio', '-monitor', 'none', '-no-reboot']
+  if args.b == 'sbl':
+    cmd += ['-drive', 'if=pflash,format=raw,file=%s' % os.path.abspath(args.f)]
+  else:
+    cmd += ['-bios', os.path.abspath(args.f)]
+  cmd += matrix_args(matrix, workdir)
+
+  log = None
+  if args.l:
+    if not os.path.exists(args.l):
+      os.makedirs(args.l)
+    log = open(os.path.join(args.l, '%s.log' % matrix), 'w')
+
+  stamps = {}
+  lines = queue.Queue()
+  start = time.time()
+  proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+  thread = threading.Thread(target=reader, args=(proc.stdout, lines))
+  thread.daemon = True
+  thread.start()
+  try:
+    while 'end' not in stamps:
+      try:
+        stamp, line = lines.get(timeout=max(0, start + args.t - time.time()))
+      except queue.Empty:
+        break
+      if line is None:
+        break
+      if log:
+        log.write(line)
+      for name, marker in MARKERS:
+        if name not in stamps and marker.search(line):
+          stamps[name] = stamp
+  finally:
+    if proc.poll() is None:
+      proc.kill()
+    proc.wait()
+    if log:
+      log.close()
+    shutil.rmtree(workdir, ignore_errors=True)
+
+  missing = [name for name, marker in MARKERS if name not in stamps]
+  if missing:
+    print('%s: no %s marker in the serial log, is this a DEBUG payload?' % (matrix, ', '.join(missing)))
+    return None
+  stamps['sec'] = start
+  ends = [name for name, marker in MARKERS]
+  return dict((phase, stamps[end] - stamps[phase]) for phase, end in zip(PHASES, ends))
+
+def measure(args, matrix):
+  #
+  # The guest runs the same instructions on every boot, but the host does
+  # not run them at the same speed; keep the fastest of each phase
+  #
+  best = None
+  for run in range(args.r):
+    phases = boot(args, matrix)
+    if phases is None:
+      return None
+    if best is None:
+      best = phases
+    else:
+      best = dict((phase, min(best[phase], phases[phase])) for phase in PHASES)
+  return best
+
+def load_baseline(path):
+  try:
+    with open(path) as f:
+      return json.load(f)
+  except (IOError, ValueError):
+    return {}
+
+if __name__ == '__main__':
+
+  parser = argparse.ArgumentParser(prog='python %s' % sys.argv[0],
+                                   description='Time the SEC, PEI, DXE and BDS phases of a DEBUG payload under QEMU.')
+  parser.add_argument('f', help='bootloader image with the payload, e.g. firmware.bin')
+  parser.add_argument('-b', help='bootloader', choices=['sbl', 'coreboot'], default='sbl')
+  parser.add_argument('-x', help='device matrix, may be repeated (default: all)', action='append',
+                      choices=['default', 'virtio-blk', 'ahci', 'usb', 'fb4k'])
+  parser.add_argument('-c', help='baseline file', default='QemuBootTime.json')
+  parser.add_argument('-p', help='allowed regression per phase in percent', type=int, default=10)
+  parser.add_argument('-u', help='write the measured times to the baseline file', action='store_true')
+  parser.add_argument('-r', help='boots per matrix', type=int, default=3)
+  parser.add_argument('-t', help='timeout per boot in seconds', type=int, default=600)
+  parser.add_argument('-i', help='-icount shift', type=int, default=5)
+  parser.add_argument('-m', help='memory size in MB', type=int, default=2048)
+  parser.add_argument('-s', help='number of CPUs', type=int, default=1)
+  parser.add_argument('-q', help='QEMU binary', default='qemu-system-x86_64')
+  parser.add_argument('-l', help='directory to keep the serial logs in')
+  args = parser.parse_args()
+
+  matrices = args.x or ['default', 'virtio-blk', 'ahci', 'usb', 'fb4k']
+  baseline = load_baseline(args.c)
+  failed = False
+  for matrix in matrices:
+    phases = measure(args, matrix)
+    if phases is None:
+      failed = True
+      continue
+    for phase in PHASES:
+      limit = baseline.get(matrix, {}).get(phase)
+      if args.u:
+        verdict = 'recorded'
+      elif limit is None:
+        verdict = 'no baseline'
+        failed = True
+      else:
+        limit = limit * (100 + args.p) / 100.0
+        verdict = 'limit %.3fs' % limit
+        if phases[phase] > limit:
+          verdict += ', REGRESSED'
+          failed = True
+      print('%-10s %-4s %8.3fs  %s' % (matrix, phase, phases[phase], verdict))
+    if args.u:
+      baseline[matrix] = phases
+
+  if args.u:
+    with open(args.c, 'w') as f:
+      json.dump(baseline, f, indent=2, sort_keys=True)
+    print('baseline written to %s' % args.c)
+  sys.exit(1 if failed else 0)